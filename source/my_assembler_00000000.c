@@ -7,17 +7,62 @@
 /*
  * 프로그램의 헤더
  */
+#define _GNU_SOURCE             //memmem()을 사용하기 위해 추가
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
 #include <stdbool.h>            //bool변수를 사용하기 위해 추가
+#include <unistd.h>             //소스 파일을 mmap으로 읽기 위해 추가
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>            //패스2를 섹션별로 동시에 처리하기 위해 추가
+#include <dirent.h>             //batch 모드에서 디렉터리의 소스 파일을 찾기 위해 추가
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>               //벤치마크에서 단계별 시간을 재기 위해 추가
+#include <signal.h>             //서버 모드에서 Unix 도메인 소켓을 사용하기 위해 추가
+#include <sys/socket.h>
+#include <sys/un.h>
+#ifdef SICXE_STATS
+#include <sys/resource.h>       //통계에서 최대 메모리 사용량을 구하기 위해 추가
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>          //필드 구분자를 찾을 때 AVX2/SSE2를 사용하기 위해 추가
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "my_assembler_00000000.h"
 
 #define MAX_LINE_LENGTH 1000    //한 줄의 최대 길이
-#define MAX_TOKEN_LENGTH 100    //한 토큰의 최대 길이
+#define AVG_LINE_LENGTH 24      //용량을 미리 확보할 때 가정하는 한 줄의 평균 길이
+#define PASS1_MIN_CHUNK 4096    //패스1에서 한 구간이 가지는 최소 라인 수
+#define WRITER_BUFFER_SIZE (256 * 1024)     //출력 버퍼의 크기
+#define OBJECT_NAME_LENGTH 6    //오브젝트 프로그램의 이름 칸(H, D, R 레코드)의 글자 수
+
+//scan_field()는 정렬된 블록 단위로 문자열 끝 뒤까지 읽으므로 sanitizer 검사에서 제외
+#if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 8)
+#define SCAN_NO_SANITIZE __attribute__((no_sanitize("address", "thread")))
+#else
+#define SCAN_NO_SANITIZE
+#endif
+
+#define CACHE_MAGIC "SICXEC7"   //섹션 캐시 파일의 시작 문자열(형식이 바뀌면 숫자를 올린다)
+
+static char empty_field[1];     //비어있는 토큰이 가리키는 빈 문자열
+//매크로 호출 라인의 label을 정의하는 "label EQU *" 토큰의 필드
+static char macro_equ[] = "EQU";
+static char macro_locctr[] = "*";
+//매크로 인자 이름에 쓸 수 있는 문자
+static const char macro_name_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_";
+//캐시에서 가져오는 섹션의 라인이 가리키는 빈 토큰(읽기 전용)
+static token cached_token = { empty_field, empty_field, { empty_field, empty_field, empty_field }, empty_field, 0, 0, 0, -1, { -1, -1, -1 }, OP_NONE, 0, -1, NULL };
+//지시어 이름(enum operator_kind 순서, 기계 명령어가 아닌 operator만 비교한다)
+static const char* directive_names[OP_COUNT] = {
+    "", "", "START", "CSECT", "END", "LTORG", "EQU", "RESW", "RESB", "BYTE", "WORD", "EXTDEF", "EXTREF"
+};
 
 /* ----------------------------------------------------------------------------------
  * 설명 : 사용자로 부터 어셈블리 파일을 받아서 명령어의 OPCODE를 찾아 출력한다.
@@ -25,10 +70,15 @@
  * 반환 : 성공 = 0, 실패 = < 0 
  * 주의 : 현재 어셈블리 프로그램의 리스트 파일을 생성하는 루틴은 만들지 않았다. 
  *		   또한 중간파일을 생성하지 않는다. 
+ *		   인자 없이 실행하면 input.txt를 어셈블하고, 인자가 있으면 batch_main()을 따른다.
  * ----------------------------------------------------------------------------------
  */
 int main(int args, char *arg[])
 {
+	//인자가 있으면 주어진 소스 파일들을 동시에 어셈블(batch 모드)
+	if (args > 1)
+		return batch_main(args, arg);
+
 	if (init_my_assembler() < 0)
 	{
 		printf("init_my_assembler: 프로그램 초기화에 실패 했습니다.\n");
@@ -58,6 +108,7 @@ int main(int args, char *arg[])
 	make_objectcode_output("output_00000000.txt");
     //make_objectcode_output(NULL);
 
+    release_my_assembler();
 	return 0;
 }
 
@@ -81,6 +132,220 @@ int init_my_assembler(void)
 	return result;
 }
 
+/* ----------------------------------------------------------------------------------
+ * 설명 : 테이블(동적 배열)의 용량을 need개 이상이 되도록 두 배씩 늘리는 함수이다.
+ *        RESERVE_TABLE 매크로를 통해 호출된다.
+ * 매계 : 테이블 포인터, 현재 용량을 저장하는 변수, 필요한 원소 개수, 원소 하나의 크기
+ * 반환 : 정상종료 = 늘어난(또는 그대로인) 테이블 포인터
+ * 주의 : 새로 늘어난 부분은 0으로 초기화되며, 메모리가 부족하면 프로그램을 종료한다.
+ * ----------------------------------------------------------------------------------
+ */
+void* reserve_table(void* table, int* capacity, int need, size_t unit)
+{
+    if (need <= *capacity)
+        return table;
+
+    int newCapacity = (*capacity > 0) ? *capacity : 16;
+    while (newCapacity < need)
+        newCapacity *= 2;
+    char* newTable = (char*)realloc(table, (size_t)newCapacity * unit);
+    if (newTable == NULL) {
+        printf("reserve_table: 메모리 할당에 실패했습니다.\n");
+        exit(1);
+    }
+    memset(newTable + (size_t)*capacity * unit, 0, (size_t)(newCapacity - *capacity) * unit);
+    STAT_ADD(STAT_ALLOC, 1);
+    STAT_ADD(STAT_ALLOC_BYTES, (size_t)(newCapacity - *capacity) * unit);
+    *capacity = newCapacity;
+    return newTable;
+}
+
+/* ----------------------------------------------------------------------------------
+ * 설명 : 어셈블리가 끝난 테이블을 다시 사용할 수 있도록 비우거나 해제하는 함수이다.
+ * 매계 : 테이블, 테이블의 용량(해제하면 0으로 바꾼다), 항목 하나의 크기, 남겨둘지 여부
+ * 반환 : 남겨둔 테이블(0으로 채움), 해제했으면 NULL
+ * 주의 : 한 번 큰 소스를 어셈블한 뒤에도 메모리를 계속 차지하지 않도록
+ *        RECYCLE_TABLE_LIMIT보다 큰 테이블은 keep이 true여도 해제한다.
+ * ----------------------------------------------------------------------------------
+ */
+void* recycle_table(void* table, int* capacity, size_t unit, bool keep)
+{
+    size_t size = (size_t)*capacity * unit;
+    if (table != NULL && keep && size <= RECYCLE_TABLE_LIMIT) {
+        memset(table, 0, size);
+        return table;
+    }
+    free(table);
+    *capacity = 0;
+    return NULL;
+}
+
+/* ----------------------------------------------------------------------------------
+ * 설명 : 어셈블리 한 번에 사용한 테이블과 arena를 해제하고 상태를 초기화하는 함수이다.
+ *        inst_table은 다음 어셈블리에서도 사용하기 때문에 해제하지 않는다.
+ * 매계 : 없음
+ * 반환 : 없음
+ * 주의 : ctx->keep_tables가 true이면(서버 모드) 크지 않은 테이블과 arena 블록 하나를
+ *        비워서 남겨두므로, 다음 요청은 테이블을 다시 늘리지 않고 바로 사용한다.
+ *        macro_token은 NULL인지로 매크로 사용 여부를 판단하므로 항상 해제한다.
+ * ----------------------------------------------------------------------------------
+ */
+void release_my_assembler(void)
+{
+    bool keep = ctx->keep_tables;
+
+    STAT_PHASE(PHASE_NONE);
+    for (int i = 0; i < ctx->section_index; i++)
+        free(ctx->section_table[i].hash.slot);
+    RECYCLE_TABLE(ctx->name_symbol, ctx->name_symbol_capacity, keep);
+    RECYCLE_TABLE(ctx->name_literal, ctx->name_literal_capacity, keep);
+    if (keep)
+        intern_reset(&ctx->names);
+    else
+        intern_release(&ctx->names);
+
+    free(ctx->macro_token);
+    ctx->macro_token = NULL;
+    ctx->macro_token_capacity = 0;
+    RECYCLE_TABLE(ctx->input_data, ctx->input_capacity, keep);
+    RECYCLE_TABLE(ctx->token_table, ctx->token_capacity, keep);
+    RECYCLE_TABLE(ctx->sym_table, ctx->sym_capacity, keep);
+    RECYCLE_TABLE(ctx->section_table, ctx->section_capacity, keep);
+    RECYCLE_TABLE(ctx->literal_table, ctx->literal_capacity, keep);
+    RECYCLE_TABLE(ctx->code_table, ctx->code_capacity, keep);
+    RECYCLE_TABLE(ctx->modify_table, ctx->modify_capacity, keep);
+    ctx->line_num = ctx->token_line = ctx->sym_index = ctx->section_index = ctx->literal_start = ctx->literal_index = ctx->literal_pooled = ctx->code_index = ctx->modify_index = 0;
+    ctx->locctr = ctx->prevLoc = 0;
+
+    //소스 파일 매핑(또는 버퍼) 해제
+    if (ctx->input_mapped)
+        munmap(ctx->input_text, ctx->input_text_size);
+    else
+        free(ctx->input_text);
+    ctx->input_text = NULL;
+    ctx->input_text_size = 0;
+    ctx->input_mapped = false;
+
+    cache_release();
+
+    //토큰, 소스 라인, M 레코드 문자열은 arena와 함께 한 번에 해제
+    if (keep)
+        arena_reset(&ctx->asm_arena);
+    else
+        arena_release(&ctx->asm_arena);
+}
+
+/* ----------------------------------------------------------------------------------
+ * 설명 : arena에서 size byte를 할당하는 함수이다.
+ *        현재 블록에 공간이 부족하면 새 블록(ARENA_BLOCK_SIZE 이상)을 받아 연결한다.
+ * 매계 : 할당받을 arena, 필요한 크기
+ * 반환 : 정상종료 = 할당된 메모리의 주소(8 byte 정렬)
+ * 주의 : 할당된 메모리는 초기화되지 않으며 arena_release()로만 해제된다.
+ * ----------------------------------------------------------------------------------
+ */
+void* arena_alloc(arena* pool, size_t size)
+{
+    size = (size + 7) & ~(size_t)7;
+    struct arena_block* block = pool->head;
+    if (block == NULL || block->used + size > block->size) {
+        size_t blockSize = (size > ARENA_BLOCK_SIZE) ? size : ARENA_BLOCK_SIZE;
+        block = (struct arena_block*)malloc(sizeof(struct arena_block) + blockSize);
+        if (block == NULL) {
+            printf("arena_alloc: 메모리 할당에 실패했습니다.\n");
+            exit(1);
+        }
+        block->next = pool->head;
+        block->used = 0;
+        block->size = blockSize;
+        pool->head = block;
+        pool->total += blockSize;
+    }
+    void* result = block->data + block->used;
+    block->used += size;
+    STAT_ADD(STAT_ALLOC, 1);
+    STAT_ADD(STAT_ALLOC_BYTES, size);
+    return result;
+}
+
+/* ----------------------------------------------------------------------------------
+ * 설명 : 문자열을 arena에 복사하는 함수이다.
+ * 매계 : 할당받을 arena, 복사할 문자열
+ * 반환 : 정상종료 = 복사된 문자열
+ * ----------------------------------------------------------------------------------
+ */
+char* arena_strdup(arena* pool, const char* str)
+{
+    size_t length = strlen(str) + 1;
+    char* result = (char*)arena_alloc(pool, length);
+    memcpy(result, str, length);
+    return result;
+}
+
+/* ----------------------------------------------------------------------------------
+ * 설명 : arena가 받은 모든 블록을 해제하는 함수이다.
+ * 매계 : 해제할 arena
+ * 반환 : 없음
+ * ----------------------------------------------------------------------------------
+ */
+void arena_release(arena* pool)
+{
+    while (pool->head != NULL) {
+        struct arena_block* next = pool->head->next;
+        free(pool->head);
+        pool->head = next;
+    }
+    pool->total = 0;
+}
+
+/* ----------------------------------------------------------------------------------
+ * 설명 : arena를 비우되 기본 크기(ARENA_BLOCK_SIZE)의 블록 하나는 남겨두는 함수이다.
+ *        다음 어셈블리는 남겨둔 블록부터 다시 할당한다.
+ * 매계 : 비울 arena
+ * 반환 : 없음
+ * 주의 : 큰 할당을 위해 받은 블록과 나머지 블록은 모두 해제한다.
+ * ----------------------------------------------------------------------------------
+ */
+void arena_reset(arena* pool)
+{
+    struct arena_block* kept = NULL;
+    while (pool->head != NULL) {
+        struct arena_block* next = pool->head->next;
+        if (kept == NULL && pool->head->size == ARENA_BLOCK_SIZE)
+            kept = pool->head;
+        else
+            free(pool->head);
+        pool->head = next;
+    }
+    if (kept != NULL) {
+        kept->next = NULL;
+        kept->used = 0;
+        pool->head = kept;
+    }
+    pool->total = (kept != NULL) ? kept->size : 0;
+}
+
+/* ----------------------------------------------------------------------------------
+ * 설명 : from arena의 블록들을 into arena로 옮기는 함수이다.
+ *        옮겨진 메모리는 into arena가 해제될 때 함께 해제된다.
+ * 매계 : 블록을 받을 arena, 블록을 넘겨줄 arena
+ * 반환 : 없음
+ * ----------------------------------------------------------------------------------
+ */
+void arena_merge(arena* into, arena* from)
+{
+    if (from->head == NULL)
+        return;
+    //from의 마지막 블록 뒤에 into의 블록들을 연결하고, into는 from의 현재 블록부터 사용
+    struct arena_block* tail = from->head;
+    while (tail->next != NULL)
+        tail = tail->next;
+    tail->next = into->head;
+    into->head = from->head;
+    into->total += from->total;
+    from->head = NULL;
+    from->total = 0;
+}
+
 /* ----------------------------------------------------------------------------------
  * 설명 : 머신을 위한 기계 코드목록 파일을 읽어 기계어 목록 테이블(inst_table)을 
  *        생성하는 함수이다. 
@@ -96,11 +361,12 @@ int init_my_assembler(void)
 int init_inst_file(char *inst_file)
 {
 	FILE *file;
-	int errno;
+	int result;
 
+    STAT_PHASE(PHASE_INST);
     //기계 명령어 파일 열기
     if ((file = fopen(inst_file, "r")) == NULL)
-        errno = -1;
+        result = -1;
     else {
         inst_index = 0;
         //임시로 정보를 받을 변수
@@ -110,6 +376,7 @@ int init_inst_file(char *inst_file)
         int operandCnt = 0;
         //파일을 한 라인씩 읽으며 inst_table에 정보 저장
         while (fscanf(file, "%s\t%d\t%X\t%d\n", name, &format, &opcode, &operandCnt) != EOF) {
+            RESERVE_TABLE(inst_table, inst_capacity, inst_index + 1);
             inst_table[inst_index] = (inst*)malloc(sizeof(inst));
 
             inst_table[inst_index]->name = (char*)malloc(strlen(name) * sizeof(char) + 1);
@@ -122,9 +389,86 @@ int init_inst_file(char *inst_file)
             inst_index++;
         }
         fclose(file);
-        errno = 0;
+        //명령어 목록이 바뀌면 섹션 캐시를 다시 만들도록 내용의 해시 값 계산
+        inst_digest = 14695981039346656037ull;
+        for (int i = 0; i < inst_index; i++) {
+            inst_digest = hash_bytes(inst_digest, inst_table[i]->name, strlen(inst_table[i]->name) + 1);
+            inst_digest = hash_bytes(inst_digest, &inst_table[i]->format, sizeof(int));
+            inst_digest = hash_bytes(inst_digest, &inst_table[i]->opcode, sizeof(int));
+            inst_digest = hash_bytes(inst_digest, &inst_table[i]->operandCnt, sizeof(int));
+        }
+        //이름으로 바로 찾을 수 있도록 해시 테이블 생성
+        result = build_inst_hash();
+    }
+    STAT_PHASE(PHASE_NONE);
+    return result;
+}
+
+/* ----------------------------------------------------------------------------------
+ * 설명 : seed를 섞은 FNV-1a 방식으로 문자열(명령어 이름, 심볼 이름)의 해시 값을 계산하는 함수이다.
+ * 매계 : 해시 값을 구할 문자열, seed
+ * 반환 : 해시 값
+ * ----------------------------------------------------------------------------------
+ */
+static unsigned int hash_string(const char *str, unsigned int seed)
+{
+    unsigned int hash = 2166136261u ^ seed;
+    while (*str != '\0') {
+        hash ^= (unsigned char)*str++;
+        hash *= 16777619u;
+    }
+    //하위 bit만 사용하므로 상위 bit를 섞어준다
+    hash ^= hash >> 15;
+    hash *= 0x2C1B3C6Du;
+    hash ^= hash >> 12;
+    return hash;
+}
+
+/* ----------------------------------------------------------------------------------
+ * 설명 : inst_table의 모든 명령어가 서로 다른 슬롯에 들어가는 seed와 크기를 찾아
+ *        해시 테이블(inst_hash)을 생성하는 함수이다.
+ * 매계 : 없음
+ * 반환 : 정상종료 = 0 , 에러 < 0
+ * 주의 : 명령어 개수의 4배 이상인 2의 거듭제곱 크기부터 시작하여 seed를 바꿔가며
+ *        충돌이 없는 조합을 찾고, 일정 횟수 안에 찾지 못하면 크기를 두 배로 늘린다.
+ * ----------------------------------------------------------------------------------
+ */
+static int build_inst_hash(void)
+{
+    unsigned int size = 64;
+    while (size < (unsigned int)inst_index * 4)
+        size <<= 1;
+
+    free(inst_hash);
+    inst_hash = NULL;
+    while (size <= (1u << 20)) {
+        inst_hash = (int*)realloc(inst_hash, size * sizeof(int));
+        if (inst_hash == NULL)
+            return -1;
+        for (unsigned int seed = 1; seed <= 256; seed++) {
+            bool isCollision = false;
+            memset(inst_hash, 0, size * sizeof(int));
+            for (int i = 0; i < inst_index; i++) {
+                unsigned int slot = hash_string(inst_table[i]->name, seed) & (size - 1);
+                //같은 이름이 두 번 들어있는 경우 처음 것만 사용
+                if (inst_hash[slot] != 0 && strcmp(inst_table[inst_hash[slot] - 1]->name, inst_table[i]->name) == 0)
+                    continue;
+                if (inst_hash[slot] != 0) {
+                    isCollision = true;
+                    break;
+                }
+                inst_hash[slot] = i + 1;
+            }
+            //충돌이 없으면 해당 seed와 크기로 확정
+            if (!isCollision) {
+                inst_hash_mask = size - 1;
+                inst_hash_seed = seed;
+                return 0;
+            }
+        }
+        size <<= 1;
     }
-    return errno;
+    return -1;
 }
 
 /* ----------------------------------------------------------------------------------
@@ -132,32 +476,143 @@ int init_inst_file(char *inst_file)
  * 매계 : 어셈블리할 소스파일명
  * 반환 : 정상종료 = 0 , 에러 < 0  
  * 주의 : 라인단위로 저장한다.
+ *        일반 파일은 복사 없이 mmap(MAP_PRIVATE)으로 읽고, input_data의 각 라인은
+ *        매핑된 메모리를 직접 가리킨다. 줄바꿈 문자를 '\0'으로 바꿔 라인을 나누므로
+ *        라인 길이에 제한이 없으며, 수정한 내용은 원본 파일에 반영되지 않는다.
+ *        매핑할 수 없는 파일(파이프 등)은 한 번에 메모리로 읽어서 같은 방식으로 처리한다.
+ *        소스에 MACRO가 있으면 라인을 나누는 대로 macro_feed()에 넘겨 매크로 정의는
+ *        저장하지 않고, 매크로 호출은 확장한 라인(과 토큰)으로 바꾸어 저장한다.
  * ----------------------------------------------------------------------------------
  */
 int init_input_file(char *input_file)
 {
-	FILE *file;
-	int errno;
+    int fd;
+    struct stat info;
 
+    STAT_PHASE(PHASE_INPUT);
+    STAT_SOURCE(input_file);
     //소스 코드 파일 열기
-    if ((file = fopen(input_file, "r")) == NULL)
-        errno = -1;
-    else {
-        line_num = 0;
-        char tempCode[MAX_LINE_LENGTH] = "";    //임시로 소스코드를 받을 변수
-        //파일을 한 라인씩 읽으며 input_data에 소스 코드 저장
-        while (fscanf(file, "%[^\n]", tempCode) != EOF) {
-            input_data[line_num] = (char*)malloc(strlen(tempCode) * sizeof(char) + 1);
-            strcpy(input_data[line_num], tempCode);
+    if ((fd = open(input_file, O_RDONLY)) < 0)
+        return -1;
+    if (fstat(fd, &info) < 0) {
+        close(fd);
+        return -1;
+    }
 
-            getc(file);
-            line_num++;
+    ctx->line_num = 0;
+    ctx->input_text = NULL;
+    ctx->input_text_size = 0;
+    ctx->input_mapped = false;
+    //일반 파일이면 쓰기 가능한 private 매핑으로 열기
+    if (S_ISREG(info.st_mode) && info.st_size > 0) {
+        void* map = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            ctx->input_text = (char*)map;
+            ctx->input_text_size = (size_t)info.st_size;
+            ctx->input_mapped = true;
         }
-        fclose(file);
-        errno = 0;
     }
+    //매핑하지 못한 경우 파일 전체를 버퍼에 읽기
+    if (!ctx->input_mapped) {
+        size_t capacity = 0;
+        ssize_t readSize;
+        do {
+            if (ctx->input_text_size == capacity) {
+                capacity = (capacity > 0) ? capacity * 2 : 64 * 1024;
+                ctx->input_text = (char*)realloc(ctx->input_text, capacity);
+                if (ctx->input_text == NULL) {
+                    close(fd);
+                    return -1;
+                }
+            }
+            readSize = read(fd, ctx->input_text + ctx->input_text_size, capacity - ctx->input_text_size);
+            if (readSize > 0)
+                ctx->input_text_size += (size_t)readSize;
+        } while (readSize > 0);
+        if (readSize < 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    close(fd);
+    return split_input();
+}
+
+/* ----------------------------------------------------------------------------------
+ * 설명 : 파일 대신 메모리의 소스 코드로 소스코드 테이블(input_data)을 생성하는 함수이다.
+ *        서버 모드에서 요청에 담겨 온 소스를 어셈블할 때 사용한다.
+ * 매계 : malloc()으로 할당한 소스 코드(어셈블리가 끝나면 release_my_assembler()가 해제), 크기
+ * 반환 : 정상종료 = 0 , 에러 < 0
+ * ----------------------------------------------------------------------------------
+ */
+static int init_input_text(char *text, size_t size)
+{
+    STAT_PHASE(PHASE_INPUT);
+    ctx->line_num = 0;
+    ctx->input_text = text;
+    ctx->input_text_size = size;
+    ctx->input_mapped = false;
+    return split_input();
+}
+
+/* ----------------------------------------------------------------------------------
+ * 설명 : 읽어들인 소스 코드(input_text)를 라인으로 나누어 input_data에 저장하는 함수이다.
+ * 매계 : 없음
+ * 반환 : 정상종료 = 0 , 에러 < 0
+ * 주의 : 소스에 MACRO가 있으면 라인을 나누는 대로 macro_feed()에 넘긴다.
+ * ----------------------------------------------------------------------------------
+ */
+static int split_input(void)
+{
+    //파일 크기로 라인 수를 추정하여 input_data와 token_table의 용량을 미리 확보
+    RESERVE_TABLE(ctx->input_data, ctx->input_capacity, (int)(ctx->input_text_size / AVG_LINE_LENGTH) + 1);
+    RESERVE_TABLE(ctx->token_table, ctx->token_capacity, (int)(ctx->input_text_size / AVG_LINE_LENGTH) + 1);
+
+    //MACRO가 한 번도 나오지 않으면 매크로 처리기를 거치지 않음
+    macro_processor mp;
+    bool useMacro = (memmem(ctx->input_text, ctx->input_text_size, "MACRO", 5) != NULL);
+    memset(&mp, 0, sizeof(mp));
+
+    //줄바꿈 문자를 '\0'으로 바꾸면서 라인의 시작 위치를 input_data에 저장
+    char* line = ctx->input_text;
+    char* end = ctx->input_text + ctx->input_text_size;
+    while (line < end) {
+        char* newline = (char*)memchr(line, '\n', (size_t)(end - line));
+        char* next = (newline != NULL) ? newline + 1 : end;
+        //마지막 라인에 줄바꿈 문자가 없으면 '\0'을 쓸 자리가 없으므로 그 라인만 복사
+        if (newline == NULL) {
+            size_t length = (size_t)(end - line);
+            char* lastLine = (char*)arena_alloc(&ctx->asm_arena, length + 1);
+            memcpy(lastLine, line, length);
+            line = lastLine;
+            newline = lastLine + length;
+        }
+        *newline = '\0';
+        //CRLF 형식의 소스인 경우 '\r'도 제거
+        if (newline > line && newline[-1] == '\r')
+            newline[-1] = '\0';
+
+        //매크로 정의는 모으고, 호출은 확장한 라인들로 바꾸어 저장
+        if (useMacro) {
+            if (macro_feed(&mp, line) < 0) {
+                macro_release(&mp);
+                return -1;
+            }
+        }
+        else {
+            RESERVE_TABLE(ctx->input_data, ctx->input_capacity, ctx->line_num + 1);
+            ctx->input_data[ctx->line_num++] = line;
+        }
+        line = next;
+    }
+    //MEND 없이 파일이 끝난 경우
+    bool isError = (mp.defining != NULL);
+    macro_release(&mp);
+    if (isError)
+        return -1;
 
-    return errno;
+    STAT_ADD(STAT_LINES, ctx->line_num);
+    return 0;
 }
 
 /* ----------------------------------------------------------------------------------
@@ -166,42 +621,108 @@ int init_input_file(char *input_file)
  * 매계 : 파싱을 원하는 문자열  
  * 반환 : 정상종료 = 0 , 에러 < 0 
  * 주의 : my_assembler 프로그램에서는 라인단위로 토큰 및 오브젝트 관리를 하고 있다. 
+ *        line_num번째 라인으로 저장하며, 앞의 라인들이 모두 처리된 상태에서 호출해야 한다.
+ *        assem_pass1()은 같은 과정을 단계별로 나누어 여러 라인을 동시에 처리한다.
  * ----------------------------------------------------------------------------------
  */
 int token_parsing(char *str)
 {
-    token_line = line_num;
-    token_table[token_line] = (token*)malloc(sizeof(token));
+    ctx->token_line = ctx->line_num;
+    RESERVE_TABLE(ctx->token_table, ctx->token_capacity, ctx->token_line + 1);
+    ctx->token_table[ctx->token_line] = (token*)arena_alloc(&ctx->asm_arena, sizeof(token));
+    if (tokenize_line(str, ctx->token_table[ctx->token_line]) < 0)
+        return -1;
+    intern_token(ctx->token_table[ctx->token_line], &ctx->names);
 
-    char tokenList[4][MAX_TOKEN_LENGTH] = { 0, };   //임시로 label, operator, operand, comment를 저장할 변수
-    bool isLabelExist = true;                       //라벨 위치에 토큰이 있으면 true, 없으면 false
+    //CSECT이면 주소 0으로 초기화
+    if (ctx->token_table[ctx->token_line]->kind == OP_CSECT)
+        ctx->locctr = 0;
+    ctx->token_table[ctx->token_line]->addr = ctx->locctr;
+    //리터럴 임시 저장, LTORG/END이면 리터럴이 차지하는 크기 계산
+    pool_literals(ctx->token_line);
+    ctx->locctr += ctx->token_table[ctx->token_line]->size;
+    //sym_table과 literal_table에 주소 저장
+    return account_line(ctx->token_line);
+}
 
-    //라벨 위치에 토큰이 있는지 확인
-    if (str[0] == '\t')
-        isLabelExist = false;
-    char* restLine;
-    char* tempToken = strtok_s(str, "\t", &restLine);
-    int tokenCnt = 0;
-    //tokenList에 정보 저장
-    while (tempToken != NULL) {
-        if (isLabelExist) {
-            strcpy(tokenList[tokenCnt], tempToken);
-            tempToken = strtok_s(NULL, "\t", &restLine);
-        }
-        else {
-            tokenList[0][0] = '\0';
-            isLabelExist = true;
-        }
-        tokenCnt++;
+/* ----------------------------------------------------------------------------------
+ * 설명 : str부터 '\0' 또는 stop1, stop2 문자가 처음 나오는 위치를 찾는 함수이다.
+ *        필드 구분자(탭, ',')를 찾을 때 사용하며, AVX2/SSE2를 사용할 수 있으면
+ *        한 번에 32/16 byte씩 비교하고, 그렇지 않으면 한 byte씩 비교한다.
+ * 매계 : 검색을 시작할 위치, 찾을 문자 두 개(하나만 찾으려면 같은 문자를 넘긴다)
+ * 반환 : 처음 찾은 위치(없으면 문자열 끝의 '\0')
+ * 주의 : 정렬된 블록 단위로 읽기 때문에 페이지 경계를 넘지 않지만 문자열 끝 뒤의 byte를
+ *        함께 읽을 수 있다(결과에는 사용하지 않는다). 그래서 sanitizer 검사에서 제외한다.
+ * ----------------------------------------------------------------------------------
+ */
+SCAN_NO_SANITIZE
+static char* scan_field(char* str, char stop1, char stop2)
+{
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i first = _mm256_set1_epi8(stop1);
+    const __m256i second = _mm256_set1_epi8(stop2);
+    uintptr_t offset = (uintptr_t)str & 31;
+    const __m256i* block = (const __m256i*)(str - offset);
+    while (1) {
+        __m256i data = _mm256_load_si256(block);
+        __m256i found = _mm256_or_si256(_mm256_cmpeq_epi8(data, zero),
+            _mm256_or_si256(_mm256_cmpeq_epi8(data, first), _mm256_cmpeq_epi8(data, second)));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(found);
+        //첫 블록은 str 이전의 byte를 제외
+        mask = mask >> offset << offset;
+        offset = 0;
+        if (mask != 0)
+            return (char*)block + __builtin_ctz(mask);
+        block++;
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i first = _mm_set1_epi8(stop1);
+    const __m128i second = _mm_set1_epi8(stop2);
+    uintptr_t offset = (uintptr_t)str & 15;
+    const __m128i* block = (const __m128i*)(str - offset);
+    while (1) {
+        __m128i data = _mm_load_si128(block);
+        __m128i found = _mm_or_si128(_mm_cmpeq_epi8(data, zero),
+            _mm_or_si128(_mm_cmpeq_epi8(data, first), _mm_cmpeq_epi8(data, second)));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(found);
+        //첫 블록은 str 이전의 byte를 제외
+        mask = mask >> offset << offset;
+        offset = 0;
+        if (mask != 0)
+            return (char*)block + __builtin_ctz(mask);
+        block++;
     }
+#else
+    while (*str != '\0' && *str != stop1 && *str != stop2)
+        str++;
+    return str;
+#endif
+}
+
+/* ----------------------------------------------------------------------------------
+ * 설명 : 소스 코드 한 라인을 label, operator, operand, comment로 나누어 토큰에 저장하고
+ *        라인이 차지하는 byte 수를 계산하는 함수이다.
+ * 매계 : 파싱을 원하는 문자열, 정보를 저장할 토큰
+ * 반환 : 정상종료 = 0 , 에러 < 0 
+ * 주의 : 다른 전역 테이블을 수정하지 않으므로 여러 라인을 동시에 처리할 수 있다.
+ *        LTORG/END의 크기는 리터럴에 따라 달라지므로 pool_literals()에서 계산한다.
+ * ----------------------------------------------------------------------------------
+ */
+static int tokenize_line(char* str, token* tok)
+{
+    memset(tok, 0, sizeof(token));
+
+    //label, operator, operand, comment의 시작 위치(입력 라인을 직접 가리킨다)
+    char* tokenList[4];
+    split_fields(str, tokenList);
     ///////////////tokenList를 바탕으로 token_table의 각각 해당하는 토큰에 정보 저장///////////////
     //label
-    token_table[token_line]->label = (char*)malloc(strlen(tokenList[0]) * sizeof(char) + 1);
-    strcpy(token_table[token_line]->label, tokenList[0]);
+    tok->label = tokenList[0];
 
     //operator
-    token_table[token_line]->operator = (char*)malloc(strlen(tokenList[1]) * sizeof(char) + 1);
-    strcpy(token_table[token_line]->operator, tokenList[1]);
+    tok->operator = tokenList[1];
 
     //operand
         //피연산자는 ','로 한번 더 분리
@@ -209,141 +730,300 @@ int token_parsing(char *str)
         //연산자가 RSUB과 같이 피연산자의 개수가 무조건 0개인 경우
         //tokenList[2]에 들어가 있는 주석을 tokenList[3]에 옮기고 피연산자 자리에 아무것도 없게 초기화
     if (opcode != -1 && inst_table[opcode]->operandCnt == 0) {
-        strcpy(tokenList[3], tokenList[2]);
-        memset(tokenList[2], 0, MAX_TOKEN_LENGTH);
+        tokenList[3] = tokenList[2];
+        tokenList[2] = empty_field;
     }
-    char operandList[MAX_OPERAND][MAX_TOKEN_LENGTH] = { 0, };
-    char* tempVar = strtok(tokenList[2], ",");
+    char* operandList[MAX_OPERAND] = { empty_field, empty_field, empty_field };
+    char* tempVar = tokenList[2];
     int operandCnt = 0;
-        //','로 피연산자를 구분하여 operandList에 저장
-    while (tempVar != NULL) {
-        if (operandCnt > 3)
+        //','를 '\0'으로 바꾸며 피연산자를 구분하여 operandList에 저장(빈 피연산자는 무시)
+    while (*tempVar != '\0') {
+        if (*tempVar == ',') {
+            tempVar++;
+            continue;
+        }
+        if (operandCnt >= MAX_OPERAND)
             return -1;
-        strcpy(operandList[operandCnt], tempVar);
+        operandList[operandCnt++] = tempVar;
 
-        tempVar = strtok(NULL, ",");
-        operandCnt++;
+        tempVar = scan_field(tempVar, ',', ',');
+        if (*tempVar == '\0')
+            break;
+        *tempVar++ = '\0';
     }
         //구분된 피연산자를 token_table에 저장
     for (int i = 0; i < MAX_OPERAND; i++) {
-        token_table[token_line]->operand[i] = (char*)malloc(strlen(operandList[i]) * sizeof(char) + 1);
-        strcpy(token_table[token_line]->operand[i], operandList[i]);
+        tok->operand[i] = operandList[i];
     }
 
     //comment
-    token_table[token_line]->comment = (char*)malloc(strlen(tokenList[3]) * sizeof(char) + 1);
-    strcpy(token_table[token_line]->comment, tokenList[3]);
+    tok->comment = tokenList[3];
 
-    ///////////////sym_table과 literal_table을 위한 주소 계산과 각각 테이블의 정보 저장///////////////
-    //주소 계산
-        //CSECT이면 주소 0으로 초기화
-    if (strcmp(token_table[token_line]->operator, "CSECT") == 0)
-        locctr = 0;
-        //이전 주소값 저장
-    prevLoc = locctr;
-
-    opcode = search_opcode(token_table[token_line]->operator);
-    //operator가 기계 명령어이면
-    if (opcode != -1) {
-        //기계 명령어의 format을 따라 주소 값 더하기
-        locctr += inst_table[opcode]->format;
-        if (token_table[token_line]->operator[0] == '+')
-            locctr++;
-    }
-    //아니면 operator가
-    else {
-        //RESW인 경우
-        if (strcmp(token_table[token_line]->operator, "RESW") == 0) {
-            locctr += 3 * atoi(token_table[token_line]->operand[0]);
-        }
-        //RESB인 경우
-        else if (strcmp(token_table[token_line]->operator, "RESB") == 0) {
-            locctr += atoi(token_table[token_line]->operand[0]);
-        }
-        //EQU인 경우
-        else if (strcmp(token_table[token_line]->operator, "EQU") == 0) {
-            //피연산자에 *가 올 경우 주소 값 변동 없음
-            if (strcmp(token_table[token_line]->operand[0], "*") == 0)
-                locctr += 0;
-            //수식인 경우
-            else {
-                //-가 들어간 수식이면
-                char tempOperand[MAX_TOKEN_LENGTH] = { 0, };
-                strcpy(tempOperand, token_table[token_line]->operand[0]);
-                char* restString;
-                char* token = strtok_s(tempOperand, "-", &restString);
-                if (strlen(token) != strlen(token_table[token_line]->operand[0])) {
-                    int var1, var2;
-                    //각각의 주소값을 찾아서
-                    var1 = search_symbol(token, -1);
-                    var2 = search_symbol(restString, -1);
-                    //Absolute Expression 계산
-                    prevLoc = var1 - var2;
-                }
-                //단항이면(3byte 확보)
-                else
-                    locctr += 3;
-            }
+    classify_token(tok, opcode);
+    return 0;
+}
+
+/* ----------------------------------------------------------------------------------
+ * 설명 : 소스 코드 한 라인을 탭으로 label, operator, operand 필드, comment로 나누는 함수이다.
+ * 매계 : 나눌 문자열(탭이 '\0'으로 바뀐다), 각 필드의 시작 위치를 저장할 배열
+ * 반환 : 찾은 필드 개수(비어있는 label 포함)
+ * 주의 : 연속된 탭은 하나의 구분자로 취급하며, 없는 필드는 empty_field를 가리킨다.
+ * ----------------------------------------------------------------------------------
+ */
+static int split_fields(char* str, char* tokenList[4])
+{
+    int tokenCnt = 0;
+    for (int i = 0; i < 4; i++)
+        tokenList[i] = empty_field;
+
+    //라벨 위치에 토큰이 없으면(탭으로 시작하면) label은 빈 문자열
+    if (str[0] == '\t')
+        tokenCnt = 1;
+    //탭을 '\0'으로 바꾸면서 tokenList에 위치 저장(연속된 탭은 하나의 구분자로 취급)
+    char* tempToken = str;
+    while (tokenCnt < 4) {
+        while (*tempToken == '\t')
+            tempToken++;
+        if (*tempToken == '\0')
+            break;
+        tokenList[tokenCnt++] = tempToken;
+        //comment는 탭을 포함한 나머지 전체
+        if (tokenCnt == 4)
+            break;
+        tempToken = scan_field(tempToken, '\t', '\t');
+        if (*tempToken == '\0')
+            break;
+        *tempToken++ = '\0';
+    }
+    return tokenCnt;
+}
+
+/* ----------------------------------------------------------------------------------
+ * 설명 : 필드를 채운 토큰의 operator 종류와 라인이 차지하는 byte 수를 계산하는 함수이다.
+ * 매계 : 토큰, operator의 inst_table index(search_opcode()의 결과)
+ * 반환 : 없음
+ * 주의 : 매크로 확장에서 operand만 바꾼 토큰도 이 함수로 크기를 다시 계산한다.
+ * ----------------------------------------------------------------------------------
+ */
+static void classify_token(token* tok, int opcode)
+{
+    ///////////////operator 종류 저장///////////////
+    tok->opcode = opcode;
+    tok->kind = (opcode != -1) ? OP_INSTRUCTION : search_directive(tok->operator);
+    tok->format = (opcode != -1) ? search_format(tok->operator, opcode) : 0;
+    tok->size = 0;
+
+    ///////////////라인이 차지하는 byte 수 계산///////////////
+    switch (tok->kind) {
+    //operator가 기계 명령어이면 format('+'이면 4-byte)만큼
+    case OP_INSTRUCTION:
+        tok->size = tok->format;
+        break;
+    //RESW인 경우
+    case OP_RESW:
+        tok->size = 3 * atoi(tok->operand[0]);
+        break;
+    //RESB인 경우
+    case OP_RESB:
+        tok->size = atoi(tok->operand[0]);
+        break;
+    //BYTE인 경우
+    case OP_BYTE:
+        //X로 시작하는 경우
+        if (tok->operand[0][0] == 'X')
+            tok->size = (strlen(tok->operand[0]) - 3) / 2;
+        //C로 시작하는 경우
+        else
+            tok->size = strlen(tok->operand[0]) - 3;
+        break;
+    //WORD인 경우
+    case OP_WORD:
+        tok->size = 3;
+        break;
+    default:
+        break;
+    }
+}
+
+/* ----------------------------------------------------------------------------------
+ * 설명 : 라인의 리터럴을 literal_table에 임시 저장하고, LTORG/END이면 아직 배치되지
+ *        않은 리터럴들을 그 라인에 배치하여 라인의 크기(리터럴들의 크기 합)를 계산하는 함수이다.
+ * 매계 : token_table에서의 index
+ * 반환 : 없음
+ * 주의 : 리터럴의 주소는 우선 LTORG/END 라인 안에서의 위치로 저장하고,
+ *        라인의 주소가 정해진 뒤 account_line()에서 라인의 주소를 더한다.
+ *        소스 순서대로 호출해야 한다.
+ * ----------------------------------------------------------------------------------
+ */
+static void pool_literals(int line)
+{
+    token* tok = ctx->token_table[line];
+
+    //LTORG 또는 END인 경우 현재까지 임시저장된 리터럴을 이 라인에 배치
+    if (tok->kind == OP_LTORG || tok->kind == OP_END) {
+        int offset = 0;
+        for (int i = ctx->literal_pooled; i < ctx->literal_index; i++) {
+            ctx->literal_table[i].addr = offset;
+            ctx->literal_table[i].pool_line = line;
+            offset += ctx->literal_table[i].length;
         }
-        //BYTE인 경우
-        else if (strcmp(token_table[token_line]->operator, "BYTE") == 0) {
-            //X로 시작하는 경우
-            if (token_table[token_line]->operand[0][0] == 'X')
-                locctr += (strlen(token_table[token_line]->operand[0]) - 3) / 2;
-            //C로 시작하는 경우
+        ctx->literal_pooled = ctx->literal_index;
+        tok->size = offset;
+    }
+
+    //리터럴 임시 저장(이름, byte 수, 값만 저장하고 주소는 나중에 저장)
+    //중복 검사는 아직 배치되지 않은 리터럴(현재 LTORG 범위)에서만 하며,
+    //앞의 LTORG/END에서 이미 배치된 리터럴이면 새 범위에 다시 추가
+    if (tok->operand[0][0] == '=' && literal_find(tok->operand_id[0], ctx->literal_pooled) == -1) {
+        RESERVE_TABLE(ctx->literal_table, ctx->literal_capacity, ctx->literal_index + 1);
+        literal* lit = &ctx->literal_table[ctx->literal_index];
+        lit->name = tok->operand_id[0];
+        lit->pool_line = -1;
+        decode_literal(lit);
+        literal_insert(ctx->literal_index);
+        ctx->literal_index++;
+    }
+}
+
+/* ----------------------------------------------------------------------------------
+ * 설명 : 리터럴의 byte 수와 object code를 계산하는 함수이다.
+ *        "=X'05'"는 16진수 한 쌍이 1 byte, "=C'EOF'"는 문자 하나가 1 byte이다.
+ * 매계 : 이름이 저장된 리터럴
+ * 반환 : 없음
+ * ----------------------------------------------------------------------------------
+ */
+static void decode_literal(literal* lit)
+{
+    //"=C'ABC'"의 형태로 저장했기 때문에 따옴표 안의 리터럴만 사용
+    char* name = ctx->names.entry[lit->name].name;
+    char* literalP = name + 3;
+    int length = (int)strlen(name) - 4;
+    unsigned int value = 0;
+
+    if (name[1] == 'X') {
+        for (int i = 0; i < length; i++) {
+            if (literalP[i] >= 'A' && literalP[i] <= 'F')
+                value = (value << 4) | (unsigned int)(literalP[i] - 'A' + 10);
             else
-                locctr += strlen(token_table[token_line]->operand[0]) - 3;
-        }
-        //WORD인 경우
-        else if (strcmp(token_table[token_line]->operator, "WORD") == 0) {
-            locctr += 3;
-        }
-        //LTORG 또는 END인 경우 현재까지 임시저장된 literal_table 완성(주소 할당)
-        else if (strcmp(token_table[token_line]->operator, "LTORG") == 0 || strcmp(token_table[token_line]->operator, "END") == 0) {
-            for (int i = literal_start; i < literal_index; i++) {
-                literal_table[i].addr = prevLoc;
-                if (literal_table[i].literal[1] == 'X')
-                    locctr += (strlen(literal_table[i].literal) - 4) / 2;
-                else
-                    locctr += (strlen(literal_table[i].literal) - 4);
-                prevLoc = locctr;
-            }
-            //다음 루틴의 literal을 위해 literal_start 업데이트
-            literal_start = literal_index;
+                value = (value << 4) | (unsigned int)(literalP[i] - '0');
         }
+        length /= 2;
+    }
+    else {
+        for (int i = 0; i < length; i++)
+            value = (value << 8) | (unsigned char)literalP[i];
     }
+    lit->length = length;
+    lit->value = (int)value;
+}
 
-    //sym_table에 정보 저장
-    if (strlen(token_table[token_line]->label) > 0 && strcmp(token_table[token_line]->label, ".") != 0) {
-        //출력과 탐색을 위한 루틴별 구분(symbol이 개행문자, addr이 -1인 정보 추가)
-        if (prevLoc == 0 && sym_table[sym_index - 1].addr != 0) {
-            strcpy(sym_table[sym_index].symbol, "\n");
-            sym_table[sym_index].addr = -1;
-            sym_index++;
-        }
-        //정보 저장
-        strcpy(sym_table[sym_index].symbol, token_table[token_line]->label);
-        sym_table[sym_index].addr = prevLoc;
-        sym_index++;
-    }
-
-    //리터럴 임시 저장(리터럴 이름만 저장하고 주소는 나중에 저장)
-    if (token_table[token_line]->operand[0][0] == '=') {
-        bool isNew = true;
-        //리터럴 중복 검사
-        for (int i = 0; i < literal_index; i++) {
-            if (strcmp(literal_table[i].literal, token_table[token_line]->operand[0]) == 0) {
-                isNew = false;
-                break;
+/* ----------------------------------------------------------------------------------
+ * 설명 : 리터럴 이름으로 literal_table의 index를 찾는 함수이다.
+ *        같은 이름의 리터럴은 LTORG 범위마다 하나씩 있으므로, first 이후의 리터럴 중
+ *        가장 앞의 것(first부터 배치되는 범위의 리터럴)을 찾는다.
+ * 매계 : 리터럴 이름("=C'EOF'" 형태)의 ID, 찾을 범위의 첫 literal_table index
+ *        (패스1은 아직 배치되지 않은 첫 리터럴, 패스2는 다음에 배치할 리터럴)
+ * 반환 : 정상종료 = literal_table의 index, 에러 < 0
+ * 주의 : 이름 ID는 가장 나중에 추가된 리터럴을 가리키고 앞 범위의 리터럴로 이어지므로
+ *        거슬러 올라가는 횟수는 그 리터럴을 사용한 LTORG 범위의 수를 넘지 않는다.
+ * ----------------------------------------------------------------------------------
+ */
+static int literal_find(int name, int first)
+{
+    if (name < 0 || name >= ctx->name_literal_capacity)
+        return -1;
+    int index = ctx->name_literal[name] - 1;
+    if (index < first)
+        return -1;
+    while (ctx->literal_table[index].prev >= first)
+        index = ctx->literal_table[index].prev;
+    return index;
+}
+
+/* ----------------------------------------------------------------------------------
+ * 설명 : literal_table의 index를 리터럴 이름 ID에 등록하는 함수이다.
+ *        같은 이름이 앞 LTORG 범위에 있으면 그 리터럴을 prev로 연결한다.
+ * 매계 : literal_table의 index(소스 순서대로 추가해야 한다)
+ * 반환 : 없음
+ * ----------------------------------------------------------------------------------
+ */
+static void literal_insert(int index)
+{
+    int name = ctx->literal_table[index].name;
+    RESERVE_TABLE(ctx->name_literal, ctx->name_literal_capacity, name + 1);
+    ctx->literal_table[index].prev = ctx->name_literal[name] - 1;
+    ctx->name_literal[name] = index + 1;
+}
+
+/* ----------------------------------------------------------------------------------
+ * 설명 : 주소가 정해진 라인의 정보로 섹션, 심볼, 리터럴의 주소를 테이블에 저장하는 함수이다.
+ * 매계 : token_table에서의 index
+ * 반환 : 정상종료 = 0, 에러 < 0(EQU, WORD 수식을 계산할 수 없거나 섹션 이름, EXTDEF/EXTREF
+ *        이름이 오브젝트 프로그램의 이름 칸보다 길면 메시지를 출력)
+ * 주의 : EQU 수식이 앞에서 정의된 심볼을 사용하므로 소스 순서대로 호출해야 한다.
+ * ----------------------------------------------------------------------------------
+ */
+static int account_line(int line)
+{
+    token* tok = ctx->token_table[line];
+    int addr = tok->addr;   //label에 저장할 주소
+    bool absolute = false;  //label의 값이 주소가 아닌 상수이면 true
+
+    switch (tok->kind) {
+    //START 또는 CSECT이면 새로운 섹션 시작
+    case OP_START:
+    case OP_CSECT:
+        if (strlen(tok->label) > OBJECT_NAME_LENGTH) {
+            printf("account_line: 섹션 이름 %s가 %d글자보다 깁니다.\n", tok->label, OBJECT_NAME_LENGTH);
+            return -1;
+        }
+        ctx->token_line = line;
+        begin_section();
+        break;
+    //LTORG 또는 END인 경우 이 라인에 배치된 리터럴의 주소 완성
+    case OP_LTORG:
+    case OP_END:
+        while (ctx->literal_start < ctx->literal_index && ctx->literal_table[ctx->literal_start].pool_line == line) {
+            ctx->literal_table[ctx->literal_start].addr += tok->addr;
+            ctx->literal_start++;
+        }
+        break;
+    //EQU이면 현재 섹션에서 앞에 정의된 symbol로 수식 계산(상수나 섹션 안의 주소여야 함)
+    //다른 섹션의 symbol(EXTREF)은 찾지 못하므로 EXPR_EXTERNAL이 되어 에러
+    case OP_EQU: {
+        expression* expr = token_expression(tok, &ctx->asm_arena, &ctx->names);
+        int result = evaluate_expression(expr, ctx->section_index - 1, tok->addr, 0, &addr);
+        if (result != EXPR_ABSOLUTE && result != EXPR_RELATIVE) {
+            printf("account_line: %s EQU %s의 값을 계산할 수 없습니다.\n", tok->label, tok->operand[0]);
+            return -1;
+        }
+        absolute = (result == EXPR_ABSOLUTE);
+        break;
+    }
+    //D, R 레코드의 이름 칸은 고정된 길이이므로 더 긴 이름은 쓸 수 없음
+    case OP_EXTDEF:
+    case OP_EXTREF:
+        for (int i = 0; i < MAX_OPERAND; i++) {
+            if (strlen(tok->operand[i]) > OBJECT_NAME_LENGTH) {
+                printf("account_line: %s %s가 %d글자보다 깁니다.\n", tok->operator, tok->operand[i], OBJECT_NAME_LENGTH);
+                return -1;
             }
         }
-        //중복이 아니면 literal_table에 임시 저장(추가)
-        if (isNew) {
-            strcpy(literal_table[literal_index].literal, token_table[token_line]->operand[0]);
-            literal_index++;
+        break;
+    //WORD이면 패스2에서 사용할 수식을 미리 만들어 둠
+    case OP_WORD:
+        if (token_expression(tok, &ctx->asm_arena, &ctx->names)->count == 0) {
+            printf("account_line: WORD %s 수식이 잘못되었습니다.\n", tok->operand[0]);
+            return -1;
         }
+        break;
+    default:
+        break;
     }
 
+    //sym_table에 정보 저장
+    if (tok->label_id >= 0)
+        insert_symbol(tok->label_id, addr, absolute);
     return 0;
 }
 
@@ -358,50 +1038,208 @@ int search_opcode(char *str)
     //연산자가 4-byte format을 나타내기 위해 맨 앞에 '+'를 사용한 경우 예외 처리
     if (str[0] == '+')
         str = str + 1;
-    //입력받은 연산자가 inst_table에 존재하는지 검색
-    inst_index = 0;
-    while (inst_table[inst_index] != NULL && inst_index < MAX_LINES) {
-        if (strcmp(str, inst_table[inst_index]->name) == 0) {
-            return inst_index;  //존재할 경우 inst_table의 해당 연산자의 index값 리턴
-        }
-        inst_index++;
-    }
+    //해시 테이블이 없으면(inst_table이 비어있으면) 탐색 실패
+    if (inst_hash == NULL)
+        return -1;
+    //해시 값이 가리키는 슬롯의 명령어와 한 번만 비교
+    int slot = inst_hash[hash_string(str, inst_hash_seed) & inst_hash_mask];
+    STAT_ADD(STAT_OPCODE_SEARCH, 1);
+    STAT_ADD(STAT_OPCODE_PROBE, slot != 0);
+    if (slot != 0 && strcmp(str, inst_table[slot - 1]->name) == 0)
+        return slot - 1;        //존재할 경우 inst_table의 해당 연산자의 index값 리턴
     return -1;                  //존재하지 않을 경우 -1 리턴
 }
 
+/* ----------------------------------------------------------------------------------
+ * 설명 : 기계 명령어의 실제 byte 형식을 알려주는 함수이다.
+ *        3-byte format 명령어 앞에 '+'가 붙은 경우 4-byte format으로 판단한다.
+ * 매계 : 토큰 단위로 구분된 연산자 문자열, search_opcode()로 찾은 inst_table의 index
+ * 반환 : 정상종료 = byte 형식(1~4), 에러 < 0
+ * ----------------------------------------------------------------------------------
+ */
+int search_format(char *str, int opcode)
+{
+    if (opcode < 0)
+        return -1;
+    if (str[0] == '+' && inst_table[opcode]->format == 3)
+        return 4;
+    return inst_table[opcode]->format;
+}
+
+/* ----------------------------------------------------------------------------------
+ * 설명 : 기계 명령어가 아닌 operator의 종류를 알려주는 함수이다.
+ * 매계 : 토큰 단위로 구분된 연산자 문자열
+ * 반환 : 지시어이면 해당 OP_* 값, 아니면 OP_NONE
+ * 주의 : 기계 명령어인지는 search_opcode()로 먼저 확인해야 한다.
+ * ----------------------------------------------------------------------------------
+ */
+static int search_directive(char *str)
+{
+    if (str[0] == '\0')
+        return OP_NONE;
+    for (int kind = OP_START; kind < OP_COUNT; kind++) {
+        if (strcmp(str, directive_names[kind]) == 0)
+            return kind;
+    }
+    return OP_NONE;
+}
+
 /* ----------------------------------------------------------------------------------
  * 설명 : 입력 문자열이 sym_table에 속해있는지 검사하는 함수이다.
  * 매계 : symbol이라고 생각되는 문자열, 해당 루틴의 번호(-1이면 테이블 전체에서 검색)
  * 반환 : 정상종료 = 해당 symbol의 addr값, 에러 < 0
-* -----------------------------------------------------------------------------------
-*/
+ * -----------------------------------------------------------------------------------
+ */
 int search_symbol(char* str, int subRoutine)
 {
-    int sym_index = 0;
-    int routineCnt = 0;
-    bool searchAll = false;
-    if (subRoutine == -1)
-        searchAll = true;
-    //입력받은 연산자가 해당 subRoutine의 sym_table에 존재하는지 검색
-    while (strlen(sym_table[sym_index].symbol) != 0 && sym_index < MAX_LINES) {
-        //루틴 찾아가기
-        if (strcmp("\n", sym_table[sym_index].symbol) == 0)
-            routineCnt++;
-        if (!searchAll && routineCnt != subRoutine) {
-            sym_index++;
-            continue;
-        }
+    return search_name(intern_find(&ctx->names, str), subRoutine);
+}
+
+/* ----------------------------------------------------------------------------------
+ * 설명 : search_symbol()과 같지만 symbol 이름 대신 이름의 ID로 찾는 함수이다.
+ * 매계 : symbol 이름의 ID(없는 이름이면 -1), 해당 루틴의 번호(-1이면 테이블 전체에서 검색)
+ * 반환 : 정상종료 = 해당 symbol의 addr값, 에러 < 0
+ * -----------------------------------------------------------------------------------
+ */
+int search_name(int name, int subRoutine)
+{
+    int index = find_symbol(name, subRoutine);
+
+    if (index == -1)
+        return -1;              //존재하지 않을 경우 -1 리턴
+    return ctx->sym_table[index].addr;
+}
 
-        //해당 루틴에 symbol이 존재할 경우 symbol의 addr값 리턴
-        if (strcmp(str, sym_table[sym_index].symbol) == 0)
-            return sym_table[sym_index].addr;  
-        sym_index++;
+/* ----------------------------------------------------------------------------------
+ * 설명 : search_name()과 같지만 주소 대신 sym_table의 index를 알려주는 함수이다.
+ * 매계 : symbol 이름의 ID(없는 이름이면 -1), 해당 루틴의 번호(-1이면 테이블 전체에서 검색)
+ * 반환 : 정상종료 = sym_table의 index, 에러 < 0
+ * -----------------------------------------------------------------------------------
+ */
+static int find_symbol(int name, int subRoutine)
+{
+    if (name < 0 || name >= ctx->name_symbol_capacity || ctx->name_symbol[name] == 0)
+        return -1;
+    //처음 정의된 심볼이 해당 루틴에 있으면 바로 사용, 아니면 해당 루틴의 해시 테이블에서 검색
+    int index = ctx->name_symbol[name] - 1;
+    if (subRoutine >= 0 && subRoutine < ctx->section_index) {
+        section* sec = &ctx->section_table[subRoutine];
+        if (index < sec->sym_start || index >= sec->sym_start + sec->sym_count)
+            index = sym_hash_find(&sec->hash, name);
     }
-    return -1;                  //존재하지 않을 경우 -1 리턴
+    else if (subRoutine != -1)
+        index = -1;
+    return index;
 }
 
 /* ----------------------------------------------------------------------------------
-* 설명 : 어셈블리 코드를 위한 패스1과정을 수행하는 함수이다.
+ * 설명 : 해시 테이블에서 symbol 이름에 해당하는 sym_table의 index를 찾는 함수이다.
+ * 매계 : 검색할 해시 테이블, symbol 이름의 ID
+ * 반환 : 정상종료 = sym_table의 index, 에러 < 0
+ * -----------------------------------------------------------------------------------
+ */
+static int sym_hash_find(sym_hash* hash, int name)
+{
+    if (hash->slot == NULL)
+        return -1;
+    //빈 슬롯이 나올 때까지 선형 탐색(linear probing)
+    unsigned int i = hash_id(name) & hash->mask;
+    STAT_ADD(STAT_SYMBOL_SEARCH, 1);
+    while (hash->slot[i] != 0) {
+        STAT_ADD(STAT_SYMBOL_PROBE, 1);
+        if (ctx->sym_table[hash->slot[i] - 1].name == name)
+            return hash->slot[i] - 1;
+        i = (i + 1) & hash->mask;
+    }
+    return -1;
+}
+
+/* ----------------------------------------------------------------------------------
+ * 설명 : sym_table의 index를 해시 테이블에 추가하는 함수이다.
+ *        같은 이름이 이미 있으면 먼저 정의된 심볼을 유지한다.
+ * 매계 : 추가할 해시 테이블, sym_table의 index
+ * 반환 : 없음
+ * 주의 : 슬롯의 절반 이상이 차면 두 배 크기로 다시 만든다.
+ * -----------------------------------------------------------------------------------
+ */
+static void sym_hash_insert(sym_hash* hash, int index)
+{
+    if (sym_hash_find(hash, ctx->sym_table[index].name) != -1)
+        return;
+
+    //처음 추가하거나 테이블이 절반 이상 찬 경우 두 배로 늘려서 다시 배치
+    if (hash->slot == NULL || (unsigned int)(hash->count + 1) * 2 > hash->mask + 1) {
+        unsigned int size = (hash->slot == NULL) ? 16 : (hash->mask + 1) * 2;
+        int* oldSlot = hash->slot;
+        unsigned int oldSize = (hash->slot == NULL) ? 0 : hash->mask + 1;
+        hash->slot = (int*)calloc(size, sizeof(int));
+        hash->mask = size - 1;
+        for (unsigned int i = 0; i < oldSize; i++) {
+            if (oldSlot[i] == 0)
+                continue;
+            unsigned int j = hash_id(ctx->sym_table[oldSlot[i] - 1].name) & hash->mask;
+            while (hash->slot[j] != 0)
+                j = (j + 1) & hash->mask;
+            hash->slot[j] = oldSlot[i];
+        }
+        free(oldSlot);
+    }
+
+    unsigned int i = hash_id(ctx->sym_table[index].name) & hash->mask;
+    while (hash->slot[i] != 0)
+        i = (i + 1) & hash->mask;
+    hash->slot[i] = index + 1;
+    hash->count++;
+}
+
+/* ----------------------------------------------------------------------------------
+ * 설명 : 새로운 컨트롤 섹션을 section_table에 추가하는 함수이다.
+ *        START 또는 CSECT를 만났을 때 패스1에서 호출된다.
+ * 매계 : 없음
+ * 반환 : 없음
+ * -----------------------------------------------------------------------------------
+ */
+static void begin_section(void)
+{
+    RESERVE_TABLE(ctx->section_table, ctx->section_capacity, ctx->section_index + 1);
+    ctx->section_table[ctx->section_index].sym_start = ctx->sym_index;
+    ctx->section_table[ctx->section_index].sym_count = 0;
+    memset(&ctx->section_table[ctx->section_index].hash, 0, sizeof(sym_hash));
+    ctx->section_table[ctx->section_index].line_start = ctx->token_line;
+    ctx->section_table[ctx->section_index].literal_begin = ctx->literal_start;
+    ctx->section_index++;
+}
+
+/* ----------------------------------------------------------------------------------
+ * 설명 : 현재 컨트롤 섹션에 symbol을 추가하는 함수이다.
+ *        sym_table에 저장한 뒤 이름 ID에 등록하고, 앞에서 이미 정의된 이름이면
+ *        섹션의 해시 테이블에 등록한다.
+ * 매계 : symbol 이름의 ID, symbol의 주소(값), 주소가 아닌 상수이면 true
+ * 반환 : 없음
+ * 주의 : START 이전에 나온 symbol은 첫 섹션에 포함시킨다.
+ *        대부분의 이름은 한 번만 정의되므로 섹션의 해시 테이블은 거의 비어 있다.
+ * -----------------------------------------------------------------------------------
+ */
+static void insert_symbol(int name, int addr, bool absolute)
+{
+    if (ctx->section_index == 0)
+        begin_section();
+
+    RESERVE_TABLE(ctx->sym_table, ctx->sym_capacity, ctx->sym_index + 1);
+    ctx->sym_table[ctx->sym_index].name = name;
+    ctx->sym_table[ctx->sym_index].addr = addr;
+    ctx->sym_table[ctx->sym_index].absolute = absolute;
+    RESERVE_TABLE(ctx->name_symbol, ctx->name_symbol_capacity, name + 1);
+    if (ctx->name_symbol[name] == 0)
+        ctx->name_symbol[name] = ctx->sym_index + 1;
+    else
+        sym_hash_insert(&ctx->section_table[ctx->section_index - 1].hash, ctx->sym_index);
+    ctx->section_table[ctx->section_index - 1].sym_count++;
+    ctx->sym_index++;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 어셈블리 코드를 위한 패스1과정을 수행하는 함수이다.
 *		   패스1에서는..
 *		   1. 프로그램 소스를 스캔하여 해당하는 토큰단위로 분리하여 프로그램 라인별 토큰
 *		   테이블을 생성한다.
@@ -410,6 +1248,11 @@ int search_symbol(char* str, int subRoutine)
 * 반환 : 정상 종료 = 0 , 에러 = < 0
 * 주의 : 현재 초기 버전에서는 에러에 대한 검사를 하지 않고 넘어간 상태이다.
 *	  따라서 에러에 대한 검사 루틴을 추가해야 한다.
+*        token_parsing()의 과정을 다음 단계로 나누어 수행한다.
+*        1. 라인들을 구간으로 나누어 동시에 토큰으로 분리하고 라인의 크기를 계산한다.
+*        2. 리터럴을 모으고 LTORG/END 라인의 크기를 계산한다.(순서대로)
+*        3. 구간별 크기 합을 CSECT에서 다시 시작하는 prefix sum으로 누적하여 라인의 주소를 구한다.
+*        4. 라인의 주소로 섹션, 심볼, 리터럴 테이블을 채운다.(순서대로)
 * -----------------------------------------------------------------------------------
 */
 static int assem_pass1(void)
@@ -417,16 +1260,411 @@ static int assem_pass1(void)
 	/* input_data의 문자열을 한줄씩 입력 받아서 
 	 * token_parsing()을 호출하여 token_unit에 저장
 	 */
-    line_num = 0;
-    while (input_data[line_num] != NULL && line_num < MAX_LINES) {
-        if (token_parsing(input_data[line_num]) < 0)
+    STAT_PHASE(PHASE_PASS1);
+    int lineCount = ctx->line_num;   //init_input_file()에서 읽은 라인 수
+    RESERVE_TABLE(ctx->token_table, ctx->token_capacity, lineCount);
+    if (lineCount == 0)
+        return 0;
+
+    //토큰은 한 번에 연속된 공간으로 할당
+    token* units = (token*)arena_alloc(&ctx->asm_arena, sizeof(token) * lineCount);
+    for (int i = 0; i < lineCount; i++)
+        ctx->token_table[i] = &units[i];
+
+    //섹션 캐시를 사용하면 섹션별로 캐시 파일을 찾고, 찾은 섹션은 토큰 분리를 건너뜀
+    if (cache_dir != NULL) {
+        cache_split();
+        run_parallel(ctx->cache_count, cache_load_job, NULL);
+        for (int k = 0; k < ctx->cache_count; k++) {
+            if (ctx->cache_table[k].data == NULL)
+                continue;
+            for (int i = ctx->cache_table[k].line_start; i < ctx->cache_table[k].line_end; i++)
+                ctx->token_table[i] = &cached_token;
+        }
+    }
+
+    //라인들을 스레드 수보다 넉넉한 개수의 구간으로 나누기
+    int chunkCnt = get_thread_count() * 4;
+    if (chunkCnt > lineCount / PASS1_MIN_CHUNK)
+        chunkCnt = lineCount / PASS1_MIN_CHUNK;
+    if (chunkCnt < 1)
+        chunkCnt = 1;
+    pass1_chunk* chunks = (pass1_chunk*)calloc(chunkCnt, sizeof(pass1_chunk));
+    if (chunks == NULL)
+        return -1;
+    for (int i = 0; i < chunkCnt; i++) {
+        chunks[i].line_start = (int)((long long)lineCount * i / chunkCnt);
+        chunks[i].line_end = (int)((long long)lineCount * (i + 1) / chunkCnt);
+    }
+
+    //1. 토큰 분리와 라인 크기 계산(이름은 구간별로 ID를 붙인 뒤 소스 순서대로 names로 옮김)
+    run_parallel(chunkCnt, pass1_tokenize_job, chunks);
+    bool isError = false;
+    for (int i = 0; i < chunkCnt; i++)
+        isError = isError || chunks[i].error;
+    for (int i = 0; i < chunkCnt; i++) {
+        if (isError)
+            intern_release(&chunks[i].names);
+        else
+            intern_merge(&chunks[i].names, chunks[i].line_start, chunks[i].line_end);
+    }
+    if (isError) {
+        free(chunks);
+        return -1;
+    }
+
+    //캐시에서 가져올 섹션이 앞 섹션들과 여전히 독립적인지 확인
+    if (cache_dir != NULL && cache_validate() < 0) {
+        free(chunks);
+        return -1;
+    }
+
+    //2. 리터럴 수집과 LTORG/END 크기 계산(캐시에서 가져오는 섹션은 리터럴을 그대로 추가)
+    int cursor = 0;
+    for (int i = 0; i < lineCount; i++) {
+        section_cache* cache = cache_at(&cursor, i);
+        if (cache != NULL) {
+            cache_replay_literals(cache);
+            i = cache->line_end - 1;
+            continue;
+        }
+        pool_literals(i);
+    }
+
+    //3. 구간별 합 계산 -> 구간의 시작 주소 누적 -> 라인별 주소 계산
+    run_parallel(chunkCnt, pass1_sum_job, chunks);
+    int carry = 0;
+    for (int i = 0; i < chunkCnt; i++) {
+        chunks[i].carry = carry;
+        carry = chunks[i].reset ? chunks[i].total : carry + chunks[i].total;
+    }
+    run_parallel(chunkCnt, pass1_address_job, chunks);
+    free(chunks);
+
+    //4. 섹션, 심볼, 리터럴 테이블 채우기(캐시에서 가져오는 섹션은 심볼을 그대로 추가)
+    cursor = 0;
+    for (int i = 0; i < lineCount; i++) {
+        section_cache* cache = cache_at(&cursor, i);
+        if (cache != NULL) {
+            cache_replay_symbols(cache);
+            i = cache->line_end - 1;
+            continue;
+        }
+        if (account_line(i) < 0)
+            return -1;
+    }
+
+    ctx->line_num = lineCount;
+    ctx->locctr = carry;
+    STAT_ADD(STAT_SECTIONS, ctx->section_index);
+    return 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 패스1의 1단계로, 구간의 라인들을 토큰으로 분리하고 크기를 계산하는 함수이다.
+* 매계 : pass1_chunk 배열, 처리할 구간의 index
+* 반환 : 없음(에러가 있으면 구간의 error에 표시)
+* -----------------------------------------------------------------------------------
+*/
+static void pass1_tokenize_job(void* arg, int index)
+{
+    pass1_chunk* chunk = (pass1_chunk*)arg + index;
+    for (int i = chunk->line_start; i < chunk->line_end; i++) {
+        //캐시에서 가져오는 섹션의 라인은 건너뜀
+        if (ctx->token_table[i] == &cached_token)
+            continue;
+        if (tokenize_source(i, ctx->token_table[i]) < 0) {
+            chunk->error = true;
+            return;
+        }
+        intern_token(ctx->token_table[i], &chunk->names);
+    }
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 패스1의 3단계 중 구간의 크기 합을 계산하는 함수이다.
+*        구간 안에 CSECT가 있으면 마지막 CSECT부터의 합을 저장한다.
+* 매계 : pass1_chunk 배열, 처리할 구간의 index
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void pass1_sum_job(void* arg, int index)
+{
+    pass1_chunk* chunk = (pass1_chunk*)arg + index;
+    int total = 0;
+    for (int i = chunk->line_start; i < chunk->line_end; i++) {
+        if (ctx->token_table[i]->kind == OP_CSECT) {
+            total = 0;
+            chunk->reset = true;
+        }
+        total += ctx->token_table[i]->size;
+    }
+    chunk->total = total;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 패스1의 3단계 중 구간의 시작 주소(carry)부터 라인별 주소를 계산하는 함수이다.
+* 매계 : pass1_chunk 배열, 처리할 구간의 index
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void pass1_address_job(void* arg, int index)
+{
+    pass1_chunk* chunk = (pass1_chunk*)arg + index;
+    int addr = chunk->carry;
+    for (int i = chunk->line_start; i < chunk->line_end; i++) {
+        //CSECT이면 주소 0으로 초기화
+        if (ctx->token_table[i]->kind == OP_CSECT)
+            addr = 0;
+        if (ctx->token_table[i] != &cached_token)
+            ctx->token_table[i]->addr = addr;
+        addr += ctx->token_table[i]->size;
+    }
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 0x00 ~ 0xFF의 16진수 두 자리 문자열을 미리 계산해둔 표이다.
+*        hex_table[byte * 2], hex_table[byte * 2 + 1]이 byte의 상위, 하위 자리이다.
+* -----------------------------------------------------------------------------------
+*/
+static const char hex_table[513] =
+    "000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F"
+    "202122232425262728292A2B2C2D2E2F303132333435363738393A3B3C3D3E3F"
+    "404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F"
+    "606162636465666768696A6B6C6D6E6F707172737475767778797A7B7C7D7E7F"
+    "808182838485868788898A8B8C8D8E8F909192939495969798999A9B9C9D9E9F"
+    "A0A1A2A3A4A5A6A7A8A9AAABACADAEAFB0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF"
+    "C0C1C2C3C4C5C6C7C8C9CACBCCCDCECFD0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF"
+    "E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEFF0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
+
+//스레드마다 한 번 할당하여 계속 사용하는 출력 버퍼
+static _Thread_local char* writer_buffer;
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 출력 파일(또는 표준출력)을 열고 버퍼를 준비하는 함수이다.
+* 매계 : 준비할 writer, 출력 파일 이름(NULL이면 표준출력)
+* 반환 : 정상종료 = 0, 에러 < 0
+* -----------------------------------------------------------------------------------
+*/
+static int writer_open(writer* out, char* file_name)
+{
+    if (writer_buffer == NULL) {
+        writer_buffer = (char*)malloc(WRITER_BUFFER_SIZE);
+        if (writer_buffer == NULL)
             return -1;
-        line_num++;
     }
+    out->buffer = writer_buffer;
+    out->used = 0;
+    out->error = false;
+    out->memory = NULL;
+    out->memory_size = 0;
+    out->memory_capacity = 0;
+    if (file_name == NULL) {
+        //printf()로 출력한 내용이 먼저 나오도록 비움
+        fflush(stdout);
+        out->fd = STDOUT_FILENO;
+        return 0;
+    }
+    out->fd = open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    return (out->fd < 0) ? -1 : 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 파일 대신 메모리(out->memory)에 내용을 모으는 writer를 여는 함수이다.
+*        출력한 내용을 파일에 쓰지 않고 비교할 때 사용한다.
+* 매계 : writer
+* 반환 : 없음
+* 주의 : 모인 내용은 writer_flush() 뒤에 memory, memory_size로 읽고 free()로 해제한다.
+* -----------------------------------------------------------------------------------
+*/
+static void writer_open_memory(writer* out)
+{
+    writer_open(out, NULL);
+    out->fd = -1;
+}
 
+/* ----------------------------------------------------------------------------------
+* 설명 : 어셈블리 결과(오브젝트, 심볼, 리터럴 테이블)를 출력할 writer를 여는 함수이다.
+*        서버 모드처럼 ctx->capture가 있으면 파일 대신 메모리에 모은다.
+* 매계 : 준비할 writer, 출력 파일 이름(NULL이면 표준출력)
+* 반환 : 정상종료 = 0, 에러 < 0
+* -----------------------------------------------------------------------------------
+*/
+static int output_open(writer* out, char* file_name)
+{
+    if (ctx->capture == NULL)
+        return writer_open(out, file_name);
+    writer_open_memory(out);
     return 0;
 }
 
+/* ----------------------------------------------------------------------------------
+* 설명 : output_open()으로 연 writer를 닫는 함수이다. 메모리에 모은 경우 내용을
+*        ctx->capture의 결과 종류 자리에 넘긴다.
+* 매계 : writer, 결과 종류(enum output_kind)
+* 반환 : 정상종료 = 0, 출력 중 에러가 있었으면 < 0
+* -----------------------------------------------------------------------------------
+*/
+static int output_close(writer* out, int kind)
+{
+    if (ctx->capture == NULL)
+        return writer_close(out);
+    writer_flush(out);
+    free(ctx->capture[kind].memory);
+    ctx->capture[kind] = *out;
+    return out->error ? -1 : 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 버퍼에 모인 내용을 write()로 내보내는 함수이다.
+* 매계 : writer
+* 반환 : 없음(실패하면 writer의 error에 표시)
+* -----------------------------------------------------------------------------------
+*/
+static void writer_flush(writer* out)
+{
+    //메모리에 모으는 경우 버퍼 내용을 이어 붙이기(빈 결과는 memory를 할당하지 않음)
+    if (out->fd < 0 && !out->error) {
+        if (out->used == 0)
+            return;
+        RESERVE_TABLE(out->memory, out->memory_capacity, (int)(out->memory_size + out->used));
+        memcpy(out->memory + out->memory_size, out->buffer, out->used);
+        out->memory_size += out->used;
+        out->used = 0;
+        return;
+    }
+    size_t done = 0;
+    while (done < out->used && !out->error) {
+        ssize_t written = write(out->fd, out->buffer + done, out->used - done);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            out->error = true;
+        else
+            done += (size_t)written;
+    }
+    out->used = 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 남은 내용을 내보내고 출력 파일을 닫는 함수이다.(표준출력은 닫지 않는다)
+* 매계 : writer
+* 반환 : 정상종료 = 0, 출력 중 에러가 있었으면 < 0
+* -----------------------------------------------------------------------------------
+*/
+static int writer_close(writer* out)
+{
+    writer_flush(out);
+    if (out->fd != STDOUT_FILENO && out->fd >= 0 && close(out->fd) < 0)
+        out->error = true;
+    return out->error ? -1 : 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 버퍼에 size byte를 쓸 공간을 확보하고 쓸 위치를 돌려주는 함수이다.
+* 매계 : writer, 필요한 크기(WRITER_BUFFER_SIZE 이하)
+* 반환 : 버퍼에서 쓸 위치(호출한 쪽에서 size byte를 채워야 한다)
+* -----------------------------------------------------------------------------------
+*/
+static char* writer_reserve(writer* out, size_t size)
+{
+    if (out->used + size > WRITER_BUFFER_SIZE)
+        writer_flush(out);
+    char* position = out->buffer + out->used;
+    out->used += size;
+    return position;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : size byte의 데이터를 그대로 출력하는 함수이다.(binary 파일)
+* -----------------------------------------------------------------------------------
+*/
+static void writer_bytes(writer* out, const void* data, size_t size)
+{
+    const char* position = (const char*)data;
+    while (size > 0) {
+        size_t chunk = (size > WRITER_BUFFER_SIZE / 2) ? WRITER_BUFFER_SIZE / 2 : size;
+        memcpy(writer_reserve(out, chunk), position, chunk);
+        position += chunk;
+        size -= chunk;
+    }
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 문자 하나를 출력하는 함수이다.
+* -----------------------------------------------------------------------------------
+*/
+static void writer_char(writer* out, char c)
+{
+    *writer_reserve(out, 1) = c;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 문자열을 출력하는 함수이다. 문자열이 width보다 짧으면 뒤를 공백으로 채운다.("%-6s")
+* 매계 : writer, 문자열, 최소 폭(0이면 채우지 않음)
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void writer_string(writer* out, const char* str, int width)
+{
+    size_t length = strlen(str);
+    size_t total = (length < (size_t)width) ? (size_t)width : length;
+    //버퍼보다 긴 문자열은 나누어 복사
+    while (length > WRITER_BUFFER_SIZE / 2) {
+        memcpy(writer_reserve(out, WRITER_BUFFER_SIZE / 2), str, WRITER_BUFFER_SIZE / 2);
+        str += WRITER_BUFFER_SIZE / 2;
+        length -= WRITER_BUFFER_SIZE / 2;
+        total -= WRITER_BUFFER_SIZE / 2;
+    }
+    char* position = writer_reserve(out, total);
+    memcpy(position, str, length);
+    memset(position + length, ' ', total - length);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 정수를 대문자 16진수로 출력하는 함수이다.("%0*X"와 같은 결과)
+*        hex_table로 한 번에 두 자리씩 채운다.
+* 매계 : writer, 출력할 값, 최소 자리 수
+* 반환 : 없음
+* 주의 : 음수는 unsigned int로 출력하므로(printf와 같이) 8자리가 된다.
+* -----------------------------------------------------------------------------------
+*/
+static void writer_hex(writer* out, int value, int digits)
+{
+    unsigned int number = (unsigned int)value;
+    int length = 1;
+    while (length < 8 && (number >> (length * 4)) != 0)
+        length++;
+    if (length < digits)
+        length = digits;
+
+    char* position = writer_reserve(out, (size_t)length);
+    int i = length;
+    while (i >= 2) {
+        memcpy(position + i - 2, hex_table + (number & 0xFF) * 2, 2);
+        number >>= 8;
+        i -= 2;
+    }
+    if (i == 1)
+        position[0] = hex_table[(number & 0xF) * 2 + 1];
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : M 레코드 하나를 출력하는 함수이다.("M%06X%02X%s\n")
+* 매계 : writer, M 레코드
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void write_modify_record(writer* out, modify* object)
+{
+    STAT_ADD(STAT_M_RECORDS, 1);
+    writer_char(out, 'M');
+    writer_hex(out, object->addr, 6);
+    writer_hex(out, object->format, 2);
+    writer_string(out, object->name, 0);
+    writer_char(out, '\n');
+}
+
 /* ----------------------------------------------------------------------------------
 * 설명 : 입력된 문자열의 이름을 가진 파일에 프로그램의 결과를 저장하는 함수이다.
 *        여기서 출력되는 내용은 명령어 옆에 OPCODE가 기록된 표(과제 5번) 이다.
@@ -454,30 +1692,32 @@ static int assem_pass1(void)
 */
 void make_symtab_output(char *file_name)
 {
-    FILE* file;
-    //출력 파일 열기
-    if (file_name != NULL) {
-        if ((file = fopen(file_name, "w")) == NULL)
-            exit(1);
-    }   //출력 파일 이름이 없는 경우(NULL)
-    else
-        file = stdout;  //표준출력으로 대체
+    writer out;
+    STAT_PHASE(PHASE_SYMTAB);
+    //출력 파일 열기(파일 이름이 없는 경우(NULL) 표준출력으로 대체)
+    if (output_open(&out, file_name) < 0)
+        exit(1);
 
-    sym_index = 0;
-    prevLoc = 0;
-    //sym_table 정보 출력
-    while (strlen(sym_table[sym_index].symbol) != 0 && sym_index < MAX_LINES) {
-        //루틴별로 개행
-        if (strcmp(sym_table[sym_index].symbol, "\n") == 0) {
-            fprintf(file, "\n");
-            sym_index++;
+    bool isFirst = true;
+    //sym_table 정보를 섹션 단위로 출력
+    for (int i = 0; i < ctx->section_index; i++) {
+        if (ctx->section_table[i].sym_count == 0)
             continue;
-        }
+        //루틴별로 개행
+        if (!isFirst)
+            writer_char(&out, '\n');
+        isFirst = false;
 
-        fprintf(file, "%s\t\t%04X\n", sym_table[sym_index].symbol, sym_table[sym_index].addr);
-        prevLoc = sym_table[sym_index].addr;
-        sym_index++;
+        int end = ctx->section_table[i].sym_start + ctx->section_table[i].sym_count;
+        for (int j = ctx->section_table[i].sym_start; j < end; j++)
+        {
+            writer_string(&out, ctx->names.entry[ctx->sym_table[j].name].name, 0);
+            writer_string(&out, "\t\t", 0);
+            writer_hex(&out, ctx->sym_table[j].addr, 4);
+            writer_char(&out, '\n');
+        }
     }
+    output_close(&out, OUTPUT_SYMTAB);
     return;
 }
 
@@ -492,29 +1732,24 @@ void make_symtab_output(char *file_name)
 */
 void make_literaltab_output(char *file_name)
 {
-    FILE* file;
-    //출력 파일 열기
-    if (file_name != NULL) {
-        if ((file = fopen(file_name, "w")) == NULL)
-            exit(1);
-    }   //출력 파일 이름이 없는 경우(NULL)
-    else
-        file = stdout;  //표준출력으로 대체
+    writer out;
+    STAT_PHASE(PHASE_LITERAL);
+    //출력 파일 열기(파일 이름이 없는 경우(NULL) 표준출력으로 대체)
+    if (output_open(&out, file_name) < 0)
+        exit(1);
 
-    literal_index = 0;
-    //sym_table 정보 출력
-    while (strlen(literal_table[literal_index].literal) != 0 && literal_index < MAX_LINES) {
-        char tempLiteral[10];
-        char* literalP = literal_table[literal_index].literal + 3;
-        int i = 0;
-        //"=C'ABC'"의 형태로 저장했기 때문에 리터럴만 출력하기 위해 처리
-        for (; i < strlen(literal_table[literal_index].literal) - 4; i++, literalP++)
-            tempLiteral[i] = *literalP;
-        tempLiteral[i] = '\0';
-
-        fprintf(file, "%s\t\t%04X\n", tempLiteral, literal_table[literal_index].addr);
-        literal_index++;
+    //literal_table 정보 출력
+    for (int j = 0; j < ctx->literal_index; j++) {
+        char* name = ctx->names.entry[ctx->literal_table[j].name].name;
+        //"=C'ABC'"의 형태로 저장했기 때문에 따옴표 안의 리터럴만 출력
+        int length = (int)strlen(name) - 4;
+        if (length > 0)
+            writer_bytes(&out, name + 3, (size_t)length);
+        writer_string(&out, "\t\t", 0);
+        writer_hex(&out, ctx->literal_table[j].addr, 4);
+        writer_char(&out, '\n');
     }
+    output_close(&out, OUTPUT_LITERAL);
     return;
 }
 
@@ -525,522 +1760,5866 @@ void make_literaltab_output(char *file_name)
 *		   1. 실제로 해당 어셈블리 명령어를 기계어로 바꾸는 작업을 수행한다.
 * 매계 : 없음
 * 반환 : 정상종료 = 0, 에러발생 = < 0
+* 주의 : 각 섹션(START/CSECT)은 패스1이 끝나면 서로 독립적이므로 섹션 단위로 나누어
+*        스레드 풀에서 동시에 처리하고, 결과를 소스 순서대로 code_table에 이어 붙인다.
 * -----------------------------------------------------------------------------------
 */
 static int assem_pass2(void)
 {
-    token_line = 0;
-    code_index = 0;
-    locctr = 0;
-    prevLoc = 0;
-    sym_index = 0;
-    literal_index = 0;
-    int subRoutine = -1;    //현재 루틴의 번호 저장
-    char extrefList[3][MAX_TOKEN_LENGTH] = { 0, };  //EXTREF 변수 저장
-    char tempLiteral[10];   //리터럴 임시 저장
-    char* literalP;
-    char tempSymbol[10];    //Symbol 임시 저장
-    char* symbolP;
-    int startIndex = 0;     //현재 루틴의 시작 index
-
-    ///////////////token_table을 하나씩 읽어나가며 code_table에 정보 저장///////////////
-    while (token_table[token_line] != NULL && token_line < MAX_LINES) {
-        prevLoc = locctr;
-        //루틴의 시작인 경우
-        if (strcmp(token_table[token_line]->operator, "START") == 0 || strcmp(token_table[token_line]->operator, "CSECT") == 0) {
-            //이전 루틴의 길이를 이전 H 레코드에 저장
-            code_table[startIndex].addr = prevLoc;
-
-            //현재 루틴의 H 레코드 정보 저장
-            code_table[code_index].format = 0;
-            code_table[code_index].line_index = token_line;
-            code_table[code_index].record = 'H';
-
-            startIndex = code_index;
-            code_index++;
-            subRoutine++;
-            locctr = 0;
-        }
-        //EXTDEF인 경우
-        else if (strcmp(token_table[token_line]->operator, "EXTDEF") == 0) {
-            int i = 0;
-            //개수 세기
-            while (strlen(token_table[token_line]->operand[i]) != 0)
-                i++;
-            //D 레코드 정보 저장
-            code_table[code_index].format = i;
-            code_table[code_index].line_index = token_line;
-            code_table[code_index].record = 'D';
-            code_index++;
-        }
-        //EXTREF인 경우 extrefList에 정보 저장
-        else if (strcmp(token_table[token_line]->operator, "EXTREF") == 0) {
-            memset(extrefList, 0, sizeof(extrefList));
-            int i = 0;
-            //개수 세기
-            while (strlen(token_table[token_line]->operand[i]) != 0) {
-                strcpy(extrefList[i], token_table[token_line]->operand[i]);
-                i++;
-            }
-
-            //R 레코드 정보 저장
-            code_table[code_index].format = i;
-            code_table[code_index].line_index = token_line;
-            code_table[code_index].record = 'R';
-            code_index++;
-        }
-        int opcode = search_opcode(token_table[token_line]->operator);
-        //소스코드가 기계 명령어인 경우
-            //nixbpe 파악하기
-        if (opcode != -1) {
-            //ni 비트 채우기
-                //2-byte format이면
-            if (inst_table[opcode]->format == 2) {
-                token_table[token_line]->nixbpe = 0x00; //00 XXXX
-            }
-                //immediate addressing이면
-            else if (token_table[token_line]->operand[0][0] == '#') {
-                token_table[token_line]->nixbpe = 0x10; //01 XXXX
-            }
-                //indirect addressing이면
-            else if (token_table[token_line]->operand[0][0] == '@') {
-                token_table[token_line]->nixbpe = 0x20; //10 XXXX
-            }
-                //위의 모든 조건이 아니면(direct addressing)
-            else {
-                token_table[token_line]->nixbpe = 0x30; //11 XXXX
-            }
-
-            //xbpe 비트 채우기
-                //2-byte format이면
-            if (token_table[token_line]->nixbpe == 0x00) {
-                token_table[token_line]->nixbpe |= 0x00;    //XX 0000
-            }
-            else {
-                //X 레지스터를 사용하면
-                if (strcmp(token_table[token_line]->operand[1], "X") == 0) {
-                    token_table[token_line]->nixbpe |= 0x08;    //XX 1XXX
-                }
-                //4-byte format이면
-                if (token_table[token_line]->operator[0] == '+') {
-                    token_table[token_line]->nixbpe |= 0x01;    //XX XXX1
-                }
-                int i = 0;
-                bool isExtref = false;
-                //EXTREF를 통해 외부참조를 하는 경우
-                while (strlen(extrefList[i]) != 0) {
-                    if (strcmp(extrefList[i], token_table[token_line]->operand[0]) == 0) {
-                        isExtref = true;
-                        token_table[token_line]->nixbpe |= 0x00;    //XX XX0X
-                    }
-                    i++;
-                }
-                //immediate addressing
-                if ((token_table[token_line]->nixbpe & 0x30) == 0x10) {
-                    token_table[token_line]->nixbpe |= 0x00;    //XX XX0X
-                }
-                //위의 두 경우가 아닌경우
-                else if (isExtref == false) {
-                    token_table[token_line]->nixbpe |= 0x02;    //XX XX1X
-                }
-            }
+    STAT_PHASE(PHASE_PASS2);
+    //첫 섹션 이전에 라인이 있으면 그 부분도 하나의 작업으로 처리
+    int prologue = (ctx->section_index == 0 || ctx->section_table[0].line_start > 0) ? 1 : 0;
+    int unitCnt = ctx->section_index + prologue;
+    pass2* units = (pass2*)calloc(unitCnt, sizeof(pass2));
+    if (units == NULL)
+        return -1;
 
-            //뒷자리(displacement) 계산
-            int format = inst_table[opcode]->format;    //2,3,4
-            if ((token_table[token_line]->nixbpe & 0x01) == 0x01)
-                format = 4;
-            locctr += format;   //주소 계산
-            int i = 0;
-            char tempRegister[2] = { 0, };
-            int tempCode = 0;
-            char rList[10][3] = { "A", "X", "L", "B", "S", "T", "F", "", "PC", "SW" };
-            int addr1 = 0;
-
-            //byte format에 따라 계산 후 code_table에 정보 저장
-            switch (format) {
-                //2byte-format
-            case 2:
-                while (strlen(token_table[token_line]->operand[i]) != 0 && i < 2) {
-                    for (int j = 0; j < 10; j++)
-                        if (strcmp(token_table[token_line]->operand[i], rList[j]) == 0) {
-                            tempRegister[i] = j;
-                            break;
-                        }
-                    i++;
-                }
-                code_table[code_index].format = format;
-                code_table[code_index].addr = prevLoc;
-                code_table[code_index].code = (token_table[token_line]->nixbpe | (inst_table[opcode]->opcode << 4)) << 4;
-                code_table[code_index].code |= tempRegister[0] << 4;
-                code_table[code_index].code |= tempRegister[1];
-                code_table[code_index].line_index = token_line;
-                code_table[code_index].record = 'T';
-                code_index++;
-                break;
-                //3byte-format
-            case 3:
-                    //RSUB과 같이 피연산자 개수가 0인 경우
-                if (inst_table[opcode]->operandCnt == 0) {
-                    code_table[code_index].format = format;
-                    code_table[code_index].addr = prevLoc;
-                    code_table[code_index].code = ((token_table[token_line]->nixbpe >> 4) | inst_table[opcode]->opcode) << 16;
-                    code_table[code_index].line_index = token_line;
-                    code_table[code_index].record = 'T';
-                }
-                else {
-                    //immediate addressing이면
-                    if (token_table[token_line]->operand[0][0] == '#') {
-                        tempCode = atoi(token_table[token_line]->operand[0] + 1);
-                    }
-                    //일반적인 경우
-                    else {
-                        addr1 = search_symbol(token_table[token_line]->operand[0], subRoutine);
-                        if (addr1 != -1)
-                            tempCode = addr1 - locctr;
-                        else {
-                            i = 0;
-                            while (strlen(literal_table[i].literal) != 0) {
-                                if (strcmp(literal_table[i].literal, token_table[token_line]->operand[0]) == 0) {
-                                    addr1 = literal_table[i].addr;
-                                    tempCode = addr1 - locctr;
-                                    break;
-                                }
-                                i++;
-                            }
-                        }
-                    }
-                    tempCode &= 0xFFF;
-                    code_table[code_index].format = format;
-                    code_table[code_index].addr = prevLoc;
-                    code_table[code_index].code = (token_table[token_line]->nixbpe | (inst_table[opcode]->opcode << 4)) << 12;
-                    code_table[code_index].code |= tempCode;    //뒤 12bit만 갖고 오기
-                    code_table[code_index].line_index = token_line;
-                    code_table[code_index].record = 'T';
-                }
-                code_index++;
-                break;
-                //4byte-format
-            case 4:
-                    //immediate addressing이면
-                if (token_table[token_line]->operand[0][0] == '#') {
-                    tempCode = atoi(token_table[token_line]->operand[0]);
-                }
-                else {
-                    //외부 참조인 경우 M 레코드 저장
-                    while (strlen(extrefList[i]) != 0) {
-                        if (strcmp(extrefList[i], token_table[token_line]->operand[0]) == 0) {
-                            tempCode = 0;
-                            code_table[code_index].format = 5;
-                            code_table[code_index].addr = prevLoc + 1;
-                            code_table[code_index].line_index = token_line;
-                            code_table[code_index].record = 'M';
-                            code_table[code_index].modify = (char*)malloc(strlen(extrefList[i]) * sizeof(char) + 2);
-                            code_table[code_index].modify[0] = '+';
-                            strcpy(code_table[code_index].modify + 1, extrefList[i]);
-                            code_index++;
-                            break;
-                        }
-                        i++;
-                    }
-                }
-                code_table[code_index].format = format;
-                code_table[code_index].addr = prevLoc;
-                code_table[code_index].code = (token_table[token_line]->nixbpe | (inst_table[opcode]->opcode << 4)) << 20;
-                code_table[code_index].code |= tempCode;
-                code_table[code_index].line_index = token_line;
-                code_table[code_index].record = 'T';
-                code_index++;
-                break;
-            }
-        }
-        //기계 명령어가 아닌 경우
-        else {
-            //LOTRG 또는 END
-            int tempCode = 0;
-            if (strcmp(token_table[token_line]->operator, "LTORG") == 0 || strcmp(token_table[token_line]->operator, "END") == 0) {
-                while (locctr == literal_table[literal_index].addr) {
-                    memset(tempLiteral, 0, sizeof(tempLiteral));
-                    literalP = literal_table[literal_index].literal + 3;
-                    int i = 0;
-                    for (; i < strlen(literal_table[literal_index].literal) - 4; i++, literalP++)
-                        tempLiteral[i] = *literalP;
-                    tempLiteral[i] = '\0';
-
-                    //X인 경우
-                    if (literal_table[literal_index].literal[1] == 'X') {
-                        locctr += (strlen(literal_table[literal_index].literal) - 4) / 2;
-                        for (int i = 0; i < strlen(tempLiteral); i++) {
-                            if (tempLiteral[i] >= 'A' && tempLiteral[i] <= 'F')
-                                tempCode = (tempCode << 4) | (tempLiteral[i] - 'A' + 10);
-                            else
-                                tempCode = (tempCode << 4) | (tempLiteral[i] - '0');
-                        }
-
-                        code_table[code_index].format = (strlen(literal_table[literal_index].literal) - 4) / 2;
-                        code_table[code_index].addr = prevLoc;
-                        code_table[code_index].code = tempCode;
-                        code_table[code_index].line_index = token_line;
-                        code_table[code_index].record = 'T';
-                        code_index++;
-                    }
-                    //C인 경우
-                    else {
-                        locctr += (strlen(literal_table[literal_index].literal) - 4);
-                        for (int i = 0; i < strlen(tempLiteral); i++)
-                            tempCode = (tempCode << 8) | tempLiteral[i];
-
-                        code_table[code_index].format = (strlen(literal_table[literal_index].literal) - 4);
-                        code_table[code_index].addr = prevLoc;
-                        code_table[code_index].code = tempCode;
-                        code_table[code_index].line_index = token_line;
-                        code_table[code_index].record = 'T';
-                        code_index++;
-                    }
-                    literal_index++;
-                    prevLoc = locctr;
-                }
-            }
-            //RESW
-            else if (strcmp(token_table[token_line]->operator, "RESW") == 0)
-                locctr += 3 * atoi(token_table[token_line]->operand[0]);
-            //RESB
-            else if (strcmp(token_table[token_line]->operator, "RESB") == 0)
-                locctr += atoi(token_table[token_line]->operand[0]);
-            //BYTE
-            else if (strcmp(token_table[token_line]->operator, "BYTE") == 0) {
-                memset(tempSymbol, 0, sizeof(tempSymbol));
-                symbolP = token_table[token_line]->operand[0] + 2;
-                int i = 0;
-                for (; i < strlen(token_table[token_line]->operand[0]) - 3; i++, symbolP++)
-                    tempSymbol[i] = *symbolP;
-                tempSymbol[i] = '\0';
-                //X인 경우
-                if (token_table[token_line]->operand[0][0] == 'X') {
-                    locctr += (strlen(token_table[token_line]->operand[0]) - 3) / 2;
-                    for (int i = 0; i < strlen(tempSymbol); i++) {
-                        if (tempSymbol[i] >= 'A' && tempSymbol[i] <= 'F')
-                            tempCode = (tempCode << 4) | (tempSymbol[i] - 'A' + 10);
-                        else
-                            tempCode = (tempCode << 4) | (tempSymbol[i] - '0');
-                    }
+    for (int i = 0; i < unitCnt; i++)
+        init_pass2_unit(&units[i], i - prologue);
 
-                    code_table[code_index].format = strlen(tempSymbol) / 2;
-                    code_table[code_index].addr = prevLoc;
-                    code_table[code_index].code = tempCode;
-                    code_table[code_index].line_index = token_line;
-                    code_table[code_index].record = 'T';
-                    code_index++;
-                }
-                //C인 경우
-                else {
-                    locctr += strlen(token_table[token_line]->operand[0]) - 3;
-                    for (int i = 0; i < strlen(tempSymbol); i++)
-                        tempCode = (tempCode << 8) | tempSymbol[i];
-
-                    code_table[code_index].format = strlen(tempSymbol);
-                    code_table[code_index].addr = prevLoc;
-                    code_table[code_index].code = tempCode;
-                    code_table[code_index].line_index = token_line;
-                    code_table[code_index].record = 'T';
-                    code_index++;
-                }
-            }
-            //WORD
-            else if (strcmp(token_table[token_line]->operator, "WORD") == 0) {
-                locctr += 3;
-                //피연산자가 문자인 경우
-                if (atoi(token_table[token_line]->operand[0]) == 0 && strlen(token_table[token_line]->operand[0]) > 1) {
-                    //-가 들어간 수식이면
-                    char tempOperand[MAX_TOKEN_LENGTH] = { 0, };
-                    strcpy(tempOperand, token_table[token_line]->operand[0]);
-                    char* restString;
-                    char* token = strtok_s(tempOperand, "-", &restString);
-                    if (strlen(token) != strlen(token_table[token_line]->operand[0])) {
-                        int var1, var2;
-                        //각각의 주소값을 찾아서
-                        var1 = search_symbol(token, subRoutine);
-                        var2 = search_symbol(restString, subRoutine);
-                        //Absolute Expression 계산
-                        if(var1 != -1 && var2 != -1)
-                            tempCode = var1 - var2;
-                        //외부 참조인 경우 M 레코드 정보 저장
-                        else {
-                            tempCode = 0;
-                            code_table[code_index].format = 3 * 2;
-                            code_table[code_index].addr = prevLoc + 1;
-                            code_table[code_index].line_index = token_line;
-                            code_table[code_index].record = 'M';
-                            code_table[code_index].modify = (char*)malloc(strlen(token) * sizeof(char) + 2);
-                            code_table[code_index].modify[0] = '+';
-                            strcpy(code_table[code_index].modify + 1, token);
-                            code_index++;
-
-                            code_table[code_index].format = 3 * 2;
-                            code_table[code_index].addr = prevLoc + 1;
-                            code_table[code_index].line_index = token_line;
-                            code_table[code_index].record = 'M';
-                            code_table[code_index].modify = (char*)malloc(strlen(restString) * sizeof(char) + 2);
-                            code_table[code_index].modify[0] = '-';
-                            strcpy(code_table[code_index].modify + 1, restString);
-                            code_index++;
-                        }
-                    }
-                    //단항이면
-                    else {
-                        int var1 = search_symbol(token, subRoutine);
-                        if (var1 != -1)
-                            tempCode = var1;
-                        else
-                            tempCode = 0;
-                    }
-                    code_table[code_index].format = 3;
-                    code_table[code_index].addr = prevLoc;
-                    code_table[code_index].code = tempCode;
-                    code_table[code_index].line_index = token_line;
-                    code_table[code_index].record = 'T';
-                    code_index++;
-                }
-                //피연산자가 숫자인 경우
-                else {
-                    code_table[code_index].format = 3;
-                    code_table[code_index].addr = prevLoc;
-                    code_table[code_index].code = atoi(token_table[token_line]->operand[0]);
-                    code_table[code_index].line_index = token_line;
-                    code_table[code_index].record = 'T';
-                    code_index++;
-                }
+    ///////////////섹션별로 token_table을 하나씩 읽어나가며 각자의 코드 버퍼에 정보 저장///////////////
+    run_parallel(unitCnt, assem_section_job, units);
+    for (int i = 0; i < unitCnt; i++) {
+        if (units[i].error) {
+            for (int j = 0; j < unitCnt; j++) {
+                free(units[j].code_table);
+                free(units[j].modify_table);
+                arena_release(&units[j].pool);
             }
+            free(units);
+            return -1;
         }
-        token_line++;
     }
-    //마지막 루틴의 길이를 H 레코드에 저장
-    code_table[startIndex].addr = locctr;
-    
-    //E 레코드 추가
-    code_table[code_index].format = 0;
-    code_table[code_index].addr = locctr;
-    code_table[code_index].line_index = token_line;
-    code_table[code_index].record = 'E';
+
+    //섹션별 코드 버퍼를 소스 순서대로 code_table에 이어 붙이기
+    int total = 1;
+    for (int i = 0; i < unitCnt; i++)
+        total += units[i].code_index;
+    RESERVE_TABLE(ctx->code_table, ctx->code_capacity, total);
+    ctx->code_index = ctx->modify_index = 0;
+    ctx->locctr = 0;
+    for (int i = 0; i < unitCnt; i++)
+        merge_section_codes(&units[i]);
+    free(units);
+    end_code_table();
 
     return 0;
 }
 
 /* ----------------------------------------------------------------------------------
-* 설명 : 입력된 문자열의 이름을 가진 파일에 프로그램의 결과를 저장하는 함수이다.
-*        여기서 출력되는 내용은 object code (프로젝트 1번) 이다.
-* 매계 : 생성할 오브젝트 파일명
+* 설명 : 패스1이 끝난 섹션 테이블로 섹션 하나의 패스2 정보를 준비하는 함수이다.
+* 매계 : 준비할 섹션 정보, 섹션 번호(첫 섹션 이전 라인이면 -1)
 * 반환 : 없음
-* 주의 : 만약 인자로 NULL값이 들어온다면 프로그램의 결과를 표준출력으로 보내어
-*        화면에 출력해준다.
 * -----------------------------------------------------------------------------------
 */
-void make_objectcode_output(char *file_name)
+static void init_pass2_unit(pass2* unit, int sectionNum)
 {
-    FILE* file;
-    //출력 파일 열기
-    if (file_name != NULL) {
-        if ((file = fopen(file_name, "w")) == NULL)
-            exit(1);
-    }   //출력 파일 이름이 없는 경우(NULL)
-    else
-        file = stdout;  //표준출력으로 대체
+    memset(unit, 0, sizeof(pass2));
+    unit->section = sectionNum;
+    unit->line_start = (sectionNum < 0) ? 0 : ctx->section_table[sectionNum].line_start;
+    unit->line_end = (sectionNum + 1 < ctx->section_index) ? ctx->section_table[sectionNum + 1].line_start : ctx->line_num;
+    unit->literal_cursor = (sectionNum < 0) ? 0 : ctx->section_table[sectionNum].literal_begin;
+    unit->literal_end = (sectionNum + 1 < ctx->section_index) ? ctx->section_table[sectionNum + 1].literal_begin : ctx->literal_index;
+    unit->boundary_addr = -1;
+    unit->start_index = -1;
+}
 
-    code_index = 0;
-    int subRoutine = -1;
-    int start_index = 0;
-    ///////////////E 레코드가 나올때까지 Object Program 생성 및 출력///////////////
-    while (code_table[code_index].record != 'E') {
-        //루틴의 시작인 경우(H 레코드)
-        if (code_table[code_index].record == 'H') {
-            //이전 루틴의 M 레코드 출력
-            if (subRoutine >= 0) {
-                for (int i = start_index; i < code_index; i++) {
-                    if (code_table[i].record == 'M')
-                        fprintf(file, "M%06X%02X%s\n", code_table[i].addr, code_table[i].format, code_table[i].modify);
-                }
-            }
-            //E 레코드 출력
-            if (subRoutine == 0)
-                fprintf(file, "E%06X\n\n", 0x0);
-            else if (subRoutine > 0)
-                fprintf(file, "E\n\n");
-            fprintf(file, "H%-6s%06X%06X\n", token_table[code_table[code_index].line_index]->label, 0, code_table[code_index].addr);
-            
-            start_index = code_index;
-            subRoutine++;
+/* ----------------------------------------------------------------------------------
+* 설명 : 섹션의 코드 버퍼를 code_table 뒤에 이어 붙이고 섹션의 버퍼를 해제하는 함수이다.
+* 매계 : 패스2가 끝난 섹션
+* 반환 : 없음
+* 주의 : M 레코드 문자열은 출력할 때까지 필요하므로 섹션의 arena는 전체 arena로 옮긴다.
+*        M 레코드도 modify_table 뒤에 이어 붙이고, H 레코드가 가리키는 index를 옮긴 위치로 바꾼다.
+* -----------------------------------------------------------------------------------
+*/
+static void merge_section_codes(pass2* unit)
+{
+    RESERVE_TABLE(ctx->code_table, ctx->code_capacity, ctx->code_index + unit->code_index + 1);
+    if (unit->code_index > 0 && unit->code_table != NULL) {
+        code* merged = ctx->code_table + ctx->code_index;
+        memcpy(merged, unit->code_table, unit->code_index * sizeof(code));
+        for (int i = 0; i < unit->code_index; i++) {
+            if (merged[i].record == 'H')
+                merged[i].code += ctx->modify_index;
         }
-        //EXTDEF인 경우(D 레코드)
-        else if (code_table[code_index].record == 'D') {
-            fprintf(file, "D");
-            for (int i = 0; i < code_table[code_index].format; i++) {
-                int addr = search_symbol(token_table[code_table[code_index].line_index]->operand[i], subRoutine);
-                fprintf(file, "%-6s%06X", token_table[code_table[code_index].line_index]->operand[i], addr);
-            }
-            fprintf(file, "\n");
+        ctx->code_index += unit->code_index;
+
+        RESERVE_TABLE(ctx->modify_table, ctx->modify_capacity, ctx->modify_index + unit->modify_index + 1);
+        if (unit->modify_index > 0)
+            memcpy(ctx->modify_table + ctx->modify_index, unit->modify_table, unit->modify_index * sizeof(modify));
+        ctx->modify_index += unit->modify_index;
+    }
+    ctx->locctr = unit->locctr;
+    free(unit->code_table);
+    free(unit->modify_table);
+    unit->code_table = NULL;
+    unit->modify_table = NULL;
+    arena_merge(&ctx->asm_arena, &unit->pool);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : code_table의 마지막에 E 레코드를 추가하는 함수이다.
+* 매계 : 없음
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void end_code_table(void)
+{
+    RESERVE_TABLE(ctx->code_table, ctx->code_capacity, ctx->code_index + 1);
+    ctx->token_line = ctx->line_num;
+    ctx->prevLoc = ctx->locctr;
+
+    ctx->code_table[ctx->code_index].format = 0;
+    ctx->code_table[ctx->code_index].addr = ctx->locctr;
+    ctx->code_table[ctx->code_index].line_index = ctx->token_line;
+    ctx->code_table[ctx->code_index].record = 'E';
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : run_parallel()에서 호출되어 index번째 섹션의 패스2를 수행하는 함수이다.
+* 매계 : pass2 배열, 처리할 index
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void assem_section_job(void* arg, int index)
+{
+    pass2* unit = (pass2*)arg + index;
+    section_cache* cache = NULL;
+    if (unit->section >= 0 && unit->section < ctx->cache_count && ctx->cache_table[unit->section].line_start == unit->line_start)
+        cache = &ctx->cache_table[unit->section];
+
+    //캐시에서 가져온 섹션은 저장된 코드를 그대로 사용
+    if (cache != NULL && cache->data != NULL) {
+        if (cache_replay_codes(unit, cache))
+            return;
+        //다음 섹션의 리터럴 주소가 바뀌어 결과가 달라질 수 있으면 다시 계산
+        cache_tokenize(cache, &unit->pool, true, NULL);
+    }
+    assem_section(unit);
+    if (cache != NULL && cache->cacheable && !unit->error)
+        cache_store(unit, cache);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 섹션의 코드 버퍼에 오브젝트 코드 하나를 추가하는 함수이다.
+* 매계 : 섹션 정보, 레코드 종류, 포맷(길이), 주소, token_table에서의 index
+* 반환 : 추가된 코드(다음 emit_code() 호출 전까지만 유효)
+* -----------------------------------------------------------------------------------
+*/
+static code* emit_code(pass2* unit, char record, int format, int addr, int line)
+{
+    RESERVE_TABLE(unit->code_table, unit->code_capacity, unit->code_index + 1);
+    code* result = &unit->code_table[unit->code_index++];
+    result->format = (short)format;
+    result->addr = addr;
+    result->code = (record == 'H') ? unit->modify_index : 0;
+    result->line_index = line;
+    result->record = record;
+    return result;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 섹션의 M 레코드 버퍼에 M 레코드 하나를 추가하는 함수이다.
+* 매계 : 섹션 정보, 고칠 half-byte 개수, 주소, 부호('+', '-'), 외부 심볼 이름
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void emit_modify(pass2* unit, int format, int addr, char sign, const char* name)
+{
+    RESERVE_TABLE(unit->modify_table, unit->modify_capacity, unit->modify_index + 1);
+    modify* result = &unit->modify_table[unit->modify_index++];
+    result->addr = addr;
+    result->format = format;
+    result->name = (char*)arena_alloc(&unit->pool, strlen(name) * sizeof(char) + 2);
+    result->name[0] = sign;
+    strcpy(result->name + 1, name);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 섹션 하나의 라인들을 기계어 코드로 바꾸어 섹션의 코드 버퍼에 저장하는 함수이다.
+* 매계 : 처리할 섹션 정보
+* 반환 : 없음
+* 주의 : 여러 스레드에서 동시에 호출되므로 전역 테이블은 읽기만 하고(token의 nixbpe는
+*        라인별로 따로 쓰므로 예외), 주소 계산은 섹션 정보(unit)에 저장하며 수행한다.
+* -----------------------------------------------------------------------------------
+*/
+static void assem_section(pass2* unit)
+{
+    unit->locctr = 0;
+    unit->extref_count = 0;
+    unit->start_index = -1;
+    for (int token_line = unit->line_start; token_line < unit->line_end; token_line++)
+        encode_line(unit, token_line);
+    finish_section(unit);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 라인 하나를 기계어 코드로 바꾸어 섹션의 코드 버퍼에 저장하는 함수이다.
+* 매계 : 처리 중인 섹션 정보(주소, EXTREF 목록 등 라인 사이의 상태를 가진다), token_table에서의 index
+* 반환 : 없음
+* 주의 : 섹션의 라인 순서대로 호출해야 한다.
+* -----------------------------------------------------------------------------------
+*/
+static void encode_line(pass2* unit, int line)
+{
+    int subRoutine = unit->section;    //현재 루틴의 번호
+    int locctr = unit->locctr;         //섹션 안에서의 현재 주소(전역 locctr 대신 사용)
+    int prevLoc = locctr;              //섹션 안에서의 이전 주소(전역 prevLoc 대신 사용)
+    int literalCursor = unit->literal_cursor;
+    int* extrefList = unit->extref;    //EXTREF 변수의 이름 ID
+    int extrefCnt = unit->extref_count;
+    token* tok = ctx->token_table[line];
+
+    int opcode = tok->opcode;
+    switch (tok->kind) {
+    //루틴의 시작인 경우 H 레코드 정보 저장(길이는 섹션이 끝난 뒤 저장)
+    case OP_START:
+    case OP_CSECT:
+        unit->start_index = unit->code_index;
+        emit_code(unit, 'H', 0, 0, line);
+        locctr = 0;
+        break;
+    //EXTDEF인 경우
+    case OP_EXTDEF: {
+        int i = 0;
+        //개수 세기
+        while (i < MAX_OPERAND && strlen(tok->operand[i]) != 0)
+            i++;
+        //D 레코드 정보 저장
+        emit_code(unit, 'D', i, 0, line);
+        break;
+    }
+    //EXTREF인 경우 extrefList에 정보 저장
+    case OP_EXTREF: {
+        int i = 0;
+        //개수 세기
+        while (i < MAX_OPERAND && strlen(tok->operand[i]) != 0) {
+            extrefList[i] = tok->operand_id[i];
+            i++;
         }
-        //EXTREF인 경우(R 레코드)
-        else if (code_table[code_index].record == 'R') {
-            fprintf(file, "R");
-            for (int i = 0; i < code_table[code_index].format; i++)
-                fprintf(file, "%-6s", token_table[code_table[code_index].line_index]->operand[i]);
-            fprintf(file, "\n");
+        extrefCnt = unit->extref_count = i;
+
+        //R 레코드 정보 저장
+        emit_code(unit, 'R', i, 0, line);
+        break;
+    }
+    //소스코드가 기계 명령어인 경우
+        //nixbpe 파악하기
+    case OP_INSTRUCTION: {
+        //ni 비트 채우기
+            //2-byte format이면
+        if (inst_table[opcode]->format == 2) {
+            tok->nixbpe = 0x00; //00 XXXX
         }
-        //T 레코드인 경우
-        else if (code_table[code_index].record == 'T') {
-            fprintf(file, "T");
-            int maxLength = 0x1E;
-            int length = code_table[code_index].format;
-            int j = code_index+1;
-            int prevJ = j - 1;
-            //유효한 범위를 먼저 계산 후
-            while (1) {
-                //주소가 끊기거나 최대 길이(1E)를 넘어가면 중단
-                if (code_table[j].record == 'M') {
-                    j++;
-                    continue;
+            //immediate addressing이면
+        else if (tok->operand[0][0] == '#') {
+            tok->nixbpe = 0x10; //01 XXXX
+        }
+            //indirect addressing이면
+        else if (tok->operand[0][0] == '@') {
+            tok->nixbpe = 0x20; //10 XXXX
+        }
+            //위의 모든 조건이 아니면(direct addressing)
+        else {
+            tok->nixbpe = 0x30; //11 XXXX
+        }
+
+        //xbpe 비트 채우기
+            //2-byte format이면
+        if (tok->nixbpe == 0x00) {
+            tok->nixbpe |= 0x00;    //XX 0000
+        }
+        else {
+            //X 레지스터를 사용하면
+            if (strcmp(tok->operand[1], "X") == 0) {
+                tok->nixbpe |= 0x08;    //XX 1XXX
+            }
+            //4-byte format이면
+            if (tok->operator[0] == '+') {
+                tok->nixbpe |= 0x01;    //XX XXX1
+            }
+            bool isExtref = false;
+            //EXTREF를 통해 외부참조를 하는 경우
+            for (int i = 0; i < extrefCnt; i++) {
+                if (extrefList[i] == tok->operand_id[0] && extrefList[i] >= 0) {
+                    isExtref = true;
+                    tok->nixbpe |= 0x00;    //XX XX0X
                 }
-                if (code_table[j].record != 'T')
-                    break;
-                if (length + code_table[j].format > maxLength)
-                    break;
-                if (code_table[prevJ].addr + code_table[prevJ].format != code_table[j].addr)
-                    break;
-                length += code_table[j].format;
-                prevJ = j;
-                j++;
             }
-            //시작 주소와 범위를 출력하고
-            fprintf(file, "%06X%02X", code_table[code_index].addr, length);
-            //object code를 출력한다
-            for (; code_index < j; code_index++) {
-                switch (code_table[code_index].format) {
-                case 1:
-                    fprintf(file, "%02X", code_table[code_index].code);
-                    break;
-                case 2:
-                    fprintf(file, "%04X", code_table[code_index].code);
-                    break;
-                case 3:
-                    fprintf(file, "%06X", code_table[code_index].code);
-                    break;
-                case 4:
-                    fprintf(file, "%08X", code_table[code_index].code);
-                    break;
+            //immediate addressing
+            if ((tok->nixbpe & 0x30) == 0x10) {
+                tok->nixbpe |= 0x00;    //XX XX0X
+            }
+            //위의 두 경우가 아닌경우
+            else if (isExtref == false) {
+                tok->nixbpe |= 0x02;    //XX XX1X
+            }
+        }
+
+        //뒷자리(displacement) 계산
+        int format = tok->format;    //2,3,4
+        locctr += format;   //주소 계산
+        int i = 0;
+        char tempRegister[2] = { 0, };
+        int tempCode = 0;
+        char rList[10][3] = { "A", "X", "L", "B", "S", "T", "F", "", "PC", "SW" };
+        int addr1 = 0;
+        code* object;
+
+        //byte format에 따라 계산 후 코드 버퍼에 정보 저장
+        switch (format) {
+            //2byte-format
+        case 2:
+            while (i < 2 && strlen(tok->operand[i]) != 0) {
+                for (int j = 0; j < 10; j++)
+                    if (strcmp(tok->operand[i], rList[j]) == 0) {
+                        tempRegister[i] = j;
+                        break;
+                    }
+                i++;
+            }
+            object = emit_code(unit, 'T', format, prevLoc, line);
+            object->code = (tok->nixbpe | (inst_table[opcode]->opcode << 4)) << 4;
+            object->code |= tempRegister[0] << 4;
+            object->code |= tempRegister[1];
+            break;
+            //3byte-format
+        case 3:
+                //RSUB과 같이 피연산자 개수가 0인 경우
+            if (inst_table[opcode]->operandCnt == 0) {
+                object = emit_code(unit, 'T', format, prevLoc, line);
+                object->code = ((tok->nixbpe >> 4) | inst_table[opcode]->opcode) << 16;
+            }
+            else {
+                //immediate addressing이면
+                if (tok->operand[0][0] == '#') {
+                    tempCode = atoi(tok->operand[0] + 1);
+                }
+                //일반적인 경우
+                else {
+                    addr1 = search_name(tok->operand_id[0], subRoutine);
+                    if (addr1 != -1)
+                        tempCode = addr1 - locctr;
+                    else if (tok->operand[0][0] == '=' && (i = literal_find(tok->operand_id[0], literalCursor)) != -1) {
+                        addr1 = ctx->literal_table[i].addr;
+                        tempCode = addr1 - locctr;
+                    }
+                }
+                tempCode &= 0xFFF;
+                object = emit_code(unit, 'T', format, prevLoc, line);
+                object->code = (tok->nixbpe | (inst_table[opcode]->opcode << 4)) << 12;
+                object->code |= tempCode;    //뒤 12bit만 갖고 오기
+            }
+            break;
+            //4byte-format
+        case 4:
+                //immediate addressing이면
+            if (tok->operand[0][0] == '#') {
+                tempCode = atoi(tok->operand[0]);
+            }
+            else {
+                //외부 참조인 경우 M 레코드 저장
+                while (i < extrefCnt) {
+                    if (extrefList[i] == tok->operand_id[0] && extrefList[i] >= 0) {
+                        tempCode = 0;
+                        emit_modify(unit, 5, prevLoc + 1, '+', tok->operand[0]);
+                        break;
+                    }
+                    i++;
                 }
             }
-            fprintf(file, "\n");
-            code_index--;
+            object = emit_code(unit, 'T', format, prevLoc, line);
+            object->code = (tok->nixbpe | (inst_table[opcode]->opcode << 4)) << 20;
+            object->code |= tempCode;
+            break;
+        }
+        break;
+    }
+    //LTORG 또는 END
+    case OP_LTORG:
+    case OP_END: {
+        code* object;
+        while (literalCursor < ctx->literal_index && locctr == ctx->literal_table[literalCursor].addr) {
+            //byte 수와 값은 패스1에서 계산해 둔 것을 사용
+            literal* lit = &ctx->literal_table[literalCursor];
+            locctr += lit->length;
+            object = emit_code(unit, 'T', lit->length, prevLoc, line);
+            object->code = lit->value;
+            literalCursor++;
+            prevLoc = locctr;
+        }
+        //다음 섹션의 리터럴과 주소를 비교한 경우 섹션 캐시를 위해 기록
+        if (literalCursor == unit->literal_end) {
+            unit->boundary_check++;
+            unit->boundary_addr = locctr;
+        }
+        break;
+    }
+    //RESW
+    case OP_RESW:
+        locctr += 3 * atoi(tok->operand[0]);
+        break;
+    //RESB
+    case OP_RESB:
+        locctr += atoi(tok->operand[0]);
+        break;
+    //BYTE
+    case OP_BYTE: {
+        int tempCode = 0;
+        code* object;
+        //X'F1' 또는 C'EOF'의 형태이므로 따옴표 안의 값만 사용
+        char* symbolP = tok->operand[0] + 2;
+        int length = strlen(tok->operand[0]) - 3;
+        //X인 경우
+        if (tok->operand[0][0] == 'X') {
+            locctr += length / 2;
+            for (int i = 0; i < length; i++) {
+                if (symbolP[i] >= 'A' && symbolP[i] <= 'F')
+                    tempCode = (tempCode << 4) | (symbolP[i] - 'A' + 10);
+                else
+                    tempCode = (tempCode << 4) | (symbolP[i] - '0');
+            }
+
+            object = emit_code(unit, 'T', length / 2, prevLoc, line);
+            object->code = tempCode;
+        }
+        //C인 경우
+        else {
+            locctr += length;
+            for (int i = 0; i < length; i++)
+                tempCode = (tempCode << 8) | symbolP[i];
+
+            object = emit_code(unit, 'T', length, prevLoc, line);
+            object->code = tempCode;
+        }
+        break;
+    }
+    //WORD
+    case OP_WORD: {
+        locctr += 3;
+        code* object = emit_code(unit, 'T', 3, prevLoc, line);
+        object->code = encode_word(unit, token_expression(tok, &unit->pool, NULL), prevLoc, tok->operand[0]);
+        break;
+    }
+    default:
+        break;
+    }
+
+    unit->locctr = locctr;
+    unit->literal_cursor = literalCursor;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : WORD 수식의 값을 계산하고 필요한 M 레코드를 섹션의 M 레코드 버퍼에 저장하는 함수이다.
+* 매계 : 처리 중인 섹션 정보, WORD 수식, WORD의 주소, 에러 메시지에 쓸 피연산자 문자열
+* 반환 : WORD의 값(섹션에 없는 symbol은 0으로 계산)
+* 주의 : 나타낼 수 없는 수식이면 메시지를 출력하고 unit->error를 true로 바꾼다.
+* -----------------------------------------------------------------------------------
+*/
+static int encode_word(pass2* unit, expression* expr, int addr, const char* operand)
+{
+    int subRoutine = unit->section;
+    int value = 0;
+    //섹션에 없는 symbol은 0으로 계산하고 M 레코드 정보 저장('*'는 WORD의 주소)
+    //WORD 전체(6 half-byte)를 고치므로 M 레코드는 format 4와 달리 WORD의 주소에서 시작
+    int result = evaluate_expression(expr, subRoutine, addr, 0, &value);
+    if (result == EXPR_INVALID) {
+        printf("encode_line: WORD %s의 값을 나타낼 수 없습니다.\n", operand);
+        unit->error = true;
+    }
+    else if (result != EXPR_ABSOLUTE) {
+        int relative = 0;           //결과에 더해진 섹션 안 주소의 개수(뺀 주소는 -1)
+        for (int i = 0; i < expr->count; i++) {
+            expr_item* item = &expr->item[i];
+            int index = (item->kind == EXPR_SYMBOL) ? find_symbol(item->value, subRoutine) : -1;
+            if (item->kind == EXPR_LOCCTR || (index >= 0 && !ctx->sym_table[index].absolute))
+                relative += item->sign;
+            if (item->kind == EXPR_SYMBOL && index < 0)
+                emit_modify(unit, 3 * 2, addr, (item->sign > 0) ? '+' : '-', item->name);
+        }
+        //섹션 안 주소는 섹션의 시작 주소 기준이므로 섹션 이름으로 M 레코드 저장
+        if (unit->start_index >= 0) {
+            char* section = ctx->token_table[unit->code_table[unit->start_index].line_index]->label;
+            for (; relative != 0; relative += (relative > 0) ? -1 : 1)
+                emit_modify(unit, 3 * 2, addr, (relative > 0) ? '+' : '-', section);
+        }
+    }
+    return value;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 섹션의 마지막 라인까지 처리한 뒤 섹션의 길이를 H 레코드에 저장하는 함수이다.
+* 매계 : 처리한 섹션 정보
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void finish_section(pass2* unit)
+{
+    if (unit->start_index >= 0)
+        unit->code_table[unit->start_index].addr = unit->locctr;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 스레드 풀의 상태를 저장하는 변수들이다.
+*        run_parallel()이 작업을 올리면 작업 index를 참여하는 스레드 수만큼 연속된
+*        구간(pool_range)으로 나누어 주고, 대기하던 스레드들이 깨어나 자기 구간을
+*        앞에서부터 수행한다. 자기 구간을 다 쓴 스레드는 가장 많이 남은 구간의 뒤쪽
+*        절반을 가져온다(work stealing). 모두 끝나면 running이 0이 된다.
+* -----------------------------------------------------------------------------------
+*/
+struct pool_range
+{
+    pthread_mutex_t lock;
+    int next;                           //다음에 수행할 index(구간의 주인이 앞에서 가져감)
+    int end;                            //구간의 끝(다른 스레드가 뒤에서 가져감)
+};
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t pool_call_lock = PTHREAD_MUTEX_INITIALIZER;  //run_parallel() 호출을 한 번에 하나씩 처리
+static pthread_cond_t pool_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+static int pool_size;                   //풀에서 대기하는 스레드 개수(호출한 스레드 제외)
+static unsigned int pool_generation;    //작업이 올라올 때마다 증가
+static int pool_running;                //현재 작업을 끝내지 않은 풀 스레드 개수
+static void (*pool_job)(void*, int);
+static void* pool_arg;
+static assembly* pool_ctx;              //작업을 올린 스레드의 어셈블리(풀 스레드도 같은 ctx를 사용)
+static struct pool_range pool_ranges[MAX_THREADS];  //0번은 호출한 스레드, 1번부터 풀 스레드
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static _Thread_local bool in_pool_job;  //작업 안에서 다시 run_parallel()을 호출한 경우 확인
+
+/* ----------------------------------------------------------------------------------
+* 설명 : pool_ranges의 lock을 초기화하는 함수이다(pthread_once로 한 번만 호출).
+* 매계 : 없음
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void pool_init(void)
+{
+    for (int i = 0; i < MAX_THREADS; i++)
+        pthread_mutex_init(&pool_ranges[i].lock, NULL);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : self번 참여자가 수행할 작업 index를 하나 가져오는 함수이다.
+*        자기 구간이 비었으면 가장 많이 남은 구간의 뒤쪽 절반을 자기 구간으로 옮긴다.
+* 매계 : 참여자 번호
+* 반환 : 작업 index, 남은 작업이 없으면 -1
+* -----------------------------------------------------------------------------------
+*/
+static int pool_take(int self)
+{
+    struct pool_range* own = &pool_ranges[self];
+    int participants = pool_size + 1;
+
+    while (1) {
+        pthread_mutex_lock(&own->lock);
+        if (own->next < own->end) {
+            int index = own->next++;
+            pthread_mutex_unlock(&own->lock);
+            return index;
+        }
+        pthread_mutex_unlock(&own->lock);
+
+        //가장 많이 남은 구간 찾기
+        int victim = -1;
+        int most = 0;
+        for (int i = 0; i < participants; i++) {
+            if (i == self)
+                continue;
+            pthread_mutex_lock(&pool_ranges[i].lock);
+            int remain = pool_ranges[i].end - pool_ranges[i].next;
+            pthread_mutex_unlock(&pool_ranges[i].lock);
+            if (remain > most) {
+                most = remain;
+                victim = i;
+            }
+        }
+        if (victim < 0)
+            return -1;
+
+        //뒤쪽 절반(남은 것이 하나면 그 하나)을 가져와 첫 index는 바로 수행
+        struct pool_range* range = &pool_ranges[victim];
+        pthread_mutex_lock(&range->lock);
+        int remain = range->end - range->next;
+        if (remain <= 0) {
+            pthread_mutex_unlock(&range->lock);
+            continue;   //그 사이 다 수행된 경우 다시 찾음
+        }
+        int end = range->end;
+        int begin = end - (remain + 1) / 2;
+        range->end = begin;
+        pthread_mutex_unlock(&range->lock);
+
+        pthread_mutex_lock(&own->lock);
+        own->next = begin + 1;
+        own->end = end;
+        pthread_mutex_unlock(&own->lock);
+        return begin;
+    }
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 올라온 작업의 index를 하나씩 가져가며 수행하는 함수이다.
+* 매계 : 참여자 번호
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void pool_work(int self)
+{
+    int index;
+    ctx = pool_ctx;
+    in_pool_job = true;
+    while ((index = pool_take(self)) >= 0)
+        pool_job(pool_arg, index);
+    in_pool_job = false;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 스레드 풀의 스레드가 실행하는 함수로, 작업이 올라올 때까지 대기한다.
+* 매계 : 참여자 번호(1부터)
+* 반환 : 없음(종료하지 않음)
+* -----------------------------------------------------------------------------------
+*/
+static void* pool_thread(void* arg)
+{
+    unsigned int seen = 0;
+    int self = (int)(long)arg;
+    while (1) {
+        pthread_mutex_lock(&pool_lock);
+        while (pool_generation == seen)
+            pthread_cond_wait(&pool_wake, &pool_lock);
+        seen = pool_generation;
+        pthread_mutex_unlock(&pool_lock);
+
+        pool_work(self);
+
+        pthread_mutex_lock(&pool_lock);
+        if (--pool_running == 0)
+            pthread_cond_signal(&pool_done);
+        pthread_mutex_unlock(&pool_lock);
+    }
+    return NULL;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 작업에 사용할 스레드 개수를 알려주는 함수이다.
+*        thread_count가 정해지지 않았으면(0 이하) CPU 개수로 정한다.
+* 매계 : 없음
+* 반환 : 스레드 개수(1 이상)
+* -----------------------------------------------------------------------------------
+*/
+int get_thread_count(void)
+{
+    if (thread_count <= 0) {
+        long cpuCnt = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = (cpuCnt > 0) ? (int)cpuCnt : 1;
+    }
+    if (thread_count > MAX_THREADS)
+        thread_count = MAX_THREADS;
+    return thread_count;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : job(arg, 0) ~ job(arg, count - 1)을 스레드 풀에서 나누어 수행하는 함수이다.
+*        호출한 스레드도 작업에 참여하며, 모든 작업이 끝난 뒤 반환한다.
+* 매계 : 작업 개수, 작업 함수, 작업 함수에 넘길 인자
+* 반환 : 없음
+* 주의 : 작업이 하나뿐이거나 스레드가 하나이거나, 작업 안에서 다시 호출된 경우에는
+*        호출한 스레드에서 순서대로 수행한다.
+* -----------------------------------------------------------------------------------
+*/
+void run_parallel(int count, void (*job)(void*, int), void* arg)
+{
+    if (count <= 1 || get_thread_count() <= 1 || in_pool_job) {
+        for (int i = 0; i < count; i++)
+            job(arg, i);
+        return;
+    }
+
+    pthread_once(&pool_once, pool_init);
+    pthread_mutex_lock(&pool_call_lock);
+    //처음 사용할 때 스레드 생성
+    while (pool_size < thread_count - 1) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, pool_thread, (void*)(long)(pool_size + 1)) != 0)
+            break;
+        pthread_detach(thread);
+        pool_size++;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    pool_job = job;
+    pool_arg = arg;
+    pool_ctx = ctx;
+    //작업 index를 참여하는 스레드 수만큼 연속된 구간으로 나눔
+    int participants = pool_size + 1;
+    for (int i = 0; i < participants; i++) {
+        pthread_mutex_lock(&pool_ranges[i].lock);
+        pool_ranges[i].next = (int)((long)count * i / participants);
+        pool_ranges[i].end = (int)((long)count * (i + 1) / participants);
+        pthread_mutex_unlock(&pool_ranges[i].lock);
+    }
+    pool_running = pool_size;
+    pool_generation++;
+    pthread_cond_broadcast(&pool_wake);
+    pthread_mutex_unlock(&pool_lock);
+
+    pool_work(0);
+
+    pthread_mutex_lock(&pool_lock);
+    while (pool_running > 0)
+        pthread_cond_wait(&pool_done, &pool_lock);
+    pthread_mutex_unlock(&pool_lock);
+    pthread_mutex_unlock(&pool_call_lock);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 입력된 문자열의 이름을 가진 파일에 프로그램의 결과를 저장하는 함수이다.
+*        여기서 출력되는 내용은 object code (프로젝트 1번) 이다.
+* 매계 : 생성할 오브젝트 파일명
+* 반환 : 없음
+* 주의 : 만약 인자로 NULL값이 들어온다면 프로그램의 결과를 표준출력으로 보내어
+*        화면에 출력해준다.
+* -----------------------------------------------------------------------------------
+*/
+void make_objectcode_output(char *file_name)
+{
+    writer out;
+    STAT_PHASE(PHASE_OBJECT);
+    //출력 파일 열기(파일 이름이 없는 경우(NULL) 표준출력으로 대체)
+    if (output_open(&out, file_name) < 0)
+        exit(1);
+
+    int subRoutine = -1;
+    int start_index = 0;
+    ///////////////E 레코드가 나올때까지 H 레코드 단위로 Object Program 생성 및 출력///////////////
+    while (ctx->code_table[start_index].record != 'E') {
+        ctx->code_index = start_index + 1;
+        while (ctx->code_table[ctx->code_index].record != 'E' && ctx->code_table[ctx->code_index].record != 'H')
+            ctx->code_index++;
+        //루틴의 M 레코드 범위(첫 H 레코드 이전의 코드이면 출력하지 않으므로 없음)
+        int modifyStart = 0;
+        int modifyEnd = 0;
+        if (ctx->code_table[start_index].record == 'H') {
+            modifyStart = ctx->code_table[start_index].code;
+            modifyEnd = (ctx->code_table[ctx->code_index].record == 'H') ? ctx->code_table[ctx->code_index].code : ctx->modify_index;
+        }
+        write_section_records(&out, ctx->code_table + start_index, ctx->code_index - start_index,
+            ctx->modify_table + modifyStart, modifyEnd - modifyStart, &subRoutine, NULL);
+        start_index = ctx->code_index;
+    }
+    ctx->code_index = start_index;
+
+    //마지막 루틴의 E 레코드 출력
+    if (subRoutine >= 0)
+        writer_string(&out, "E\n", 0);
+    output_close(&out, OUTPUT_OBJECT);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : H 레코드로 시작하는 코드들(루틴 하나)의 H, D, R, T, M 레코드를 출력하는 함수이다.
+*        앞 루틴이 있으면 그 루틴의 E 레코드를 먼저 출력한다.
+* 매계 : writer, 코드 배열, 코드 개수, 루틴의 M 레코드 배열, M 레코드 개수,
+*        지금까지 출력한 루틴의 번호(H 레코드를 만나면 증가),
+*        D 레코드 심볼들의 주소(NULL이면 search_name()로 찾는다)
+* 반환 : 없음
+* 주의 : 첫 H 레코드 이전의 코드이면 M 레코드는 출력하지 않는다.
+*        마지막 루틴의 E 레코드는 호출한 쪽에서 출력한다.
+* -----------------------------------------------------------------------------------
+*/
+static void write_section_records(writer* out, code* table, int count, modify* modify_table, int modify_count, int* subRoutine, const int* define_addr)
+{
+    //루틴의 시작인 경우(H 레코드) 이전 루틴의 E 레코드 출력
+    if (count > 0 && table[0].record == 'H') {
+        if (*subRoutine == 0)
+        {
+            writer_char(out, 'E');
+            writer_hex(out, 0x0, 6);
+            writer_string(out, "\n\n", 0);
         }
-        code_index++;
+        else if (*subRoutine > 0)
+            writer_string(out, "E\n\n", 0);
+        (*subRoutine)++;
     }
 
-    //마지막 루틴의 M과 E 레코드 출력
-    if (subRoutine >= 0) {
-        for (int i = start_index; i < code_index; i++) {
-            if (code_table[i].record == 'M') {
-                fprintf(file, "M%06X%02X%s\n", code_table[i].addr, code_table[i].format, code_table[i].modify);
+    for (int index = 0; index < count; index++) {
+        token* tok = ctx->token_table[table[index].line_index];
+        //H 레코드
+        if (table[index].record == 'H') {
+            writer_char(out, 'H');
+            writer_string(out, tok->label, OBJECT_NAME_LENGTH);
+            writer_hex(out, 0, 6);
+            writer_hex(out, table[index].addr, 6);
+            writer_char(out, '\n');
+        }
+        //EXTDEF인 경우(D 레코드)
+        else if (table[index].record == 'D') {
+            writer_char(out, 'D');
+            for (int i = 0; i < table[index].format; i++) {
+                int addr = (define_addr != NULL) ? *define_addr++ : search_name(tok->operand_id[i], *subRoutine);
+                writer_string(out, tok->operand[i], OBJECT_NAME_LENGTH);
+                writer_hex(out, addr, 6);
+            }
+            writer_char(out, '\n');
+        }
+        //EXTREF인 경우(R 레코드)
+        else if (table[index].record == 'R') {
+            writer_char(out, 'R');
+            for (int i = 0; i < table[index].format; i++)
+                writer_string(out, tok->operand[i], OBJECT_NAME_LENGTH);
+            writer_char(out, '\n');
+        }
+        //T 레코드인 경우
+        else if (table[index].record == 'T') {
+            STAT_ADD(STAT_T_RECORDS, 1);
+            writer_char(out, 'T');
+            //유효한 범위를 먼저 계산 후
+            int length;
+            int j = text_record_end(table, index, count, &length);
+            //시작 주소와 범위를 출력하고
+            writer_hex(out, table[index].addr, 6);
+            writer_hex(out, length, 2);
+            //object code를 출력한다
+            for (; index < j; index++) {
+                //포맷(1~4 byte)만큼의 16진수 출력
+                int format = table[index].format;
+                if (format >= 1 && format <= 4)
+                    writer_hex(out, table[index].code, format * 2);
             }
+            writer_char(out, '\n');
+            index--;
         }
-        fprintf(file, "E\n");
     }
+
+    //루틴의 M 레코드 출력
+    if (*subRoutine >= 0) {
+        for (int i = 0; i < modify_count; i++)
+            write_modify_record(out, &modify_table[i]);
+    }
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : index번째 코드부터 T 레코드 하나에 들어갈 코드들의 범위를 계산하는 함수이다.
+* 매계 : 코드 배열, T 레코드의 첫 코드 index, 코드 개수, 레코드 길이를 저장할 변수
+* 반환 : T 레코드에 들어가지 않는 첫 코드의 index
+* 주의 : M 레코드는 따로 있으므로 연속된 T 코드만 보며, 주소가 끊기거나
+*        최대 길이(1E)를 넘어가면 중단한다.
+* -----------------------------------------------------------------------------------
+*/
+static int text_record_end(code* table, int index, int count, int* length)
+{
+    int maxLength = 0x1E;
+    int j = index + 1;
+    *length = table[index].format;
+    while (j < count) {
+        if (table[j].record != 'T')
+            break;
+        if (*length + table[j].format > maxLength)
+            break;
+        if (table[j - 1].addr + table[j - 1].format != table[j].addr)
+            break;
+        *length += table[j].format;
+        j++;
+    }
+    return j;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 소스 파일 하나를 처음부터 끝까지 어셈블하고 결과 파일들을 만드는 함수이다.
+*        현재 ctx가 가리키는 assembly를 사용하며, 끝나면 release_my_assembler()로 비운다.
+* 매계 : 소스 파일, 오브젝트 프로그램 파일, 심볼 테이블 파일, 리터럴 테이블 파일,
+*        메모리 이미지 파일(NULL이 아니면 load_address에 로드한 이미지를 저장)
+* 반환 : 정상종료 = 0, 에러발생 = < 0
+* 주의 : inst_table은 미리 init_inst_file()로 읽어두어야 한다.
+* -----------------------------------------------------------------------------------
+*/
+int assemble_file(char *source, char *object_file, char *symtab_file, char *literal_file, char *image_file)
+{
+    //one-pass 모드는 소스를 읽으면서 바로 코드를 만듦(같은 결과를 만들 수 없는 소스는 기존 방식)
+    if (onepass_mode && image_file == NULL) {
+        int result = assemble_onepass(source, object_file, symtab_file, literal_file);
+        if (result <= 0)
+            return result;
+    }
+    //out-of-core 모드는 소스를 읽으면서 처리(매크로가 있으면 기존 방식, 이미지는 code_table이 필요하므로 기존 방식)
+    else if (stream_mode && image_file == NULL) {
+        int result = assemble_streamed(source, object_file, symtab_file, literal_file);
+        if (result <= 0)
+            return result;
+    }
+    if (init_input_file(source) < 0) {
+        release_my_assembler();
+        return -1;
+    }
+    return assemble_input(object_file, symtab_file, literal_file, image_file);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 읽어들인 소스(input_data)를 현재 모드로 어셈블하고 결과 파일을 만드는 함수이다.
+* 매계 : 오브젝트, 심볼 테이블, 리터럴 테이블, 메모리 이미지(NULL이면 만들지 않음) 파일 경로
+* 반환 : 정상종료 = 0, 에러 < 0
+* 주의 : 끝나면 release_my_assembler()로 어셈블리의 상태를 해제한다.
+* -----------------------------------------------------------------------------------
+*/
+static int assemble_input(char *object_file, char *symtab_file, char *literal_file, char *image_file)
+{
+    int result = 0;
+
+    //파이프라인 모드(섹션 캐시를 사용하면 기존 방식)
+    if (pipeline_mode && cache_dir == NULL) {
+        if (assemble_pipelined(object_file, symtab_file, literal_file, image_file != NULL) < 0)
+            result = -1;
+    }
+    else if (assem_pass1() < 0)
+        result = -1;
+    else {
+        make_symtab_output(symtab_file);
+        make_literaltab_output(literal_file);
+        if (assem_pass2() < 0)
+            result = -1;
+        else
+            make_objectcode_output(object_file);
+    }
+    //오브젝트 프로그램을 다시 읽지 않고 code_table을 바로 로드
+    if (result == 0 && image_file != NULL) {
+        image img;
+        if (load_program(&img, load_address) < 0 || write_image(&img, image_file) < 0)
+            result = -1;
+        release_image(&img);
+    }
+
+    release_my_assembler();
+    return result;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 경로 문자열을 정렬하기 위한 qsort() 비교 함수이다.
+* -----------------------------------------------------------------------------------
+*/
+static int compare_path(const void* a, const void* b)
+{
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : batch_table에 소스 파일을 추가하는 함수이다.
+*        디렉터리인 경우 안의 *.asm, *.txt 파일을 이름 순서대로 추가한다.
+* 매계 : 소스 파일 또는 디렉터리 경로
+* 반환 : 정상종료 = 0, 에러발생 = < 0
+* -----------------------------------------------------------------------------------
+*/
+static int add_batch_source(char *path)
+{
+    struct stat info;
+    if (stat(path, &info) < 0) {
+        printf("add_batch_source: %s 파일을 찾을 수 없습니다.\n", path);
+        return -1;
+    }
+
+    if (!S_ISDIR(info.st_mode)) {
+        RESERVE_TABLE(batch_table, batch_capacity, batch_index + 1);
+        batch_table[batch_index++].source = path;
+        return 0;
+    }
+
+    DIR* dir = opendir(path);
+    if (dir == NULL) {
+        printf("add_batch_source: %s 디렉터리를 열 수 없습니다.\n", path);
+        return -1;
+    }
+    char** names = NULL;
+    int nameCnt = 0;
+    int nameCapacity = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        char* ext = strrchr(entry->d_name, '.');
+        if (ext == NULL || ext == entry->d_name || (strcmp(ext, ".asm") != 0 && strcmp(ext, ".txt") != 0))
+            continue;
+        char* full = (char*)arena_alloc(&batch_arena, strlen(path) + strlen(entry->d_name) + 2);
+        sprintf(full, "%s/%s", path, entry->d_name);
+        if (stat(full, &info) < 0 || S_ISDIR(info.st_mode))
+            continue;
+        RESERVE_TABLE(names, nameCapacity, nameCnt + 1);
+        names[nameCnt++] = full;
+    }
+    closedir(dir);
+
+    //실행할 때마다 같은 순서가 되도록 이름 순서로 정렬
+    qsort(names, nameCnt, sizeof(char*), compare_path);
+    RESERVE_TABLE(batch_table, batch_capacity, batch_index + nameCnt);
+    for (int i = 0; i < nameCnt; i++)
+        batch_table[batch_index++].source = names[i];
+    free(names);
+    return 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : batch 모드에서 소스 파일 하나를 어셈블하는 작업 함수이다.
+*        작업마다 assembly를 새로 만들어 ctx로 사용하므로 다른 파일과 섞이지 않는다.
+* 매계 : batch_table, 처리할 index
+* 반환 : 없음(결과는 batch_unit의 result에 저장)
+* -----------------------------------------------------------------------------------
+*/
+static void batch_job(void* arg, int index)
+{
+    batch* unit = &((batch*)arg)[index];
+    assembly context;
+    assembly* saved = ctx;
+
+    memset(&context, 0, sizeof(context));
+    ctx = &context;
+    unit->result = assemble_file(unit->source, unit->object_file, unit->symtab_file, unit->literal_file, unit->image_file);
+    //binary 오브젝트 파일은 출력한 텍스트를 변환하여 만든다(두 형식이 항상 같은 내용)
+    if (unit->result == 0 && object_binary)
+        unit->result = convert_object(unit->object_file, NULL);
+    ctx = saved;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 여러 소스 파일을 한 프로세스에서 동시에 어셈블하는 batch 모드의 메인루틴이다.
+*        사용법 : my_assembler [-i inst.data] [-j 스레드] [-o 출력디렉터리] [-c 캐시디렉터리]
+*                 [-l 목록파일] 소스...
+*        소스는 파일이나 디렉터리(*.asm, *.txt)이고, 목록파일에는 한 줄에 하나씩 적는다.
+*        소스마다 <이름>.obj, <이름>.sym, <이름>.lit 파일을 출력디렉터리(없으면 소스와
+*        같은 디렉터리)에 만든다. -L을 주면 링킹 로더로 그 주소(16진수)에 로드한
+*        메모리 이미지 <이름>.img도 만든다. -B를 주면 binary 오브젝트 파일 <이름>.sxo도
+*        만들고, -x는 텍스트와 binary 오브젝트 파일을 서로 변환한다. -c를 주면 섹션 캐시를 사용하여 바뀌지 않은 섹션은
+*        다시 어셈블하지 않는다.
+*        -b를 주면 단계별 처리 속도를 출력하고(bench_file()), -r을 함께 주면 결과를
+*        기준 디렉터리의 같은 이름 파일과 비교한다. -g는 소스를 만들어 표준출력으로 보낸다.
+*        -DSICXE_STATS로 빌드한 경우 -s로 단계별 통계(JSON)를, -t로 Chrome trace 파일을
+*        만든다. -S를 주면 소스 대신 그 경로의 Unix 도메인 소켓으로 요청을 받는 서버로 실행하고,
+*        SIGINT, SIGTERM이나 SHUTDOWN 요청을 받으면 종료한다.
+*        -O를 주면 소스를 메모리에 올리지 않는 out-of-core 모드(assemble_streamed())로
+*        어셈블하며 -p, -c보다 우선한다.(-L을 주거나 MACRO가 있는 소스는 기존 방식)
+*        -1을 주면 소스를 한 번만 읽으면서 코드를 만드는 one-pass 모드(assemble_onepass())로
+*        어셈블하며 -O, -p, -c보다 우선한다.(-L을 주거나 같은 결과를 만들 수 없는 소스는 기존 방식)
+* 매계 : main()의 인자
+* 반환 : 모두 성공 = 0, 하나라도 실패 = -1
+* 주의 : inst_table은 한 번만 읽어 모든 파일이 함께 사용하고, 파일 하나가 스레드 풀의
+*        작업 하나가 된다. 이때 파일 안의 패스1/패스2는 각 스레드에서 순서대로 수행된다.
+* -----------------------------------------------------------------------------------
+*/
+static int batch_main(int args, char *arg[])
+{
+    char* instFile = "inst.data";
+    char* outDir = NULL;
+    char* refDir = NULL;
+    char* statsFile = NULL;
+    char* traceFile = NULL;
+    char* serverPath = NULL;
+    bool isBench = false;
+
+    for (int i = 1; i < args; i++) {
+        if (strcmp(arg[i], "-b") == 0)
+            isBench = true;
+        else if (strcmp(arg[i], "-B") == 0)
+            object_binary = true;
+        else if (strcmp(arg[i], "-p") == 0)
+            pipeline_mode = true;
+        else if (strcmp(arg[i], "-O") == 0)
+            stream_mode = true;
+        else if (strcmp(arg[i], "-1") == 0)
+            onepass_mode = true;
+        else if (arg[i][0] == '-' && arg[i][1] != '\0' && arg[i][2] == '\0' && i + 1 < args) {
+            char option = arg[i][1];
+            char* value = arg[++i];
+            if (option == 'i')
+                instFile = value;
+            else if (option == 'o')
+                outDir = value;
+            else if (option == 'j')
+                thread_count = atoi(value);
+            else if (option == 'c')
+                cache_dir = value;
+            else if (option == 'r')
+                refDir = value;
+            else if (option == 'S')
+                serverPath = value;
+            else if (option == 'L') {
+                char* end;
+                load_address = (int)strtol(value, &end, 16);
+                if (*end != '\0' || load_address < 0 || load_address >= LOADER_MEMORY_SIZE) {
+                    printf("batch_main: 로드 주소 %s가 잘못되었습니다.\n", value);
+                    return -1;
+                }
+            }
+            else if (option == 's' || option == 't') {
+#ifdef SICXE_STATS
+                if (option == 's')
+                    statsFile = value;
+                else
+                    traceFile = value;
+#else
+                printf("batch_main: %s 옵션은 -DSICXE_STATS로 빌드해야 사용할 수 있습니다.\n", arg[i - 1]);
+                return -1;
+#endif
+            }
+            else if (option == 'g')
+                return generate_source(value);
+            else if (option == 'x') {
+                if (outDir != NULL)
+                    mkdir(outDir, 0777);
+                return convert_object(value, outDir);
+            }
+            else if (option == 'l') {
+                FILE* list = fopen(value, "r");
+                if (list == NULL) {
+                    printf("batch_main: %s 목록 파일을 열 수 없습니다.\n", value);
+                    return -1;
+                }
+                char line[MAX_LINE_LENGTH];
+                while (fgets(line, sizeof(line), list) != NULL) {
+                    line[strcspn(line, "\r\n")] = '\0';
+                    if (line[0] != '\0' && add_batch_source(arena_strdup(&batch_arena, line)) < 0) {
+                        fclose(list);
+                        return -1;
+                    }
+                }
+                fclose(list);
+            }
+            else {
+                printf("batch_main: 알 수 없는 옵션 %s\n", arg[i - 1]);
+                return -1;
+            }
+        }
+        else if (add_batch_source(arg[i]) < 0)
+            return -1;
+    }
+    //서버 모드는 소스 대신 소켓으로 요청을 받음
+    if (serverPath != NULL) {
+        if (cache_dir != NULL)
+            mkdir(cache_dir, 0777);
+        if (init_inst_file(instFile) < 0) {
+            printf("init_inst_file: 프로그램 초기화에 실패 했습니다.\n");
+            return -1;
+        }
+        return server_main(serverPath);
+    }
+    if (batch_index == 0) {
+        printf("사용법 : %s [-i inst.data] [-j 스레드] [-o 출력디렉터리] [-c 캐시디렉터리] [-B] [-p | -O | -1] [-L 로드주소] [-b [-r 기준디렉터리]] [-s 통계.json] [-t trace.json] [-l 목록파일] 소스...\n", arg[0]);
+        printf("         %s [-o 출력디렉터리] -x 오브젝트파일(.obj <-> .sxo 변환)\n", arg[0]);
+        printf("         %s [-i inst.data] [-j 스레드] [-c 캐시디렉터리] [-p] -S 소켓경로(서버 모드)\n", arg[0]);
+        printf("         %s -g csects=N,lines=N,ext=N,literals=N,equ=N,f2=%%,f4=%%,seed=N > 소스\n", arg[0]);
+        return -1;
+    }
+    if (outDir != NULL)
+        mkdir(outDir, 0777);
+    if (cache_dir != NULL)
+        mkdir(cache_dir, 0777);
+
+    //소스마다 출력 파일 경로 정하기(확장자를 뗀 이름 + .obj/.sym/.lit)
+    for (int i = 0; i < batch_index; i++) {
+        char* source = batch_table[i].source;
+        char* base = strrchr(source, '/');
+        base = (base == NULL) ? source : base + 1;
+        char* ext = strrchr(base, '.');
+        int stemLen = (ext == NULL || ext == base) ? (int)strlen(base) : (int)(ext - base);
+        char* dir = (outDir != NULL) ? outDir : source;
+        int dirLen = (outDir != NULL) ? (int)strlen(outDir) : (int)(base - source);
+        char* sep = (outDir != NULL) ? "/" : "";
+        size_t size = dirLen + stemLen + 6;
+
+        batch_table[i].object_file = (char*)arena_alloc(&batch_arena, size);
+        batch_table[i].symtab_file = (char*)arena_alloc(&batch_arena, size);
+        batch_table[i].literal_file = (char*)arena_alloc(&batch_arena, size);
+        batch_table[i].image_file = NULL;
+        if (load_address >= 0) {
+            batch_table[i].image_file = (char*)arena_alloc(&batch_arena, size);
+            sprintf(batch_table[i].image_file, "%.*s%s%.*s.img", dirLen, dir, sep, stemLen, base);
+        }
+        sprintf(batch_table[i].object_file, "%.*s%s%.*s.obj", dirLen, dir, sep, stemLen, base);
+        sprintf(batch_table[i].symtab_file, "%.*s%s%.*s.sym", dirLen, dir, sep, stemLen, base);
+        sprintf(batch_table[i].literal_file, "%.*s%s%.*s.lit", dirLen, dir, sep, stemLen, base);
+    }
+
+    double start = now_seconds();
+    if (init_inst_file(instFile) < 0) {
+        printf("init_inst_file: 프로그램 초기화에 실패 했습니다.\n");
+        return -1;
+    }
+
+    int failed = 0;
+    //벤치마크는 단계별 시간을 재기 위해 파일을 하나씩 처리
+    if (isBench) {
+        struct stat info;
+        printf("%-24s %10s %14s %14s\n", "stage", "seconds", "lines/s", "bytes/s");
+        bench_report("init_inst_file", now_seconds() - start, inst_index, (stat(instFile, &info) == 0) ? (long long)info.st_size : 0);
+        for (int i = 0; i < batch_index; i++)
+            failed += (bench_file(&batch_table[i], refDir) < 0) ? 1 : 0;
+    }
+    else
+        run_parallel(batch_index, batch_job, batch_table);
+
+    for (int i = 0; i < batch_index; i++) {
+        if (batch_table[i].result < 0) {
+            printf("%s: 어셈블에 실패하였습니다.\n", batch_table[i].source);
+            failed++;
+        }
+    }
+#ifdef SICXE_STATS
+    if (statsFile != NULL && stats_write_json(statsFile) < 0)
+        failed++;
+    if (traceFile != NULL && stats_write_trace(traceFile) < 0)
+        failed++;
+    free(stat_events);
+    stat_events = NULL;
+    stat_event_index = stat_event_capacity = 0;
+#else
+    (void)statsFile;
+    (void)traceFile;
+#endif
+    free(batch_table);
+    batch_table = NULL;
+    batch_index = batch_capacity = 0;
+    arena_release(&batch_arena);
+    return (failed > 0) ? -1 : 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : FNV-1a 방식으로 data의 64bit 해시 값을 이어서 계산하는 함수이다.
+*        섹션 캐시의 key(섹션 라인과 inst_table의 내용)를 만드는 데 사용한다.
+* 매계 : 이전까지의 해시 값(처음이면 FNV offset basis), 데이터, 데이터의 크기
+* 반환 : 해시 값
+* -----------------------------------------------------------------------------------
+*/
+static unsigned long long hash_bytes(unsigned long long hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 토큰으로 분리하기 전의 소스 라인이 섹션을 시작하는지 확인하는 함수이다.
+*        line_operator()로 label을 건너뛰고 operator를 비교한다.
+* 매계 : 소스 라인
+* 반환 : START = 1, CSECT = 2, 그 외 = 0
+* -----------------------------------------------------------------------------------
+*/
+static int section_line_kind(char* line)
+{
+    size_t length;
+    line = line_operator(line, &length);
+    if (length == 5 && strncmp(line, "START", 5) == 0)
+        return 1;
+    if (length == 5 && strncmp(line, "CSECT", 5) == 0)
+        return 2;
+    return 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 소스를 START/CSECT 라인 기준으로 나누어 cache_table을 만드는 함수이다.
+* 매계 : 없음
+* 반환 : 없음
+* 주의 : 섹션의 주소가 0에서 시작하고 다음 섹션으로 주소가 이어지지 않아야 섹션의
+*        결과가 섹션의 라인만으로 정해지므로, 파일의 첫 라인이 아닌 START와 다음 섹션이
+*        START인 섹션은 캐시에 저장하지 않는다.
+* -----------------------------------------------------------------------------------
+*/
+static void cache_split(void)
+{
+    ctx->cache_count = 0;
+    for (int i = 0; i < ctx->line_num; i++) {
+        int kind = section_line_kind(ctx->input_data[i]);
+        if (kind == 0)
+            continue;
+        RESERVE_TABLE(ctx->cache_table, ctx->cache_capacity, ctx->cache_count + 1);
+        section_cache* cache = &ctx->cache_table[ctx->cache_count];
+        memset(cache, 0, sizeof(section_cache));
+        cache->line_start = i;
+        cache->cacheable = (kind == 2 || i == 0);
+        if (ctx->cache_count > 0) {
+            ctx->cache_table[ctx->cache_count - 1].line_end = i;
+            if (kind == 1)
+                ctx->cache_table[ctx->cache_count - 1].cacheable = false;
+        }
+        ctx->cache_count++;
+    }
+    if (ctx->cache_count > 0)
+        ctx->cache_table[ctx->cache_count - 1].line_end = ctx->line_num;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : index번째 섹션의 key를 계산하고, 같은 key의 캐시 파일이 있으면 읽는 함수이다.
+* 매계 : 사용하지 않음, cache_table의 index
+* 반환 : 없음(읽은 경우 섹션의 data와 각 영역의 포인터를 채운다)
+* 주의 : 라인을 토큰으로 분리하기 전에(라인이 바뀌기 전에) 호출해야 한다.
+*        형식이 맞지 않거나 손상된 파일은 없는 것으로 취급한다.
+* -----------------------------------------------------------------------------------
+*/
+static void cache_load_job(void* arg, int index)
+{
+    section_cache* cache = &ctx->cache_table[index];
+    (void)arg;
+
+    unsigned long long key = hash_bytes(14695981039346656037ull, &inst_digest, sizeof(inst_digest));
+    for (int i = cache->line_start; i < cache->line_end; i++)
+        key = hash_bytes(key, ctx->input_data[i], strlen(ctx->input_data[i]) + 1);
+    cache->key = key;
+    if (!cache->cacheable)
+        return;
+
+    char* path = (char*)malloc(strlen(cache_dir) + 32);
+    sprintf(path, "%s/%016llx.sec", cache_dir, key);
+    FILE* file = fopen(path, "rb");
+    free(path);
+    if (file == NULL)
+        return;
+
+    char* data = NULL;
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0)
+        size = ftell(file);
+    if (size >= (long)sizeof(cache_header) && fseek(file, 0, SEEK_SET) == 0) {
+        data = (char*)malloc((size_t)size);
+        if (data != NULL && fread(data, 1, (size_t)size, file) != (size_t)size) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(file);
+    if (data == NULL)
+        return;
+
+    //머리부와 각 영역의 크기 확인
+    cache_header* header = (cache_header*)data;
+    bool valid = memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) == 0 && header->key == key
+        && header->line_count == cache->line_end - cache->line_start
+        && header->symbol_count >= 0 && header->literal_count >= 0 && header->name_count >= 0
+        && header->code_count >= 0 && header->string_size > 0;
+    if (valid) {
+        size_t total = sizeof(cache_header) + sizeof(symbol) * (size_t)header->symbol_count
+            + sizeof(literal) * (size_t)header->literal_count + sizeof(int) * (size_t)header->name_count
+            + sizeof(cache_code) * (size_t)header->code_count + (size_t)header->string_size;
+        valid = (total == (size_t)size) && header->checksum == hash_bytes(14695981039346656037ull, data + sizeof(cache_header), total - sizeof(cache_header));
+    }
+    if (valid) {
+        cache->symbols = (symbol*)(data + sizeof(cache_header));
+        cache->literals = (literal*)(cache->symbols + header->symbol_count);
+        cache->names = (int*)(cache->literals + header->literal_count);
+        cache->codes = (cache_code*)(cache->names + header->name_count);
+        cache->strings = (char*)(cache->codes + header->code_count);
+        valid = (cache->strings[header->string_size - 1] == '\0');
+        for (int i = 0; valid && i < header->name_count; i++)
+            valid = (cache->names[i] >= 0 && cache->names[i] < header->string_size);
+        for (int i = 0; valid && i < header->code_count; i++)
+            valid = (cache->codes[i].line_index >= 0 && cache->codes[i].line_index < header->line_count
+                && cache->codes[i].modify >= -1 && cache->codes[i].modify < header->string_size
+                && (cache->codes[i].record != 'M' || cache->codes[i].modify >= 0));
+        for (int i = 0; valid && i < header->symbol_count; i++)
+            valid = (cache->symbols[i].name >= 0 && cache->symbols[i].name < header->string_size);
+        for (int i = 0; valid && i < header->literal_count; i++)
+            valid = (cache->literals[i].name >= 0 && cache->literals[i].name < header->string_size);
+    }
+    if (!valid) {
+        free(data);
+        return;
+    }
+    cache->data = data;
+    cache->header = header;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 캐시에서 가져오는 섹션의 라인 중 빈 토큰(cached_token)을 실제 토큰으로 바꾸는 함수이다.
+* 매계 : 섹션, 토큰을 할당할 arena, 모든 라인이면 true(false이면 H/D/R 레코드의 라인만),
+*        이름을 추가할 문자열 테이블(NULL이면 ctx->names에서 찾기만 한다)
+* 반환 : 정상종료 = 0, 에러 < 0
+* 주의 : 오브젝트 프로그램을 출력할 때 H/D/R 레코드는 토큰의 label, operand를 사용한다.
+*        패스2에서 다시 분리하는 경우 섹션의 심볼, 리터럴, EXTREF 변수는 이미 names에 있다.
+* -----------------------------------------------------------------------------------
+*/
+static int cache_tokenize(section_cache* cache, arena* pool, bool all, intern_table* names)
+{
+    int count = all ? cache->line_end - cache->line_start : cache->header->code_count;
+    for (int j = 0; j < count; j++) {
+        int line = cache->line_start + j;
+        if (!all) {
+            if (cache->codes[j].record != 'H' && cache->codes[j].record != 'D' && cache->codes[j].record != 'R')
+                continue;
+            line = cache->line_start + cache->codes[j].line_index;
+        }
+        if (ctx->token_table[line] != &cached_token)
+            continue;
+        token* tok = (token*)arena_alloc(pool, sizeof(token));
+        if (tokenize_source(line, tok) < 0)
+            return -1;
+        intern_token(tok, names);
+        ctx->token_table[line] = tok;
+    }
+    return 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 다시 어셈블하는 라인 하나가 정의하는 이름과 사용하는 이름을 확인하는 함수이다.
+*        label을 이름 테이블에 추가하고, EQU 수식이 앞 섹션의 심볼을 사용하면 섹션을
+*        저장하지 않도록 표시한다.
+* 매계 : token_table에서의 index, 섹션 번호(+1), label 테이블,
+*        LTORG/END로 배치되지 않은 리터럴이 있는지, 저장할 수 있는 섹션인지
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void cache_scan_line(int line, int owner, name_set* labels, bool* pending, bool* cacheable)
+{
+    token* tok = ctx->token_table[line];
+
+    if (strlen(tok->label) > 0 && strcmp(tok->label, ".") != 0)
+        name_set_insert(labels, tok->label, owner);
+    //pool_literals()와 같은 순서로 배치한 뒤 리터럴 추가(리터럴은 다음 LTORG/END까지 배치되지 않음)
+    if (tok->kind == OP_LTORG || tok->kind == OP_END)
+        *pending = false;
+    if (tok->operand[0][0] == '=')
+        *pending = true;
+    if (tok->kind == OP_EQU) {
+        expression* expr = token_expression(tok, &ctx->asm_arena, &ctx->names);
+        for (int i = 0; i < expr->count; i++) {
+            if (expr->item[i].kind != EXPR_SYMBOL)
+                continue;
+            int found = name_set_find(labels, expr->item[i].name);
+            if (found >= 0 && found != owner)
+                *cacheable = false;
+        }
+    }
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 캐시에서 가져올 섹션들이 앞 섹션들과 여전히 독립적인지 확인하는 함수이다.
+*        패스1의 토큰 분리가 끝난 뒤 소스 순서대로 섹션을 따라가며 앞에서 정의된
+*        label을 모으고, 다음 경우에는 캐시를 버리고 다시 어셈블한다.
+*        1. 섹션이 시작할 때 앞 섹션에서 배치되지 않은 리터럴이 남아있는 경우
+*           (리터럴은 LTORG 범위 안에서만 중복을 확인하므로, 남은 리터럴이 없으면
+*           섹션의 리터럴은 앞 섹션과 관계없이 모두 섹션 안에서 추가되고 배치된다)
+*        2. EQU 수식의 symbol이 앞 섹션에 정의된 경우
+*        다시 어셈블하는 섹션은 같은 조건으로 캐시에 저장할 수 있는지 표시한다.
+* 매계 : 없음
+* 반환 : 정상종료 = 0, 에러 < 0
+* 주의 : 첫 섹션 이전 라인에 label이 있으면 섹션 번호가 달라지므로 캐시를 사용하지 않는다.
+* -----------------------------------------------------------------------------------
+*/
+static int cache_validate(void)
+{
+    name_set labels = { 0 };
+    bool pending = false;       //LTORG/END로 배치되지 않은 리터럴이 있으면 true
+    bool disable = false;
+    bool unused = true;
+    int result = 0;
+
+    int first = (ctx->cache_count > 0) ? ctx->cache_table[0].line_start : ctx->line_num;
+    for (int i = 0; i < first; i++) {
+        if (strlen(ctx->token_table[i]->label) > 0 && strcmp(ctx->token_table[i]->label, ".") != 0)
+            disable = true;
+        cache_scan_line(i, 0, &labels, &pending, &unused);
+    }
+
+    for (int k = 0; k < ctx->cache_count; k++) {
+        section_cache* cache = &ctx->cache_table[k];
+        if (disable)
+            cache->cacheable = false;
+
+        if (cache->data != NULL) {
+            bool valid = !disable && !pending;
+            for (int j = 0; valid && j < cache->header->name_count; j++)
+                valid = (name_set_find(&labels, cache->strings + cache->names[j]) < 0);
+            if (valid) {
+                for (int j = 0; j < cache->header->symbol_count; j++)
+                    name_set_insert(&labels, cache->strings + cache->symbols[j].name, k + 1);
+                if (cache_tokenize(cache, &ctx->asm_arena, false, &ctx->names) < 0) {
+                    result = -1;
+                    break;
+                }
+                continue;
+            }
+            //캐시를 버리고 라인을 토큰으로 분리
+            free(cache->data);
+            cache->data = NULL;
+            if (cache_tokenize(cache, &ctx->asm_arena, true, &ctx->names) < 0) {
+                result = -1;
+                break;
+            }
+        }
+
+        bool entryPending = pending;
+        for (int i = cache->line_start; i < cache->line_end; i++)
+            cache_scan_line(i, k + 1, &labels, &pending, &cache->cacheable);
+        if (entryPending || pending)
+            cache->cacheable = false;
+    }
+
+    free(labels.slot);
+    return result;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : line이 캐시에서 가져오는 섹션의 첫 라인인지 확인하는 함수이다.
+* 매계 : cache_table에서 현재 위치(소스 순서대로 호출하며 증가), token_table에서의 index
+* 반환 : 캐시에서 가져오는 섹션의 첫 라인이면 해당 섹션, 아니면 NULL
+* -----------------------------------------------------------------------------------
+*/
+static section_cache* cache_at(int* cursor, int line)
+{
+    while (*cursor < ctx->cache_count && ctx->cache_table[*cursor].line_end <= line)
+        (*cursor)++;
+    if (*cursor < ctx->cache_count && ctx->cache_table[*cursor].line_start == line && ctx->cache_table[*cursor].data != NULL)
+        return &ctx->cache_table[*cursor];
+    return NULL;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 캐시에 저장된 섹션의 리터럴을 literal_table에 추가하는 함수이다.(패스1의 2단계)
+* 매계 : 섹션
+* 반환 : 없음
+* 주의 : 캐시에 저장된 섹션의 리터럴은 모두 섹션 안에서 배치되므로 주소가 정해져 있다.
+* -----------------------------------------------------------------------------------
+*/
+static void cache_replay_literals(section_cache* cache)
+{
+    RESERVE_TABLE(ctx->literal_table, ctx->literal_capacity, ctx->literal_index + cache->header->literal_count);
+    for (int j = 0; j < cache->header->literal_count; j++) {
+        ctx->literal_table[ctx->literal_index] = cache->literals[j];
+        ctx->literal_table[ctx->literal_index].name = intern_copy(&ctx->names, cache->strings + cache->literals[j].name);
+        ctx->literal_table[ctx->literal_index].pool_line += cache->line_start;
+        literal_insert(ctx->literal_index);
+        ctx->literal_index++;
+    }
+    ctx->literal_pooled = ctx->literal_index;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 캐시에 저장된 섹션을 section_table에 추가하고 심볼을 sym_table에 추가하는
+*        함수이다.(패스1의 4단계)
+* 매계 : 섹션
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void cache_replay_symbols(section_cache* cache)
+{
+    ctx->token_line = cache->line_start;
+    begin_section();
+    for (int j = 0; j < cache->header->symbol_count; j++)
+        insert_symbol(intern_copy(&ctx->names, cache->strings + cache->symbols[j].name), cache->symbols[j].addr, cache->symbols[j].absolute);
+    ctx->literal_start += cache->header->literal_count;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 캐시에 저장된 섹션의 오브젝트 코드를 섹션의 코드 버퍼에 추가하는 함수이다.(패스2)
+* 매계 : 섹션의 패스2 정보, 섹션
+* 반환 : 추가했으면 true, 캐시를 사용할 수 없으면 false
+* 주의 : LTORG/END는 다음 리터럴의 주소가 현재 주소와 같으면 계속 배치하므로, 다음
+*        섹션의 첫 리터럴이 저장할 때 비교한 주소와 같아졌다면 캐시를 사용할 수 없다.
+* -----------------------------------------------------------------------------------
+*/
+static bool cache_replay_codes(pass2* unit, section_cache* cache)
+{
+    if (cache->header->boundary_addr >= 0 && unit->literal_end < ctx->literal_index
+        && ctx->literal_table[unit->literal_end].addr == cache->header->boundary_addr)
+        return false;
+
+    for (int j = 0; j < cache->header->code_count; j++) {
+        cache_code* saved = &cache->codes[j];
+        if (saved->record == 'M') {
+            const char* name = cache->strings + saved->modify;
+            emit_modify(unit, saved->format, saved->addr, name[0], name + 1);
+            continue;
+        }
+        code* object = emit_code(unit, saved->record, saved->format, saved->addr, cache->line_start + saved->line_index);
+        if (saved->record == 'T')
+            object->code = saved->code;
+    }
+    unit->locctr = cache->header->locctr;
+    return true;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 캐시 파일의 문자열 영역에 문자열을 추가하는 함수이다.
+* 매계 : 문자열 영역, 영역의 크기, 영역의 용량, 추가할 문자열
+* 반환 : 추가한 문자열의 offset
+* -----------------------------------------------------------------------------------
+*/
+static int cache_add_string(char** strings, int* size, int* capacity, const char* str)
+{
+    int offset = *size;
+    int length = (int)strlen(str) + 1;
+    RESERVE_TABLE(*strings, *capacity, *size + length);
+    memcpy(*strings + offset, str, length);
+    *size += length;
+    return offset;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 패스2가 끝난 섹션의 결과를 캐시 파일(cache_dir/<key>.sec)에 저장하는 함수이다.
+* 매계 : 섹션의 패스2 정보, 섹션
+* 반환 : 없음
+* 주의 : 여러 스레드(batch 모드의 여러 파일)가 같은 key를 저장할 수 있으므로 임시
+*        파일에 쓴 뒤 rename()으로 바꾼다. 저장에 실패해도 어셈블 결과에는 영향이 없다.
+* -----------------------------------------------------------------------------------
+*/
+static void cache_store(pass2* unit, section_cache* cache)
+{
+    //다음 섹션의 리터럴까지 배치했거나 여러 번 비교한 경우 저장하지 않음
+    if (unit->literal_cursor > unit->literal_end || unit->boundary_check > 1)
+        return;
+
+    section* sec = &ctx->section_table[unit->section];
+    int literalBegin = sec->literal_begin;
+    int literalCount = unit->literal_end - literalBegin;
+    char* strings = NULL;
+    int stringSize = 0;
+    int stringCapacity = 0;
+    int* names = NULL;
+    int nameCount = 0;
+    int nameCapacity = 0;
+
+    RESERVE_TABLE(names, nameCapacity, 1);
+    cache_add_string(&strings, &stringSize, &stringCapacity, "");
+    //EQU 수식에서 검색하는 symbol 이름(다음에 앞 섹션에 정의되었는지 확인)
+    for (int i = cache->line_start; i < cache->line_end; i++) {
+        token* tok = ctx->token_table[i];
+        if (tok->kind != OP_EQU)
+            continue;
+        expression* expr = token_expression(tok, &unit->pool, NULL);
+        RESERVE_TABLE(names, nameCapacity, nameCount + expr->symbol_count);
+        for (int j = 0; j < expr->count; j++) {
+            if (expr->item[j].kind == EXPR_SYMBOL)
+                names[nameCount++] = cache_add_string(&strings, &stringSize, &stringCapacity, expr->item[j].name);
+        }
+    }
+
+    //심볼, 리터럴의 이름은 ID 대신 문자열 위치로 저장
+    symbol* symbols = (symbol*)malloc(sizeof(symbol) * (sec->sym_count + 1));
+    for (int j = 0; j < sec->sym_count; j++) {
+        symbols[j] = ctx->sym_table[sec->sym_start + j];
+        symbols[j].name = cache_add_string(&strings, &stringSize, &stringCapacity, ctx->names.entry[symbols[j].name].name);
+    }
+    literal* literals = (literal*)malloc(sizeof(literal) * (literalCount + 1));
+    for (int j = 0; j < literalCount; j++) {
+        literals[j] = ctx->literal_table[literalBegin + j];
+        literals[j].name = cache_add_string(&strings, &stringSize, &stringCapacity, ctx->names.entry[literals[j].name].name);
+        literals[j].pool_line -= cache->line_start;
+    }
+    //M 레코드는 섹션의 코드 뒤에 레코드 종류 'M'으로 저장
+    int codeCount = unit->code_index + unit->modify_index;
+    cache_code* codes = (cache_code*)calloc(codeCount + 1, sizeof(cache_code));
+    for (int j = 0; j < unit->code_index; j++) {
+        codes[j].format = unit->code_table[j].format;
+        codes[j].addr = unit->code_table[j].addr;
+        codes[j].code = unit->code_table[j].code;
+        codes[j].line_index = unit->code_table[j].line_index - cache->line_start;
+        codes[j].record = unit->code_table[j].record;
+        codes[j].modify = -1;
+    }
+    for (int j = 0; j < unit->modify_index; j++) {
+        cache_code* saved = &codes[unit->code_index + j];
+        saved->format = unit->modify_table[j].format;
+        saved->addr = unit->modify_table[j].addr;
+        saved->record = 'M';
+        saved->modify = cache_add_string(&strings, &stringSize, &stringCapacity, unit->modify_table[j].name);
+    }
+
+    cache_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.key = cache->key;
+    header.line_count = cache->line_end - cache->line_start;
+    header.symbol_count = sec->sym_count;
+    header.literal_count = literalCount;
+    header.name_count = nameCount;
+    header.code_count = codeCount;
+    header.locctr = unit->locctr;
+    header.boundary_addr = (unit->boundary_check > 0) ? unit->boundary_addr : -1;
+    header.string_size = stringSize;
+    //저장하는 순서대로 내용의 해시 값 계산
+    unsigned long long checksum = 14695981039346656037ull;
+    checksum = hash_bytes(checksum, symbols, sizeof(symbol) * sec->sym_count);
+    checksum = hash_bytes(checksum, literals, sizeof(literal) * literalCount);
+    checksum = hash_bytes(checksum, names, sizeof(int) * nameCount);
+    checksum = hash_bytes(checksum, codes, sizeof(cache_code) * codeCount);
+    header.checksum = hash_bytes(checksum, strings, stringSize);
+
+    char* path = (char*)malloc(strlen(cache_dir) + 32);
+    char* tempPath = (char*)malloc(strlen(cache_dir) + 64);
+    sprintf(path, "%s/%016llx.sec", cache_dir, cache->key);
+    sprintf(tempPath, "%s.%d.%lx", path, (int)getpid(), (unsigned long)pthread_self());
+    FILE* file = fopen(tempPath, "wb");
+    if (file != NULL) {
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(symbols, sizeof(symbol), sec->sym_count, file);
+        fwrite(literals, sizeof(literal), literalCount, file);
+        fwrite(names, sizeof(int), nameCount, file);
+        fwrite(codes, sizeof(cache_code), codeCount, file);
+        fwrite(strings, 1, stringSize, file);
+        bool isError = ferror(file) != 0;
+        if (fclose(file) != 0 || isError || rename(tempPath, path) != 0)
+            remove(tempPath);
+    }
+
+    free(path);
+    free(tempPath);
+    free(symbols);
+    free(literals);
+    free(codes);
+    free(names);
+    free(strings);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : cache_table과 읽어들인 캐시 파일을 해제하는 함수이다.
+* 매계 : 없음
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void cache_release(void)
+{
+    for (int k = 0; k < ctx->cache_count; k++)
+        free(ctx->cache_table[k].data);
+    free(ctx->cache_table);
+    ctx->cache_table = NULL;
+    ctx->cache_count = ctx->cache_capacity = 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 이름 테이블에서 이름을 찾는 함수이다.
+* 매계 : 이름 테이블, 이름
+* 반환 : 이름을 처음 정의한 섹션 번호(owner), 없으면 -1
+* -----------------------------------------------------------------------------------
+*/
+static int name_set_find(name_set* set, char* name)
+{
+    if (set->slot == NULL)
+        return -1;
+    unsigned int i = hash_string(name, 0) & set->mask;
+    while (set->slot[i].name != NULL) {
+        if (strcmp(set->slot[i].name, name) == 0)
+            return set->slot[i].owner;
+        i = (i + 1) & set->mask;
+    }
+    return -1;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 이름 테이블에 이름을 추가하는 함수이다. 이미 있으면 처음 owner를 유지한다.
+* 매계 : 이름 테이블, 이름, 섹션 번호
+* 반환 : 없음
+* 주의 : 슬롯의 절반 이상이 차면 두 배 크기로 다시 만든다.
+* -----------------------------------------------------------------------------------
+*/
+static void name_set_insert(name_set* set, char* name, int owner)
+{
+    if (name_set_find(set, name) >= 0)
+        return;
+
+    if (set->slot == NULL || (unsigned int)(set->count + 1) * 2 > set->mask + 1) {
+        unsigned int size = (set->slot == NULL) ? 64 : (set->mask + 1) * 2;
+        struct name_slot_unit* oldSlot = set->slot;
+        unsigned int oldSize = (set->slot == NULL) ? 0 : set->mask + 1;
+        set->slot = (struct name_slot_unit*)calloc(size, sizeof(struct name_slot_unit));
+        set->mask = size - 1;
+        for (unsigned int i = 0; i < oldSize; i++) {
+            if (oldSlot[i].name == NULL)
+                continue;
+            unsigned int j = hash_string(oldSlot[i].name, 0) & set->mask;
+            while (set->slot[j].name != NULL)
+                j = (j + 1) & set->mask;
+            set->slot[j] = oldSlot[i];
+        }
+        free(oldSlot);
+    }
+
+    unsigned int i = hash_string(name, 0) & set->mask;
+    while (set->slot[i].name != NULL)
+        i = (i + 1) & set->mask;
+    set->slot[i].name = name;
+    set->slot[i].owner = owner;
+    set->count++;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 벤치마크에서 시간을 재기 위해 현재 시각을 초 단위로 알려주는 함수이다.
+* 매계 : 없음
+* 반환 : CLOCK_MONOTONIC 기준의 시각(초)
+* -----------------------------------------------------------------------------------
+*/
+static double now_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 벤치마크 결과 한 줄(단계 이름, 시간, 초당 라인 수, 초당 byte 수)을 출력하는 함수이다.
+* 매계 : 단계 이름, 걸린 시간(초), 처리한 라인 수, 처리한 byte 수
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void bench_report(const char* stage, double seconds, long long lines, long long bytes)
+{
+    double divisor = (seconds > 0) ? seconds : 1e-9;
+    printf("%-24s %10.6f %14.0f %14.0f\n", stage, seconds, lines / divisor, bytes / divisor);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 두 파일의 내용이 같은지 비교하는 함수이다.
+* 매계 : 비교할 파일 두 개
+* 반환 : 같으면 0, 다르거나 읽을 수 없으면 < 0
+* -----------------------------------------------------------------------------------
+*/
+static int compare_file(char* file_name, char* ref_name)
+{
+    FILE* file = fopen(file_name, "rb");
+    FILE* ref = fopen(ref_name, "rb");
+    int result = (file != NULL && ref != NULL) ? 0 : -1;
+    char buffer[2][4096];
+    while (result == 0) {
+        size_t size = fread(buffer[0], 1, sizeof(buffer[0]), file);
+        size_t refSize = fread(buffer[1], 1, sizeof(buffer[1]), ref);
+        if (size != refSize || memcmp(buffer[0], buffer[1], size) != 0)
+            result = -1;
+        if (size == 0)
+            break;
+    }
+    if (file != NULL)
+        fclose(file);
+    if (ref != NULL)
+        fclose(ref);
+    return result;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 출력 파일의 크기를 알려주는 함수이다.(벤치마크의 byte 수)
+* -----------------------------------------------------------------------------------
+*/
+static long long file_size(char* file_name)
+{
+    struct stat info;
+    return (stat(file_name, &info) == 0) ? (long long)info.st_size : 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 소스 파일 하나를 단계별로 시간을 재며 어셈블하고 결과를 출력하는 함수이다.
+*        입력과 패스1/패스2는 소스의 라인 수와 크기로, make_*_output은 출력한
+*        파일의 크기로 처리 속도를 계산한다.
+* 매계 : 소스 파일 정보, 비교할 기준 디렉터리(NULL이면 비교하지 않음)
+* 반환 : 정상종료 = 0, 실패하거나 기준과 다르면 < 0
+* 주의 : 한 단계가 라인 수에 비례하지 않고 느려지면(예: 이중 반복문) 큰 소스에서
+*        lines/s가 크게 떨어지므로 여러 크기의 소스로 비교하면 알 수 있다.
+* -----------------------------------------------------------------------------------
+*/
+static int bench_file(batch* unit, char* ref_dir)
+{
+    double time[7];
+    int result = 0;
+
+    printf("%s\n", unit->source);
+    time[0] = now_seconds();
+    if (init_input_file(unit->source) < 0)
+        result = -1;
+    time[1] = now_seconds();
+    if (result == 0 && assem_pass1() < 0)
+        result = -1;
+    time[2] = now_seconds();
+    if (result == 0) {
+        make_symtab_output(unit->symtab_file);
+        time[3] = now_seconds();
+        make_literaltab_output(unit->literal_file);
+        time[4] = now_seconds();
+        if (assem_pass2() < 0)
+            result = -1;
+        time[5] = now_seconds();
+        if (result == 0)
+            make_objectcode_output(unit->object_file);
+        time[6] = now_seconds();
+    }
+
+    if (result == 0) {
+        long long lines = ctx->line_num;
+        long long bytes = (long long)ctx->input_text_size;
+        bench_report("  init_input_file", time[1] - time[0], lines, bytes);
+        bench_report("  assem_pass1", time[2] - time[1], lines, bytes);
+        bench_report("  make_symtab_output", time[3] - time[2], ctx->sym_index, file_size(unit->symtab_file));
+        bench_report("  make_literaltab_output", time[4] - time[3], ctx->literal_index, file_size(unit->literal_file));
+        bench_report("  assem_pass2", time[5] - time[4], lines, bytes);
+        bench_report("  make_objectcode_output", time[6] - time[5], ctx->code_index, file_size(unit->object_file));
+        bench_report("  total", time[6] - time[0], lines, bytes);
+    }
+    release_my_assembler();
+    if (result < 0 || ref_dir == NULL)
+        return result;
+
+    //기준 디렉터리의 같은 이름 파일과 비교
+    char* outputs[3] = { unit->object_file, unit->symtab_file, unit->literal_file };
+    for (int i = 0; i < 3; i++) {
+        char* base = strrchr(outputs[i], '/');
+        base = (base == NULL) ? outputs[i] : base + 1;
+        char* refName = (char*)malloc(strlen(ref_dir) + strlen(base) + 2);
+        sprintf(refName, "%s/%s", ref_dir, base);
+        if (compare_file(outputs[i], refName) < 0) {
+            printf("  %s: 기준(%s)과 다릅니다.\n", outputs[i], refName);
+            result = -1;
+        }
+        free(refName);
+    }
+    if (result == 0)
+        printf("  기준과 같습니다.\n");
+    return result;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 소스 생성기에서 사용하는 xorshift 난수 생성 함수이다.(seed가 같으면 같은 소스)
+* -----------------------------------------------------------------------------------
+*/
+static unsigned int next_random(unsigned int* state)
+{
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 생성기에서 사용하는 이름(심볼, 섹션)을 만드는 함수이다.
+*        오브젝트 프로그램의 이름 칸(6글자)을 넘지 않도록 36진수로 줄여 쓴다.
+* 매계 : 이름을 저장할 버퍼, 앞 글자, 섹션 번호, 섹션 안에서의 번호(-1이면 섹션 이름)
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void generate_name(char* name, char prefix, int section_num, int index)
+{
+    const char* digits = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    int length = 0;
+    name[length++] = prefix;
+    for (int div = 36; div > 0; div /= 36)
+        name[length++] = digits[(section_num / div) % 36];
+    if (index >= 0) {
+        for (int div = 36 * 36; div > 0; div /= 36)
+            name[length++] = digits[(index / div) % 36];
+    }
+    name[length] = '\0';
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 벤치마크용 SIC/XE 소스를 만들어 표준출력으로 보내는 함수이다.
+*        spec은 "key=value,..." 형식이며 다음 값을 사용한다(괄호 안은 기본값).
+*        csects(10)   : 컨트롤 섹션 개수(첫 섹션은 START)
+*        lines(200)   : 섹션별 명령어 라인 수
+*        ext(3)       : 섹션별 EXTDEF, EXTREF 이름 개수
+*        literals(4)  : 섹션별 리터럴 개수(LTORG로 섹션 안에서 배치)
+*        equ(2)       : 섹션별 -가 들어간 EQU 수식 개수
+*        f2(20), f4(10) : 명령어 중 2-byte, 4-byte format의 비율(%)
+*        seed(1)      : 난수 seed
+* 매계 : spec 문자열
+* 반환 : 정상종료 = 0, 에러 < 0
+* -----------------------------------------------------------------------------------
+*/
+static int generate_source(char* spec)
+{
+    int csects = 10, lines = 200, ext = 3, literals = 4, equ = 2, f2 = 20, f4 = 10;
+    unsigned int seed = 1;
+
+    char* copy = arena_strdup(&batch_arena, spec);
+    char* context = NULL;
+    for (char* item = strtok_r(copy, ",", &context); item != NULL; item = strtok_r(NULL, ",", &context)) {
+        char* value = strchr(item, '=');
+        if (value == NULL) {
+            printf("generate_source: %s 형식이 잘못되었습니다.(key=value)\n", item);
+            return -1;
+        }
+        *value++ = '\0';
+        int number = atoi(value);
+        if (strcmp(item, "csects") == 0) csects = number;
+        else if (strcmp(item, "lines") == 0) lines = number;
+        else if (strcmp(item, "ext") == 0) ext = number;
+        else if (strcmp(item, "literals") == 0) literals = number;
+        else if (strcmp(item, "equ") == 0) equ = number;
+        else if (strcmp(item, "f2") == 0) f2 = number;
+        else if (strcmp(item, "f4") == 0) f4 = number;
+        else if (strcmp(item, "seed") == 0) seed = (unsigned int)number;
+        else {
+            printf("generate_source: 알 수 없는 값 %s\n", item);
+            return -1;
+        }
+    }
+    if (csects < 1 || csects > 36 * 36 || lines < 1 || lines >= 36 * 36 * 36 || ext < 0 || literals < 0 || equ < 0) {
+        printf("generate_source: 값의 범위가 잘못되었습니다.\n");
+        return -1;
+    }
+    if (seed == 0)
+        seed = 1;
+    //data 라인(WORD)은 명령어 라인의 1/8, EXTDEF는 data 라벨 중에서 고른다
+    int dataCnt = lines / 8 + 1;
+    if (ext > dataCnt)
+        ext = dataCnt;
+
+    writer out;
+    if (writer_open(&out, NULL) < 0)
+        return -1;
+    char name[16];
+    char other[16];
+    char line[128];
+    const char* format2[3] = { "CLEAR\tX", "COMPR\tA,S", "TIXR\tT" };
+    const char* format3[4] = { "LDA", "STA", "LDX", "COMP" };
+
+    for (int k = 0; k < csects; k++) {
+        generate_name(name, 'P', k, -1);
+        sprintf(line, "%s\t%s\n", name, (k == 0) ? "START\t0" : "CSECT");
+        writer_string(&out, line, 0);
+
+        //EXTDEF(한 라인에 MAX_OPERAND개씩)
+        for (int i = 0; i < ext; i += MAX_OPERAND) {
+            writer_string(&out, "\tEXTDEF\t", 0);
+            for (int j = i; j < ext && j < i + MAX_OPERAND; j++) {
+                generate_name(other, 'D', k, j);
+                writer_string(&out, other, 0);
+                writer_string(&out, (j + 1 < ext && j + 1 < i + MAX_OPERAND) ? "," : "\n", 0);
+            }
+        }
+        //EXTREF(다음 섹션들의 EXTDEF 이름, 섹션이 하나면 없음)
+        int refCnt = (csects > 1) ? ext : 0;
+        for (int i = 0; i < refCnt; i += MAX_OPERAND) {
+            writer_string(&out, "\tEXTREF\t", 0);
+            for (int j = i; j < refCnt && j < i + MAX_OPERAND; j++) {
+                generate_name(other, 'D', (k + 1 + j) % csects == k ? (k + 1) % csects : (k + 1 + j) % csects, j);
+                writer_string(&out, other, 0);
+                writer_string(&out, (j + 1 < refCnt && j + 1 < i + MAX_OPERAND) ? "," : "\n", 0);
+            }
+        }
+
+        //명령어 라인
+        for (int i = 0; i < lines; i++) {
+            unsigned int pick = next_random(&seed) % 100;
+            int target = (int)(next_random(&seed) % (unsigned int)dataCnt);
+            generate_name(name, 'L', k, i);
+            generate_name(other, (target < ext) ? 'D' : 'W', k, target);
+            if (i < literals)
+                sprintf(line, "%s\tLDA\t=C'%c%c%c'\n", name, 'A' + k % 26, 'A' + i / 26 % 26, 'A' + i % 26);
+            else if (pick < (unsigned int)f2)
+                sprintf(line, "%s\t%s\n", name, format2[pick % 3]);
+            else if (pick < (unsigned int)(f2 + f4) && refCnt > 0) {
+                generate_name(other, 'D', (k + 1) % csects, 0);
+                sprintf(line, "%s\t+JSUB\t%s\n", name, other);
+            }
+            else if (pick % 7 == 0)
+                sprintf(line, "%s\tLDA\t#%u\n", name, pick);
+            else
+                sprintf(line, "%s\t%s\t%s\n", name, format3[pick % 4], other);
+            writer_string(&out, line, 0);
+        }
+        if (literals > 0)
+            writer_string(&out, "\tLTORG\n", 0);
+
+        //data 라인과 EQU 수식
+        for (int i = 0; i < dataCnt; i++) {
+            generate_name(name, (i < ext) ? 'D' : 'W', k, i);
+            sprintf(line, "%s\tWORD\t%d\n", name, i);
+            writer_string(&out, line, 0);
+        }
+        for (int i = 0; i < equ; i++) {
+            generate_name(name, 'E', k, i);
+            generate_name(other, 'L', k, (int)(next_random(&seed) % (unsigned int)lines));
+            char first[16];
+            generate_name(first, 'L', k, 0);
+            sprintf(line, "%s\tEQU\t%s-%s\n", name, other, first);
+            writer_string(&out, line, 0);
+        }
+    }
+    generate_name(name, 'L', 0, 0);
+    sprintf(line, "\tEND\t%s\n", name);
+    writer_string(&out, line, 0);
+    return writer_close(&out);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 패스2가 끝난 code_table을 바로 링크하여 메모리 이미지를 만드는 링킹 로더이다.
+*        1. H, D 레코드로 ESTAB(섹션 이름과 외부 심볼의 로드된 주소)을 만들고
+*        2. T 레코드의 object code를 이미지에 쓴 뒤
+*        3. M 레코드를 한 번에 적용하여 외부 참조와 재배치 주소를 고친다.
+*        섹션은 소스 순서대로 load_addr부터 이어서 배치한다.
+* 매계 : 만들 이미지, 로드 주소
+* 반환 : 정상종료 = 0, 에러 < 0(중복되거나 정의되지 않은 외부 심볼, 주소 공간 초과)
+* 주의 : 실패한 경우에도 release_image()로 이미지를 해제해야 한다.
+* -----------------------------------------------------------------------------------
+*/
+int load_program(image* img, int load_addr)
+{
+    STAT_PHASE(PHASE_LOAD);
+    memset(img, 0, sizeof(*img));
+    img->start = img->end = img->entry = load_addr;
+
+    //ESTAB에 들어갈 이름(섹션 이름 + D 레코드 심볼) 개수를 세어 해시 테이블 크기 결정
+    int nameCnt = 0;
+    for (int i = 0; ctx->code_table[i].record != 'E'; i++) {
+        if (ctx->code_table[i].record == 'H')
+            nameCnt++;
+        else if (ctx->code_table[i].record == 'D')
+            nameCnt += ctx->code_table[i].format;
+    }
+    unsigned int size = 16;
+    while (size < (unsigned int)nameCnt * 2)
+        size *= 2;
+    estab* table = (estab*)malloc(sizeof(estab) * (nameCnt + 1));
+    sym_hash hash = { (int*)calloc(size, sizeof(int)), size - 1, 0 };
+    int count = 0;
+    int result = 0;
+
+    //1. ESTAB 만들기
+    int csaddr = load_addr;
+    int length = 0;
+    int subRoutine = -1;
+    for (int i = 0; result == 0 && ctx->code_table[i].record != 'E'; i++) {
+        code* object = &ctx->code_table[i];
+        token* tok = ctx->token_table[object->line_index];
+        if (object->record == 'H') {
+            csaddr += length;
+            length = object->addr;
+            subRoutine++;
+            if (csaddr + length > LOADER_MEMORY_SIZE) {
+                printf("load_program: %s가 주소 공간을 벗어납니다.\n", tok->label);
+                result = -1;
+            }
+            else if (estab_insert(table, &count, &hash, tok->label, csaddr) < 0)
+                result = -1;
+        }
+        else if (object->record == 'D') {
+            for (int j = 0; result == 0 && j < object->format; j++) {
+                if (estab_insert(table, &count, &hash, tok->operand[j], csaddr + search_name(tok->operand_id[j], subRoutine)) < 0)
+                    result = -1;
+            }
+        }
+    }
+    img->end = csaddr + length;
+
+    //2. T 레코드의 object code를 이미지에 쓰기(format byte만큼, 상위 byte부터)
+    csaddr = load_addr;
+    length = 0;
+    for (int i = 0; result == 0 && ctx->code_table[i].record != 'E'; i++) {
+        code* object = &ctx->code_table[i];
+        if (object->record == 'H') {
+            csaddr += length;
+            length = object->addr;
+        }
+        else if (object->record == 'T' && object->format >= 1 && object->format <= 4) {
+            for (int j = 0; j < object->format; j++)
+                *image_byte(img, csaddr + object->addr + j) = (unsigned char)((unsigned int)object->code >> (8 * (object->format - 1 - j)));
+        }
+    }
+
+    //3. M 레코드 적용(format은 고칠 half-byte 개수, 홀수이면 첫 byte의 하위 4bit부터)
+    //   루틴의 M 레코드는 다음 H 레코드가 가리키는 index 이전까지이다.
+    csaddr = load_addr;
+    length = 0;
+    int modifyIndex = 0;
+    for (int i = 0; result == 0; i++) {
+        code* next = &ctx->code_table[i];
+        if (next->record != 'H' && next->record != 'E')
+            continue;
+        int modifyEnd = (next->record == 'H') ? next->code : ctx->modify_index;
+        for (; modifyIndex < modifyEnd; modifyIndex++) {
+            modify* object = &ctx->modify_table[modifyIndex];
+            int index = estab_find(table, &hash, object->name + 1);
+            if (index < 0) {
+                printf("load_program: 정의되지 않은 외부 심볼 %s\n", object->name + 1);
+                result = -1;
+                break;
+            }
+            int byteCnt = (object->format + 1) / 2;
+            unsigned int value = 0;
+            for (int j = 0; j < byteCnt; j++)
+                value = (value << 8) | *image_byte(img, csaddr + object->addr + j);
+            unsigned int mask = (object->format >= 8) ? 0xFFFFFFFFu : (1u << (4 * object->format)) - 1;
+            unsigned int field = (object->name[0] == '-') ? value - (unsigned int)table[index].addr : value + (unsigned int)table[index].addr;
+            value = (value & ~mask) | (field & mask);
+            for (int j = byteCnt - 1; j >= 0; j--, value >>= 8)
+                *image_byte(img, csaddr + object->addr + j) = (unsigned char)value;
+        }
+        if (next->record == 'E')
+            break;
+        csaddr += length;
+        length = next->addr;
+    }
+
+    free(hash.slot);
+    free(table);
+    return result;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 이미지에서 주소에 해당하는 byte의 위치를 알려주는 함수이다.
+*        페이지가 아직 없으면 0으로 채운 페이지를 할당한다.
+* 매계 : 이미지, 주소(LOADER_MEMORY_SIZE 미만)
+* 반환 : byte의 위치
+* -----------------------------------------------------------------------------------
+*/
+static unsigned char* image_byte(image* img, int addr)
+{
+    unsigned char** page = &img->page[(addr & (LOADER_MEMORY_SIZE - 1)) / LOADER_PAGE_SIZE];
+    if (*page == NULL) {
+        *page = (unsigned char*)calloc(LOADER_PAGE_SIZE, 1);
+        if (*page == NULL) {
+            printf("image_byte: 메모리 할당에 실패했습니다.\n");
+            exit(1);
+        }
+        STAT_ADD(STAT_ALLOC, 1);
+        STAT_ADD(STAT_ALLOC_BYTES, LOADER_PAGE_SIZE);
+    }
+    return *page + (addr & (LOADER_PAGE_SIZE - 1));
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 이미지를 파일로 저장하는 함수이다. 파일의 0번째 byte가 로드 주소이며,
+*        할당되지 않은 페이지는 쓰지 않고 건너뛰므로(sparse file) 디스크를 차지하지 않는다.
+* 매계 : 이미지, 저장할 파일 이름
+* 반환 : 정상종료 = 0, 에러 < 0
+* -----------------------------------------------------------------------------------
+*/
+static int write_image(image* img, char* file_name)
+{
+    int fd = open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        printf("write_image: %s 파일을 열 수 없습니다.\n", file_name);
+        return -1;
+    }
+    int result = 0;
+    for (int addr = img->start; result == 0 && addr < img->end; addr = (addr / LOADER_PAGE_SIZE + 1) * LOADER_PAGE_SIZE) {
+        unsigned char* page = img->page[addr / LOADER_PAGE_SIZE];
+        int pageEnd = (addr / LOADER_PAGE_SIZE + 1) * LOADER_PAGE_SIZE;
+        if (pageEnd > img->end)
+            pageEnd = img->end;
+        if (page == NULL)
+            continue;
+        size_t size = (size_t)(pageEnd - addr);
+        if (pwrite(fd, page + (addr & (LOADER_PAGE_SIZE - 1)), size, addr - img->start) != (ssize_t)size)
+            result = -1;
+    }
+    //마지막 부분이 비어 있어도 파일 크기는 프로그램 길이와 같게
+    if (result == 0 && ftruncate(fd, img->end - img->start) < 0)
+        result = -1;
+    if (close(fd) < 0)
+        result = -1;
+    if (result < 0)
+        printf("write_image: %s 파일에 쓸 수 없습니다.\n", file_name);
+    return result;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 이미지가 할당한 페이지를 해제하는 함수이다.
+* 매계 : 이미지
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+void release_image(image* img)
+{
+    for (int i = 0; i < LOADER_MEMORY_SIZE / LOADER_PAGE_SIZE; i++) {
+        free(img->page[i]);
+        img->page[i] = NULL;
+    }
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : ESTAB에서 이름에 해당하는 항목의 index를 찾는 함수이다.
+* 매계 : ESTAB, 해시 테이블, 이름
+* 반환 : 정상종료 = ESTAB의 index, 에러 < 0
+* -----------------------------------------------------------------------------------
+*/
+static int estab_find(estab* table, sym_hash* hash, char* name)
+{
+    unsigned int i = hash_string(name, 0) & hash->mask;
+    STAT_ADD(STAT_SYMBOL_SEARCH, 1);
+    while (hash->slot[i] != 0) {
+        STAT_ADD(STAT_SYMBOL_PROBE, 1);
+        if (strcmp(table[hash->slot[i] - 1].name, name) == 0)
+            return hash->slot[i] - 1;
+        i = (i + 1) & hash->mask;
+    }
+    return -1;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : ESTAB에 이름과 로드된 주소를 추가하는 함수이다.
+* 매계 : ESTAB, ESTAB의 항목 개수, 해시 테이블, 이름, 주소
+* 반환 : 정상종료 = 0, 이미 있는 이름이면 < 0
+* 주의 : 해시 테이블은 load_program()에서 이름 개수의 두 배 이상으로 미리 만든다.
+* -----------------------------------------------------------------------------------
+*/
+static int estab_insert(estab* table, int* count, sym_hash* hash, char* name, int addr)
+{
+    if (estab_find(table, hash, name) >= 0) {
+        printf("estab_insert: 외부 심볼 %s가 중복되었습니다.\n", name);
+        return -1;
+    }
+    table[*count].name = name;
+    table[*count].addr = addr;
+    unsigned int i = hash_string(name, 0) & hash->mask;
+    while (hash->slot[i] != 0)
+        i = (i + 1) & hash->mask;
+    hash->slot[i] = ++*count;
+    hash->count++;
+    return 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 텍스트 오브젝트 프로그램과 binary 오브젝트 파일을 서로 변환하는 함수이다.
+*        파일의 앞부분이 OBJFILE_MAGIC이면 binary에서 텍스트(<이름>.obj)로, 아니면
+*        텍스트에서 binary(<이름>.sxo)로 변환한다.
+* 매계 : 변환할 파일, 결과를 저장할 디렉터리(NULL이면 변환할 파일과 같은 디렉터리)
+* 반환 : 정상종료 = 0, 에러 < 0
+* 주의 : 텍스트에서 변환할 때는 binary를 다시 텍스트로 만든 결과가 원래 파일과 같은지
+*        확인하므로, 표현할 수 없는 레코드(6글자보다 긴 이름 등)가 있으면 실패한다.
+* -----------------------------------------------------------------------------------
+*/
+static int convert_object(char* file_name, char* out_dir)
+{
+    int fd = open(file_name, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) < 0) {
+        printf("convert_object: %s 파일을 열 수 없습니다.\n", file_name);
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    size_t size = (size_t)info.st_size;
+    char* data = (size > 0) ? (char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if (data == MAP_FAILED) {
+        printf("convert_object: %s 파일을 읽을 수 없습니다.\n", file_name);
+        return -1;
+    }
+
+    //결과 파일 이름 정하기(확장자를 뗀 이름 + .obj/.sxo)
+    bool isBinary = (size >= sizeof(OBJFILE_MAGIC) && memcmp(data, OBJFILE_MAGIC, sizeof(OBJFILE_MAGIC)) == 0);
+    char* base = strrchr(file_name, '/');
+    base = (base == NULL) ? file_name : base + 1;
+    char* ext = strrchr(base, '.');
+    int stemLen = (ext == NULL || ext == base) ? (int)strlen(base) : (int)(ext - base);
+    char* dir = (out_dir != NULL) ? out_dir : file_name;
+    int dirLen = (out_dir != NULL) ? (int)strlen(out_dir) : (int)(base - file_name);
+    char* outName = (char*)malloc(dirLen + stemLen + 6);
+    if (outName == NULL) {
+        if (data != NULL)
+            munmap(data, size);
+        return -1;
+    }
+    sprintf(outName, "%.*s%s%.*s%s", dirLen, dir, (out_dir != NULL) ? "/" : "", stemLen, base, isBinary ? ".obj" : ".sxo");
+
+    objfile obj;
+    memset(&obj, 0, sizeof(obj));
+    int result = 0;
+    if (isBinary) {
+        writer out;
+        if (read_object_binary(&obj, data, size) < 0) {
+            printf("convert_object: %s 파일의 형식이 잘못되었습니다.\n", file_name);
+            result = -1;
+        }
+        else if (writer_open(&out, outName) < 0) {
+            printf("convert_object: %s 파일을 열 수 없습니다.\n", outName);
+            result = -1;
+        }
+        else {
+            write_object_text(&obj, &out);
+            if ((result = writer_close(&out)) < 0)
+                printf("convert_object: %s 파일에 쓸 수 없습니다.\n", outName);
+        }
+    }
+    else {
+        writer check;
+        writer_open_memory(&check);
+        if (parse_object_text(&obj, data, size) < 0)
+            result = -1;
+        else {
+            //다시 텍스트로 만든 결과가 원래 파일과 같아야 변환한다
+            write_object_text(&obj, &check);
+            writer_flush(&check);
+            if (check.memory_size != size || (size > 0 && memcmp(check.memory, data, size) != 0))
+                result = -1;
+        }
+        if (result < 0)
+            printf("convert_object: %s 파일을 binary 형식으로 나타낼 수 없습니다.\n", file_name);
+        else if (write_object_binary(&obj, outName) < 0) {
+            printf("convert_object: %s 파일에 쓸 수 없습니다.\n", outName);
+            result = -1;
+        }
+        free(check.memory);
+    }
+    release_object_file(&obj);
+    if (data != NULL)
+        munmap(data, size);
+    free(outName);
+    return result;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 고정된 자리 수의 16진수 문자열을 정수로 바꾸는 함수이다.
+* 매계 : 문자열, 자리 수(1~8), 결과를 저장할 변수
+* 반환 : 모든 자리가 16진수(0-9, A-F)이면 true
+* -----------------------------------------------------------------------------------
+*/
+static bool parse_hex(const char* str, int digits, int* value)
+{
+    unsigned int number = 0;
+    if (digits < 1 || digits > 8)
+        return false;
+    for (int i = 0; i < digits; i++) {
+        if (str[i] >= '0' && str[i] <= '9')
+            number = (number << 4) | (unsigned int)(str[i] - '0');
+        else if (str[i] >= 'A' && str[i] <= 'F')
+            number = (number << 4) | (unsigned int)(str[i] - 'A' + 10);
+        else
+            return false;
+    }
+    *value = (int)number;
+    return true;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 텍스트 오브젝트 프로그램을 읽어 binary 오브젝트 파일의 테이블을 만드는 함수이다.
+*        make_objectcode_output()이 출력하는 형식(이름은 6칸, 주소는 6자리, 섹션 사이에
+*        빈 줄)을 따른다고 가정하며, 자세한 형식 확인은 convert_object()에서 다시 텍스트로
+*        만들어 비교하는 것으로 대신한다.
+* 매계 : 채울 objfile, 텍스트, 텍스트의 크기
+* 반환 : 정상종료 = 0, 에러 < 0
+* -----------------------------------------------------------------------------------
+*/
+static int parse_object_text(objfile* obj, char* text, size_t size)
+{
+    objfile_header* header = &obj->header;
+    objfile_section* current = NULL;
+    char* end = text + size;
+    char name[8];
+
+    while (text < end) {
+        char* newline = (char*)memchr(text, '\n', (size_t)(end - text));
+        char* next = (newline != NULL) ? newline + 1 : end;
+        int length = (int)(((newline != NULL) ? newline : end) - text);
+        //레코드 한 줄을 '\0'으로 끝나는 문자열로 복사
+        char* line = (char*)malloc((size_t)length + 1);
+        memcpy(line, text, (size_t)length);
+        line[length] = '\0';
+        text = next;
+
+        int value = 0;
+        bool valid = true;
+        if (length == 0)
+            valid = (current == NULL && header->section_count > 0);
+        else if (line[0] == 'H' && current == NULL && length >= 19) {
+            RESERVE_TABLE(obj->sections, obj->capacity[0], header->section_count + 1);
+            current = &obj->sections[header->section_count++];
+            memcpy(name, line + 1, 6);
+            name[6] = '\0';
+            for (int i = 5; i >= 0 && name[i] == ' '; i--)
+                name[i] = '\0';
+            current->name = object_add_string(obj, name);
+            valid = parse_hex(line + 13, length - 13, &current->length);
+            current->export_start = header->export_count;
+            current->import_start = header->import_count;
+            current->text_start = header->text_count;
+            current->byte_start = header->byte_size;
+            current->reloc_start = header->reloc_count;
+        }
+        else if (current == NULL)
+            valid = false;
+        else if (line[0] == 'D') {
+            for (int i = 1; valid && i < length; i += 12) {
+                RESERVE_TABLE(obj->exports, obj->capacity[3], header->export_count + 1);
+                objfile_export* item = &obj->exports[header->export_count++];
+                memcpy(name, line + i, 6);
+                name[6] = '\0';
+                for (int j = 5; j >= 0 && name[j] == ' '; j--)
+                    name[j] = '\0';
+                item->name = object_add_string(obj, name);
+                valid = (i + 12 <= length) && parse_hex(line + i + 6, 6, &item->addr);
+                item->line_end = (i + 12 >= length);
+                current->export_count++;
+            }
+        }
+        else if (line[0] == 'R') {
+            for (int i = 1; i < length; i += 6) {
+                RESERVE_TABLE(obj->imports, obj->capacity[5], header->import_count + 1);
+                objfile_import* item = &obj->imports[header->import_count++];
+                int nameLen = (length - i < 6) ? length - i : 6;
+                memcpy(name, line + i, (size_t)nameLen);
+                name[nameLen] = '\0';
+                for (int j = nameLen - 1; j >= 0 && name[j] == ' '; j--)
+                    name[j] = '\0';
+                item->name = object_add_string(obj, name);
+                item->line_end = (i + 6 >= length);
+                current->import_count++;
+            }
+        }
+        else if (line[0] == 'T' && length >= 9) {
+            RESERVE_TABLE(obj->texts, obj->capacity[1], header->text_count + 1);
+            objfile_text* item = &obj->texts[header->text_count++];
+            current->text_count++;
+            valid = parse_hex(line + 1, 6, &item->addr) && parse_hex(line + 7, 2, &value);
+            char* data = line + 9;
+            int digits = length - 9;
+            for (int i = 0; valid && i < digits; i++)
+                valid = (data[i] >= '0' && data[i] <= '9') || (data[i] >= 'A' && data[i] <= 'F');
+            //길이 칸과 자리 수가 맞으면 byte로, 아니면 16진수 문자열 그대로 저장
+            item->length = (unsigned char)value;
+            item->raw = (digits != value * 2);
+            item->size = (unsigned short)(item->raw ? digits : value);
+            valid = valid && digits <= 0xFFFF;
+            RESERVE_TABLE(obj->bytes, obj->capacity[7], header->byte_size + item->size);
+            if (valid && item->raw)
+                memcpy(obj->bytes + header->byte_size, data, (size_t)digits);
+            else if (valid) {
+                for (int i = 0; i < item->size; i++) {
+                    parse_hex(data + i * 2, 2, &value);
+                    obj->bytes[header->byte_size + i] = (unsigned char)value;
+                }
+            }
+            header->byte_size += item->size;
+        }
+        else if (line[0] == 'M' && length >= 10) {
+            RESERVE_TABLE(obj->relocs, obj->capacity[2], header->reloc_count + 1);
+            objfile_reloc* item = &obj->relocs[header->reloc_count++];
+            item->order = current->reloc_count++;
+            valid = parse_hex(line + 1, 6, &item->addr) && parse_hex(line + 7, 2, &value);
+            item->half_bytes = (unsigned char)value;
+            item->sign = line[9];
+            item->reserved = 0;
+            item->name = object_add_string(obj, line + 10);
+        }
+        else if (line[0] == 'E') {
+            current->entry = -1;
+            if (length > 1)
+                valid = parse_hex(line + 1, length - 1, &current->entry) && current->entry >= 0;
+            finish_object_section(obj);
+            current = NULL;
+        }
+        else
+            valid = false;
+        free(line);
+        if (!valid)
+            return -1;
+    }
+    //마지막 섹션은 E 레코드로 끝나야 한다
+    return (current == NULL) ? 0 : -1;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : objfile의 문자열 영역에 이름을 추가하는 함수이다. 같은 이름(M 레코드가 여러 번
+*        참조하는 심볼 등)은 한 번만 저장한다.
+* 매계 : objfile, 추가할 문자열
+* 반환 : 문자열 영역의 offset
+* -----------------------------------------------------------------------------------
+*/
+static int object_add_string(objfile* obj, const char* str)
+{
+    sym_hash* hash = &obj->string_hash;
+    if (hash->slot != NULL) {
+        unsigned int i = hash_string(str, 0) & hash->mask;
+        for (; hash->slot[i] != 0; i = (i + 1) & hash->mask) {
+            if (strcmp(obj->strings + hash->slot[i] - 1, str) == 0)
+                return hash->slot[i] - 1;
+        }
+    }
+    //처음 추가하거나 테이블이 절반 이상 찬 경우 두 배로 늘려서 다시 배치
+    if (hash->slot == NULL || (unsigned int)(hash->count + 1) * 2 > hash->mask + 1) {
+        unsigned int size = (hash->slot == NULL) ? 64 : (hash->mask + 1) * 2;
+        int* oldSlot = hash->slot;
+        unsigned int oldSize = (hash->slot == NULL) ? 0 : hash->mask + 1;
+        hash->slot = (int*)calloc(size, sizeof(int));
+        hash->mask = size - 1;
+        for (unsigned int i = 0; i < oldSize; i++) {
+            if (oldSlot[i] == 0)
+                continue;
+            unsigned int j = hash_string(obj->strings + oldSlot[i] - 1, 0) & hash->mask;
+            while (hash->slot[j] != 0)
+                j = (j + 1) & hash->mask;
+            hash->slot[j] = oldSlot[i];
+        }
+        free(oldSlot);
+    }
+    int offset = cache_add_string(&obj->strings, &obj->header.string_size, &obj->capacity[6], str);
+    unsigned int i = hash_string(str, 0) & hash->mask;
+    while (hash->slot[i] != 0)
+        i = (i + 1) & hash->mask;
+    hash->slot[i] = offset + 1;
+    hash->count++;
+    return offset;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 마지막 섹션의 재배치 테이블을 주소 순으로 정렬하고 export 해시 슬롯을 만드는 함수이다.
+* 매계 : objfile
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void finish_object_section(objfile* obj)
+{
+    objfile_section* current = &obj->sections[obj->header.section_count - 1];
+    //M 레코드나 D 레코드가 없는 섹션은 테이블이 아직 할당되지 않았을 수 있음(NULL)
+    if (current->reloc_count > 0)
+        qsort(obj->relocs + current->reloc_start, (size_t)current->reloc_count, sizeof(objfile_reloc), compare_reloc);
+
+    current->slot_start = obj->header.slot_count;
+    current->slot_count = 0;
+    if (current->export_count == 0)
+        return;
+    int slotCnt = 4;
+    while (slotCnt < current->export_count * 2)
+        slotCnt *= 2;
+    current->slot_count = slotCnt;
+    RESERVE_TABLE(obj->slots, obj->capacity[4], obj->header.slot_count + slotCnt);
+    int* slot = obj->slots + current->slot_start;
+    memset(slot, 0, sizeof(int) * (size_t)slotCnt);
+    for (int i = 0; i < current->export_count; i++) {
+        unsigned int j = hash_string(obj->strings + obj->exports[current->export_start + i].name, 0) & (unsigned int)(slotCnt - 1);
+        while (slot[j] != 0)
+            j = (j + 1) & (unsigned int)(slotCnt - 1);
+        slot[j] = i + 1;
+    }
+    obj->header.slot_count += slotCnt;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 재배치 항목을 주소 순(같으면 텍스트 순서)으로 정렬하기 위한 qsort() 비교 함수이다.
+* -----------------------------------------------------------------------------------
+*/
+static int compare_reloc(const void* a, const void* b)
+{
+    const objfile_reloc* left = (const objfile_reloc*)a;
+    const objfile_reloc* right = (const objfile_reloc*)b;
+    if (left->addr != right->addr)
+        return (left->addr < right->addr) ? -1 : 1;
+    return (left->order > right->order) - (left->order < right->order);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : objfile을 make_objectcode_output()과 같은 형식의 텍스트로 출력하는 함수이다.
+* 매계 : objfile, 출력할 writer
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void write_object_text(objfile* obj, writer* out)
+{
+    int* order = NULL;
+    int orderCapacity = 0;
+
+    for (int k = 0; k < obj->header.section_count; k++) {
+        objfile_section* current = &obj->sections[k];
+        writer_char(out, 'H');
+        writer_string(out, obj->strings + current->name, OBJECT_NAME_LENGTH);
+        writer_hex(out, 0, 6);
+        writer_hex(out, current->length, 6);
+        writer_char(out, '\n');
+
+        for (int i = 0; i < current->export_count; i++) {
+            objfile_export* item = &obj->exports[current->export_start + i];
+            if (i == 0 || item[-1].line_end)
+                writer_char(out, 'D');
+            writer_string(out, obj->strings + item->name, OBJECT_NAME_LENGTH);
+            writer_hex(out, item->addr, 6);
+            if (item->line_end)
+                writer_char(out, '\n');
+        }
+        for (int i = 0; i < current->import_count; i++) {
+            objfile_import* item = &obj->imports[current->import_start + i];
+            if (i == 0 || item[-1].line_end)
+                writer_char(out, 'R');
+            writer_string(out, obj->strings + item->name, OBJECT_NAME_LENGTH);
+            if (item->line_end)
+                writer_char(out, '\n');
+        }
+        unsigned char* data = obj->bytes + current->byte_start;
+        for (int i = 0; i < current->text_count; i++) {
+            objfile_text* item = &obj->texts[current->text_start + i];
+            writer_char(out, 'T');
+            writer_hex(out, item->addr, 6);
+            writer_hex(out, item->length, 2);
+            if (item->raw)
+                memcpy(writer_reserve(out, item->size), data, item->size);
+            else {
+                char* position = writer_reserve(out, (size_t)item->size * 2);
+                for (int j = 0; j < item->size; j++)
+                    memcpy(position + j * 2, hex_table + data[j] * 2, 2);
+            }
+            data += item->size;
+            writer_char(out, '\n');
+        }
+        //재배치 테이블은 주소 순으로 정렬되어 있으므로 원래 순서로 되돌려 출력
+        RESERVE_TABLE(order, orderCapacity, current->reloc_count);
+        for (int i = 0; i < current->reloc_count; i++)
+            order[i] = -1;
+        for (int i = 0; i < current->reloc_count; i++)
+            order[obj->relocs[current->reloc_start + i].order] = current->reloc_start + i;
+        for (int i = 0; i < current->reloc_count; i++) {
+            if (order[i] < 0)
+                continue;
+            objfile_reloc* item = &obj->relocs[order[i]];
+            writer_char(out, 'M');
+            writer_hex(out, item->addr, 6);
+            writer_hex(out, item->half_bytes, 2);
+            writer_char(out, (char)item->sign);
+            writer_string(out, obj->strings + item->name, 0);
+            writer_char(out, '\n');
+        }
+
+        writer_char(out, 'E');
+        if (current->entry >= 0)
+            writer_hex(out, current->entry, 6);
+        writer_string(out, (k + 1 < obj->header.section_count) ? "\n\n" : "\n", 0);
+    }
+    free(order);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : binary 오브젝트 파일에서 각 테이블의 위치(파일 앞에서부터의 offset)를 계산하는 함수이다.
+* 매계 : 테이블별 개수가 저장된 머리부, 위치를 저장할 배열(sections, texts, relocs,
+*        exports, slots, imports, strings, bytes 순서)
+* 반환 : 파일 전체의 크기
+* -----------------------------------------------------------------------------------
+*/
+static size_t object_layout(objfile_header* header, size_t offset[8])
+{
+    size_t position = sizeof(objfile_header);
+    size_t sizes[7] = {
+        sizeof(objfile_section) * (size_t)header->section_count,
+        sizeof(objfile_text) * (size_t)header->text_count,
+        sizeof(objfile_reloc) * (size_t)header->reloc_count,
+        sizeof(objfile_export) * (size_t)header->export_count,
+        sizeof(int) * (size_t)header->slot_count,
+        sizeof(objfile_import) * (size_t)header->import_count,
+        (size_t)header->string_size
+    };
+    for (int i = 0; i < 7; i++) {
+        offset[i] = position;
+        position += sizes[i];
+    }
+    //byte 영역은 mmap한 뒤 바로 사용할 수 있도록 정렬
+    position = (position + OBJFILE_ALIGN - 1) / OBJFILE_ALIGN * OBJFILE_ALIGN;
+    offset[7] = position;
+    return position + (size_t)header->byte_size;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : objfile을 binary 오브젝트 파일로 저장하는 함수이다.
+* 매계 : objfile, 저장할 파일 이름
+* 반환 : 정상종료 = 0, 에러 < 0
+* -----------------------------------------------------------------------------------
+*/
+static int write_object_binary(objfile* obj, char* file_name)
+{
+    writer out;
+    size_t offset[8];
+    static const char padding[OBJFILE_ALIGN];
+
+    if (writer_open(&out, file_name) < 0)
+        return -1;
+    memcpy(obj->header.magic, OBJFILE_MAGIC, sizeof(OBJFILE_MAGIC));
+    object_layout(&obj->header, offset);
+    writer_bytes(&out, &obj->header, sizeof(objfile_header));
+    writer_bytes(&out, obj->sections, offset[1] - offset[0]);
+    writer_bytes(&out, obj->texts, offset[2] - offset[1]);
+    writer_bytes(&out, obj->relocs, offset[3] - offset[2]);
+    writer_bytes(&out, obj->exports, offset[4] - offset[3]);
+    writer_bytes(&out, obj->slots, offset[5] - offset[4]);
+    writer_bytes(&out, obj->imports, offset[6] - offset[5]);
+    writer_bytes(&out, obj->strings, (size_t)obj->header.string_size);
+    writer_bytes(&out, padding, offset[7] - offset[6] - (size_t)obj->header.string_size);
+    writer_bytes(&out, obj->bytes, (size_t)obj->header.byte_size);
+    return writer_close(&out);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : mmap한 binary 오브젝트 파일의 테이블들을 objfile에 연결하는 함수이다.(복사하지 않음)
+* 매계 : 채울 objfile, 파일 내용, 파일 크기
+* 반환 : 정상종료 = 0, 형식이 잘못되었으면 < 0
+* 주의 : data는 objfile을 사용하는 동안 해제하면 안 된다.
+* -----------------------------------------------------------------------------------
+*/
+static int read_object_binary(objfile* obj, char* data, size_t size)
+{
+    size_t offset[8];
+
+    if (size < sizeof(objfile_header))
+        return -1;
+    memcpy(&obj->header, data, sizeof(objfile_header));
+    objfile_header* header = &obj->header;
+    if (memcmp(header->magic, OBJFILE_MAGIC, sizeof(OBJFILE_MAGIC)) != 0 || header->section_count < 0 || header->text_count < 0
+        || header->reloc_count < 0 || header->export_count < 0 || header->slot_count < 0 || header->import_count < 0
+        || header->string_size < 0 || header->byte_size < 0 || object_layout(header, offset) != size)
+        return -1;
+    obj->map = data;
+    obj->map_size = size;
+    obj->sections = (objfile_section*)(data + offset[0]);
+    obj->texts = (objfile_text*)(data + offset[1]);
+    obj->relocs = (objfile_reloc*)(data + offset[2]);
+    obj->exports = (objfile_export*)(data + offset[3]);
+    obj->slots = (int*)(data + offset[4]);
+    obj->imports = (objfile_import*)(data + offset[5]);
+    obj->strings = data + offset[6];
+    obj->bytes = (unsigned char*)(data + offset[7]);
+
+    //문자열이 영역 안에서 끝나고, 섹션과 레코드가 테이블 범위 안에 있는지 확인
+    //H, D, R 레코드의 이름은 텍스트 형식의 이름 칸에 들어가야 함
+    if (header->string_size > 0 && obj->strings[header->string_size - 1] != '\0')
+        return -1;
+    if (header->section_count > 0 && header->string_size == 0)
+        return -1;
+    for (int k = 0; k < header->section_count; k++) {
+        objfile_section* current = &obj->sections[k];
+        if (current->name < 0 || current->name >= header->string_size || strlen(obj->strings + current->name) > OBJECT_NAME_LENGTH
+            || current->export_start < 0 || current->export_count < 0 || current->export_start > header->export_count - current->export_count
+            || current->slot_start < 0 || current->slot_count < 0 || current->slot_start > header->slot_count - current->slot_count
+            || current->import_start < 0 || current->import_count < 0 || current->import_start > header->import_count - current->import_count
+            || current->text_start < 0 || current->text_count < 0 || current->text_start > header->text_count - current->text_count
+            || current->reloc_start < 0 || current->reloc_count < 0 || current->reloc_start > header->reloc_count - current->reloc_count)
+            return -1;
+        for (int i = 0; i < current->reloc_count; i++) {
+            if (obj->relocs[current->reloc_start + i].order < 0 || obj->relocs[current->reloc_start + i].order >= current->reloc_count)
+                return -1;
+        }
+        long long byteEnd = current->byte_start;
+        for (int i = 0; i < current->text_count; i++)
+            byteEnd += obj->texts[current->text_start + i].size;
+        if (current->byte_start < 0 || byteEnd > header->byte_size)
+            return -1;
+    }
+    for (int i = 0; i < header->export_count; i++) {
+        if (obj->exports[i].name < 0 || obj->exports[i].name >= header->string_size || strlen(obj->strings + obj->exports[i].name) > OBJECT_NAME_LENGTH)
+            return -1;
+    }
+    for (int i = 0; i < header->import_count; i++) {
+        if (obj->imports[i].name < 0 || obj->imports[i].name >= header->string_size || strlen(obj->strings + obj->imports[i].name) > OBJECT_NAME_LENGTH)
+            return -1;
+    }
+    for (int i = 0; i < header->reloc_count; i++) {
+        if (obj->relocs[i].name < 0 || obj->relocs[i].name >= header->string_size)
+            return -1;
+    }
+    return 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : objfile이 할당한 테이블을 해제하는 함수이다.(mmap한 파일을 가리키면 해제하지 않음)
+* 매계 : objfile
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void release_object_file(objfile* obj)
+{
+    if (obj->map == NULL) {
+        free(obj->sections);
+        free(obj->texts);
+        free(obj->relocs);
+        free(obj->exports);
+        free(obj->slots);
+        free(obj->imports);
+        free(obj->strings);
+        free(obj->bytes);
+        free(obj->string_hash.slot);
+    }
+    memset(obj, 0, sizeof(*obj));
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 패스1, 패스2, 오브젝트 프로그램 출력을 섹션 단위로 겹쳐서 수행하는 함수이다.
+*        토큰 분리 스레드가 섹션을 나누어 넘기면, 호출한 스레드가 주소와 심볼, 리터럴을
+*        계산한 뒤 패스2를 수행하고, 출력 스레드가 끝난 섹션의 레코드를 순서대로 출력한다.
+* 매계 : 오브젝트 프로그램 파일, 심볼 테이블 파일, 리터럴 테이블 파일,
+*        출력한 뒤에도 code_table에 코드를 모을지(false이면 출력한 섹션의 코드를 바로 해제)
+* 반환 : 정상종료 = 0, 에러발생 = < 0
+* 주의 : 결과 파일은 assem_pass1() -> assem_pass2() -> make_objectcode_output()과 같다.
+*        첫 섹션 이전에 심볼을 정의하는 라인이 있으면 섹션 번호가 H 레코드와 맞지 않으므로
+*        패스1만 겹쳐서 수행하고 패스2와 출력은 기존 방식으로 수행한다.
+* -----------------------------------------------------------------------------------
+*/
+static int assemble_pipelined(char *object_file, char *symtab_file, char *literal_file, bool keep_code)
+{
+    STAT_PHASE(PHASE_PASS1);
+    int lineCount = ctx->line_num;
+    RESERVE_TABLE(ctx->token_table, ctx->token_capacity, lineCount + 1);
+    token* tokens = (token*)arena_alloc(&ctx->asm_arena, sizeof(token) * (lineCount + 1));
+    for (int i = 0; i < lineCount; i++)
+        ctx->token_table[i] = &tokens[i];
+
+    pipeline pipe;
+    memset(&pipe, 0, sizeof(pipe));
+    pipe.owner = ctx;
+    pipe.object_file = object_file;
+    pipe.keep_code = keep_code;
+    pipe_init(&pipe.tokenized);
+    pipe_init(&pipe.assembled);
+
+    pthread_t tokenizer, output;
+    if (pthread_create(&tokenizer, NULL, pipeline_tokenizer, &pipe) != 0) {
+        pipe_destroy(&pipe.tokenized);
+        pipe_destroy(&pipe.assembled);
+        return -1;
+    }
+    if (pthread_create(&output, NULL, pipeline_writer, &pipe) != 0) {
+        //토큰 분리 스레드가 끝날 수 있도록 남은 섹션을 모두 꺼내서 버림
+        pass2* unit;
+        while ((unit = pipe_pop(&pipe.tokenized)) != NULL) {
+            intern_release(&unit->names);
+            free(unit);
+        }
+        pthread_join(tokenizer, NULL);
+        pipe_destroy(&pipe.tokenized);
+        pipe_destroy(&pipe.assembled);
+        return -1;
+    }
+
+    pass2** units = NULL;
+    int unitCnt = 0;
+    int unitCapacity = 0;
+    int ready = 0;          //아직 출력 스레드에 넘기지 않은 첫 섹션
+    bool serial = false;    //패스2와 출력을 기존 방식으로 수행해야 하면 true
+    int addr = 0;
+    pass2* unit;
+    while ((unit = pipe_pop(&pipe.tokenized)) != NULL) {
+        RESERVE_TABLE(units, unitCapacity, unitCnt + 1);
+        units[unitCnt++] = unit;
+        intern_merge(&unit->names, unit->line_start, unit->line_end);
+        //에러가 있으면 남은 섹션은 토큰 분리 스레드가 끝날 때까지 꺼내기만 함
+        if (pipe.assemble_error)
+            continue;
+
+        //리터럴 수집, 라인별 주소 계산, 테이블 채우기를 섹션의 라인 순서대로 수행
+        for (int i = unit->line_start; i < unit->line_end; i++) {
+            token* tok = ctx->token_table[i];
+            pool_literals(i);
+            if (tok->kind == OP_CSECT)
+                addr = 0;
+            tok->addr = addr;
+            addr += tok->size;
+            if (account_line(i) < 0) {
+                pipe.assemble_error = true;
+                break;
+            }
+        }
+        token* first = ctx->token_table[unit->line_start];
+        if (first->kind == OP_START || first->kind == OP_CSECT)
+            unit->section = ctx->section_index - 1;
+        else if (ctx->section_index > 0)
+            serial = true;
+
+        if (!serial && !pipe.assemble_error)
+            ready = pipeline_advance(&pipe, units, unitCnt, ready, false);
+    }
+    ctx->locctr = addr;
+    STAT_ADD(STAT_SECTIONS, ctx->section_index);
+
+    //패스1이 끝났으므로 남은 섹션은 모든 리터럴 주소가 정해진 상태로 처리
+    if (!pipe.error && !pipe.assemble_error && !serial)
+        pipeline_advance(&pipe, units, unitCnt, ready, true);
+    pipe_close(&pipe.assembled);
+    pthread_join(output, NULL);
+    pthread_join(tokenizer, NULL);
+    pipe_destroy(&pipe.tokenized);
+    pipe_destroy(&pipe.assembled);
+
+    int result = 0;
+    if (pipe.error || pipe.assemble_error || pipe.write_error) {
+        //기존 방식과 같이 에러가 있으면 오브젝트 프로그램을 남기지 않음
+        if (object_file != NULL)
+            unlink(object_file);
+        result = -1;
+    }
+    else {
+        make_symtab_output(symtab_file);
+        make_literaltab_output(literal_file);
+    }
+
+    //섹션의 코드를 소스 순서대로 code_table에 모으기(keep_code가 아니면 이미 해제됨)
+    RESERVE_TABLE(ctx->code_table, ctx->code_capacity, 1);
+    ctx->code_index = ctx->modify_index = 0;
+    ctx->locctr = 0;
+    for (int i = 0; i < unitCnt; i++) {
+        merge_section_codes(units[i]);
+        free(units[i]);
+    }
+    free(units);
+    end_code_table();
+
+    if (result == 0 && serial) {
+        if (assem_pass2() < 0)
+            return -1;
+        make_objectcode_output(object_file);
+    }
+    return result;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 패스1 계산이 끝난 섹션들의 패스2를 소스 순서대로 수행하고 출력 스레드에 넘기는 함수이다.
+* 매계 : 파이프라인, 섹션 배열, 섹션 개수, 아직 넘기지 않은 첫 섹션, 패스1이 끝났는지
+* 반환 : 아직 넘기지 않은 첫 섹션
+* 주의 : 섹션이 참조하는 리터럴의 주소가 모두 정해져야 패스2를 수행할 수 있다.
+*        LTORG/END에서 아직 없던 리터럴과 주소를 비교했어야 하는 경우(assem_section()은
+*        literal_index까지만 비교하므로) 그 리터럴의 주소가 정해질 때까지 넘기지 않으며,
+*        주소가 같으면 전체 리터럴로 패스2를 다시 수행한다.
+*        첫 섹션 이전 라인은 전체 심볼 테이블을 사용하므로 코드가 있으면 패스1이 끝난 뒤 수행한다.
+* -----------------------------------------------------------------------------------
+*/
+static int pipeline_advance(pipeline* pipe, pass2** units, int count, int ready, bool final)
+{
+    while (ready < count) {
+        pass2* unit = units[ready];
+        if (unit->literal_end < 0) {
+            if (!final && (ctx->literal_start < ctx->literal_index || (unit->section < 0 && pipe->defer_prologue)))
+                break;
+            unit->literal_cursor = (unit->section < 0) ? 0 : ctx->section_table[unit->section].literal_begin;
+            unit->literal_end = ctx->literal_index;
+            unit->boundary_check = 0;
+            unit->boundary_addr = -1;
+            assem_section(unit);
+            if (unit->error) {
+                pipe->assemble_error = true;
+                break;
+            }
+        }
+
+        bool retry = false;
+        if (unit->section < 0 && unit->code_index > 0 && !final) {
+            pipe->defer_prologue = true;
+            retry = true;
+        }
+        else if (unit->boundary_check > 0 && unit->literal_end < ctx->literal_index) {
+            //비교했어야 하는 리터럴의 주소가 아직 정해지지 않았으면 기다림
+            if (!final && unit->literal_end >= ctx->literal_start)
+                break;
+            int nextAddr = ctx->literal_table[unit->literal_end].addr;
+            retry = (unit->boundary_check > 1 || unit->boundary_addr == nextAddr);
+        }
+        if (retry) {
+            free(unit->code_table);
+            free(unit->modify_table);
+            unit->code_table = NULL;
+            unit->modify_table = NULL;
+            unit->code_index = unit->code_capacity = unit->modify_index = unit->modify_capacity = 0;
+            arena_release(&unit->pool);
+            unit->literal_end = -1;
+            if (!final)
+                break;
+            continue;
+        }
+
+        //출력 스레드가 심볼 테이블을 읽지 않도록 D 레코드 심볼의 주소를 미리 찾아둠
+        int defineCnt = 0;
+        for (int i = 0; i < unit->code_index; i++) {
+            if (unit->code_table[i].record == 'D')
+                defineCnt += unit->code_table[i].format;
+        }
+        if (defineCnt > 0) {
+            unit->define_addr = (int*)arena_alloc(&unit->pool, sizeof(int) * defineCnt);
+            defineCnt = 0;
+            for (int i = 0; i < unit->code_index; i++) {
+                if (unit->code_table[i].record != 'D')
+                    continue;
+                token* tok = ctx->token_table[unit->code_table[i].line_index];
+                for (int j = 0; j < unit->code_table[i].format; j++)
+                    unit->define_addr[defineCnt++] = search_name(tok->operand_id[j], unit->section);
+            }
+        }
+        pipe_push(&pipe->assembled, unit);
+        ready++;
+    }
+    return ready;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 파이프라인의 첫 단계로, 라인들을 순서대로 토큰으로 분리하여 START/CSECT마다
+*        섹션으로 나누어 넘기는 스레드 함수이다.
+* 매계 : pipeline
+* 반환 : NULL
+* -----------------------------------------------------------------------------------
+*/
+static void* pipeline_tokenizer(void* arg)
+{
+    pipeline* pipe = (pipeline*)arg;
+    ctx = pipe->owner;
+
+    pass2* unit = NULL;
+    for (int i = 0; i < ctx->line_num; i++) {
+        token* tok = ctx->token_table[i];
+        if (tokenize_source(i, tok) < 0) {
+            pipe->error = true;
+            break;
+        }
+        //START/CSECT를 만나면 앞 섹션을 넘기고 새 섹션 시작(첫 섹션 이전 라인도 하나의 섹션)
+        if (unit == NULL || tok->kind == OP_START || tok->kind == OP_CSECT) {
+            if (unit != NULL) {
+                unit->line_end = i;
+                pipe_push(&pipe->tokenized, unit);
+            }
+            unit = (pass2*)calloc(1, sizeof(pass2));
+            if (unit == NULL) {
+                pipe->error = true;
+                break;
+            }
+            unit->section = -1;
+            unit->line_start = i;
+            unit->literal_end = -1;
+            unit->boundary_addr = -1;
+        }
+        //섹션마다 따로 ID를 붙이고 패스1을 수행하는 스레드에서 ctx->names로 옮김
+        intern_token(tok, &unit->names);
+    }
+    if (unit != NULL && pipe->error) {
+        intern_release(&unit->names);
+        free(unit);
+    }
+    else if (unit != NULL) {
+        unit->line_end = ctx->line_num;
+        pipe_push(&pipe->tokenized, unit);
+    }
+    pipe_close(&pipe->tokenized);
+    return NULL;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 파이프라인의 마지막 단계로, 패스2가 끝난 섹션의 레코드를 순서대로 출력하는 스레드 함수이다.
+* 매계 : pipeline
+* 반환 : NULL
+* 주의 : 출력 파일을 열지 못해도 앞 단계가 멈추지 않도록 섹션은 끝까지 꺼낸다.
+* -----------------------------------------------------------------------------------
+*/
+static void* pipeline_writer(void* arg)
+{
+    pipeline* pipe = (pipeline*)arg;
+    ctx = pipe->owner;
+
+    writer out;
+    bool opened = (output_open(&out, pipe->object_file) == 0);
+    int subRoutine = -1;
+    pass2* unit;
+    while ((unit = pipe_pop(&pipe->assembled)) != NULL) {
+        if (opened)
+            write_section_records(&out, unit->code_table, unit->code_index, unit->modify_table, unit->modify_index, &subRoutine, unit->define_addr);
+        //출력한 코드가 더 필요하지 않으면 바로 해제
+        if (!pipe->keep_code) {
+            free(unit->code_table);
+            free(unit->modify_table);
+            unit->code_table = NULL;
+            unit->modify_table = NULL;
+            arena_release(&unit->pool);
+        }
+    }
+    //마지막 루틴의 E 레코드 출력
+    if (opened && subRoutine >= 0)
+        writer_string(&out, "E\n", 0);
+    if (!opened || output_close(&out, OUTPUT_OBJECT) < 0)
+        pipe->write_error = true;
+
+    //이 스레드에서 할당한 출력 버퍼 해제
+    free(writer_buffer);
+    writer_buffer = NULL;
+    return NULL;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 파이프라인의 단계 사이에서 사용하는 큐를 초기화하는 함수이다.
+* 매계 : 큐
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void pipe_init(pipe_queue* queue)
+{
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->changed, NULL);
+    queue->head = 0;
+    queue->count = 0;
+    queue->closed = false;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 큐에 섹션을 넣는 함수이다. 큐가 가득 차 있으면 빈 자리가 생길 때까지 기다린다.
+* 매계 : 큐, 넣을 섹션
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void pipe_push(pipe_queue* queue, pass2* unit)
+{
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == PIPE_QUEUE_SIZE)
+        pthread_cond_wait(&queue->changed, &queue->lock);
+    queue->item[(queue->head + queue->count) % PIPE_QUEUE_SIZE] = unit;
+    queue->count++;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 큐에서 섹션을 꺼내는 함수이다. 큐가 비어 있으면 섹션이 들어오거나 닫힐 때까지 기다린다.
+* 매계 : 큐
+* 반환 : 꺼낸 섹션, 큐가 닫히고 비어 있으면 NULL
+* -----------------------------------------------------------------------------------
+*/
+static pass2* pipe_pop(pipe_queue* queue)
+{
+    pass2* unit = NULL;
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0 && !queue->closed)
+        pthread_cond_wait(&queue->changed, &queue->lock);
+    if (queue->count > 0) {
+        unit = queue->item[queue->head];
+        queue->head = (queue->head + 1) % PIPE_QUEUE_SIZE;
+        queue->count--;
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return unit;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 더 넣을 섹션이 없음을 알리는 함수이다. 기다리던 쪽은 남은 섹션을 꺼낸 뒤 NULL을 받는다.
+* 매계 : 큐
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void pipe_close(pipe_queue* queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = true;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 큐의 mutex와 조건 변수를 해제하는 함수이다.
+* 매계 : 큐
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void pipe_destroy(pipe_queue* queue)
+{
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->changed);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 이름의 ID로 해시 테이블의 시작 슬롯을 정하기 위한 값을 만드는 함수이다.
+* 매계 : 이름의 ID
+* 반환 : 해시 값
+* -----------------------------------------------------------------------------------
+*/
+static unsigned int hash_id(int id)
+{
+    unsigned int value = (unsigned int)id * 2654435761u;
+    return value ^ (value >> 16);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 문자열 테이블에서 이름의 ID를 찾는 함수이다.
+* 매계 : 문자열 테이블, 이름, 이름의 해시 값(hash_string(이름, 0))
+* 반환 : 정상종료 = ID, 없으면 -1
+* -----------------------------------------------------------------------------------
+*/
+static int intern_lookup(intern_table* table, const char* str, unsigned int hash)
+{
+    if (table->slot == NULL)
+        return -1;
+    unsigned int i = hash & table->mask;
+    while (table->slot[i].id != 0) {
+        if (table->slot[i].hash == hash && strcmp(table->entry[table->slot[i].id - 1].name, str) == 0)
+            return table->slot[i].id - 1;
+        i = (i + 1) & table->mask;
+    }
+    return -1;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 이름의 ID를 찾는 함수이다. 처음 보는 이름이어도 추가하지 않는다.
+* 매계 : 문자열 테이블, 이름
+* 반환 : 정상종료 = ID, 없으면 -1
+* 주의 : 테이블을 바꾸지 않으므로 여러 스레드에서 동시에 찾을 수 있다.
+* -----------------------------------------------------------------------------------
+*/
+static int intern_find(intern_table* table, const char* str)
+{
+    return intern_lookup(table, str, hash_string(str, 0));
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 이름의 ID를 알려주는 함수이다. 처음 보는 이름이면 다음 ID를 붙여 추가한다.
+* 매계 : 문자열 테이블, 이름(테이블을 해제할 때까지 유지되어야 한다), 이름의 해시 값
+* 반환 : 이름의 ID
+* 주의 : sym_hash_insert()와 같이 슬롯의 절반 이상이 차면 두 배 크기로 다시 만든다.
+* -----------------------------------------------------------------------------------
+*/
+static int intern_add(intern_table* table, char* str, unsigned int hash)
+{
+    int id = intern_lookup(table, str, hash);
+    if (id >= 0)
+        return id;
+
+    if (table->slot == NULL || (unsigned int)(table->count + 1) * 2 > table->mask + 1) {
+        unsigned int size = (table->slot == NULL) ? 64 : (table->mask + 1) * 2;
+        free(table->slot);
+        table->slot = (struct intern_slot_unit*)calloc(size, sizeof(struct intern_slot_unit));
+        table->mask = size - 1;
+        //저장해 둔 해시 값으로 다시 배치
+        for (int k = 0; k < table->count; k++) {
+            unsigned int j = table->entry[k].hash & table->mask;
+            while (table->slot[j].id != 0)
+                j = (j + 1) & table->mask;
+            table->slot[j].id = k + 1;
+            table->slot[j].hash = table->entry[k].hash;
+        }
+    }
+
+    id = table->count++;
+    RESERVE_TABLE(table->entry, table->capacity, table->count);
+    table->entry[id].name = str;
+    table->entry[id].hash = hash;
+    unsigned int i = hash & table->mask;
+    while (table->slot[i].id != 0)
+        i = (i + 1) & table->mask;
+    table->slot[i].id = id + 1;
+    table->slot[i].hash = hash;
+    return id;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 이름의 ID를 알려주는 함수이다. 처음 보는 이름이면 추가한다.
+* 매계 : 문자열 테이블, 이름(테이블을 해제할 때까지 유지되어야 한다)
+* 반환 : 이름의 ID
+* -----------------------------------------------------------------------------------
+*/
+static int intern_name(intern_table* table, char* str)
+{
+    return intern_add(table, str, hash_string(str, 0));
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : intern_name()과 같지만 처음 보는 이름이면 어셈블리의 arena에 복사해서 추가하는 함수이다.
+* 매계 : 문자열 테이블, 이름(캐시 파일처럼 먼저 해제될 수 있는 문자열)
+* 반환 : 이름의 ID
+* -----------------------------------------------------------------------------------
+*/
+static int intern_copy(intern_table* table, const char* str)
+{
+    unsigned int hash = hash_string(str, 0);
+    int id = intern_lookup(table, str, hash);
+    if (id >= 0)
+        return id;
+    return intern_add(table, arena_strdup(&ctx->asm_arena, str), hash);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 토큰의 label과 operand를 이름 ID로 바꾸어 토큰에 저장하는 함수이다.
+* 매계 : 토큰, 이름을 추가할 문자열 테이블(NULL이면 ctx->names에서 찾기만 한다)
+* 반환 : 없음
+* 주의 : operand는 '@', '='를 포함한 문자열 그대로를 이름으로 사용한다.(search_symbol()과 같음)
+*        찾기만 하는 경우 ctx->names에 없는 이름은 -1이 되는데, 그런 이름은 심볼, 리터럴,
+*        EXTREF 변수 어디에도 없으므로 찾은 결과가 같다.
+* -----------------------------------------------------------------------------------
+*/
+static void intern_token(token* tok, intern_table* names)
+{
+    tok->label_id = -1;
+    if (tok->label[0] != '\0' && strcmp(tok->label, ".") != 0)
+        tok->label_id = (names != NULL) ? intern_name(names, tok->label) : intern_find(&ctx->names, tok->label);
+    for (int i = 0; i < MAX_OPERAND; i++) {
+        tok->operand_id[i] = -1;
+        if (tok->operand[i][0] != '\0' && tok->operand[i][0] != '#')
+            tok->operand_id[i] = (names != NULL) ? intern_name(names, tok->operand[i]) : intern_find(&ctx->names, tok->operand[i]);
+    }
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 구간에서 따로 만든 문자열 테이블의 이름들을 ctx->names로 옮기고, 구간 토큰들의
+*        ID를 ctx->names의 ID로 바꾸는 함수이다.
+* 매계 : 구간의 문자열 테이블(옮긴 뒤 해제한다), 구간의 첫 라인, 마지막 라인 + 1
+* 반환 : 없음
+* 주의 : 구간마다 이름의 해시 값을 한 번씩만 옮기므로 같은 이름이 여러 번 나와도 한 번만 찾는다.
+*        캐시에서 가져오는 라인(cached_token)은 건너뛴다.
+* -----------------------------------------------------------------------------------
+*/
+static void intern_merge(intern_table* local, int line_start, int line_end)
+{
+    int* map = (int*)malloc(sizeof(int) * (local->count + 1));
+    for (int i = 0; i < local->count; i++)
+        map[i] = intern_add(&ctx->names, local->entry[i].name, local->entry[i].hash);
+    for (int i = line_start; i < line_end; i++) {
+        token* tok = ctx->token_table[i];
+        if (tok == &cached_token)
+            continue;
+        if (tok->label_id >= 0)
+            tok->label_id = map[tok->label_id];
+        for (int j = 0; j < MAX_OPERAND; j++) {
+            if (tok->operand_id[j] >= 0)
+                tok->operand_id[j] = map[tok->operand_id[j]];
+        }
+    }
+    free(map);
+    intern_release(local);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 문자열 테이블을 해제하는 함수이다.(이름 문자열은 해제하지 않는다)
+* 매계 : 문자열 테이블
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void intern_release(intern_table* table)
+{
+    free(table->entry);
+    free(table->slot);
+    memset(table, 0, sizeof(intern_table));
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 문자열 테이블의 이름을 모두 지우되 배열은 남겨두는 함수이다.
+* 매계 : 문자열 테이블
+* 반환 : 없음
+* 주의 : 배열이 RECYCLE_TABLE_LIMIT보다 크면 intern_release()처럼 해제한다.
+* -----------------------------------------------------------------------------------
+*/
+static void intern_reset(intern_table* table)
+{
+    size_t slots = (table->slot != NULL) ? (size_t)table->mask + 1 : 0;
+    if (slots * sizeof(struct intern_slot_unit) > RECYCLE_TABLE_LIMIT) {
+        intern_release(table);
+        return;
+    }
+    RECYCLE_TABLE(table->entry, table->capacity, true);
+    if (table->slot != NULL)
+        memset(table->slot, 0, slots * sizeof(struct intern_slot_unit));
+    table->count = 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : EQU, WORD 피연산자의 수식을 후위 표기법(RPN)으로 바꾸는 함수이다.
+*        +, -, *, / 연산자와 괄호, 단항 +/-, 10진수 상수, symbol, 현재 주소('*')를 사용할 수 있다.
+* 매계 : 수식 문자열, 수식을 할당할 arena, 이름을 추가할 문자열 테이블(NULL이면 ctx->names에서 찾기만 한다)
+* 반환 : 만든 수식(문법 오류이면 항목 개수가 0)
+* 주의 : 상수끼리의 연산은 미리 계산하고, symbol과 '*'마다 결과에 더해지는 부호를 기록한다.
+*        names가 있으면 symbol 이름을 추가하므로 패스1처럼 한 스레드에서만 호출해야 한다.
+* -----------------------------------------------------------------------------------
+*/
+static expression* compile_expression(char* str, arena* pool, intern_table* names)
+{
+    expression* expr = (expression*)arena_alloc(pool, sizeof(expression));
+    //항목은 한 글자 이상에서 만들어지므로 글자 수보다 많을 수 없음
+    expr->item = (expr_item*)arena_alloc(pool, sizeof(expr_item) * (strlen(str) + 1));
+    expr->count = 0;
+    expr->symbol_count = 0;
+
+    expr_parser parser = { str, expr, pool, names, 0, false };
+    expr_parse_sum(&parser, 1);
+    if (parser.error || *parser.cursor != '\0' || expr->count == 0) {
+        expr->count = 0;
+        expr->symbol_count = 0;
+    }
+    return expr;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 두 값에 연산자를 적용하는 함수이다.
+* 매계 : 연산자 종류(EXPR_ADD ~ EXPR_DIV), 왼쪽 값, 오른쪽 값, 결과를 저장할 변수
+* 반환 : 계산할 수 있으면 true(0으로 나누면 false)
+* -----------------------------------------------------------------------------------
+*/
+static bool expr_apply(int kind, int left, int right, int* result)
+{
+    switch (kind) {
+    case EXPR_ADD:
+        *result = left + right;
+        return true;
+    case EXPR_SUB:
+        *result = left - right;
+        return true;
+    case EXPR_MUL:
+        *result = left * right;
+        return true;
+    default:
+        if (right == 0)
+            return false;
+        *result = left / right;
+        return true;
+    }
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 수식에 항목 하나를 추가하는 함수이다. 연산자의 피연산자가 모두 상수이면
+*        항목을 추가하는 대신 상수를 계산해 둔다.(constant folding)
+* 매계 : 수식을 읽는 상태, 항목 종류, 부호, 상수 값 또는 이름 ID, symbol 이름
+* 반환 : 없음
+* 주의 : 후위 표기법에서 마지막 두 항목이 상수이면 그 둘이 바로 다음 연산자의 피연산자이다.
+* -----------------------------------------------------------------------------------
+*/
+static void expr_emit(expr_parser* parser, int kind, int sign, int value, char* name)
+{
+    expression* expr = parser->expr;
+    expr_item* last = expr->item + expr->count - 1;
+    if (kind == EXPR_NEG && expr->count >= 1 && last->kind == EXPR_CONST) {
+        last->value = -last->value;
+        return;
+    }
+    if (kind >= EXPR_ADD && kind <= EXPR_DIV && expr->count >= 2 && last[-1].kind == EXPR_CONST && last->kind == EXPR_CONST
+        && expr_apply(kind, last[-1].value, last->value, &last[-1].value)) {
+        expr->count--;
+        parser->depth--;
+        return;
+    }
+
+    //상수, symbol, '*'는 스택에 값을 하나 쌓고, 이항 연산자는 하나를 줄임
+    if (kind <= EXPR_LOCCTR && ++parser->depth > MAX_EXPR_DEPTH)
+        parser->error = true;
+    else if (kind >= EXPR_ADD && kind <= EXPR_DIV)
+        parser->depth--;
+    expr_item* item = &expr->item[expr->count++];
+    item->kind = (char)kind;
+    item->sign = (char)sign;
+    item->value = value;
+    item->name = name;
+    if (kind == EXPR_SYMBOL)
+        expr->symbol_count++;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 수식의 덧셈, 뺄셈 단계(항 +/- 항 ...)를 읽는 함수이다.
+* 매계 : 수식을 읽는 상태, 이 단계가 결과에 더해지는 부호(+1, -1, 곱하기/나누기 안이면 0)
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void expr_parse_sum(expr_parser* parser, int sign)
+{
+    expr_parse_product(parser, sign);
+    while (!parser->error && (*parser->cursor == '+' || *parser->cursor == '-')) {
+        bool isAdd = (*parser->cursor++ == '+');
+        expr_parse_product(parser, isAdd ? sign : -sign);
+        expr_emit(parser, isAdd ? EXPR_ADD : EXPR_SUB, 0, 0, NULL);
+    }
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 수식의 곱셈, 나눗셈 단계(인수 * / 인수 ...)를 읽는 함수이다.
+* 매계 : 수식을 읽는 상태, 이 단계가 결과에 더해지는 부호
+* 반환 : 없음
+* 주의 : 곱하거나 나눈 symbol, '*'는 결과에 그대로 더해지지 않으므로 부호를 0으로 바꾼다.
+* -----------------------------------------------------------------------------------
+*/
+static void expr_parse_product(expr_parser* parser, int sign)
+{
+    int start = parser->expr->count;
+    bool scaled = false;
+    expr_parse_unary(parser, sign);
+    while (!parser->error && (*parser->cursor == '*' || *parser->cursor == '/')) {
+        bool isMul = (*parser->cursor++ == '*');
+        expr_parse_unary(parser, sign);
+        expr_emit(parser, isMul ? EXPR_MUL : EXPR_DIV, 0, 0, NULL);
+        scaled = true;
+    }
+    for (int i = start; scaled && i < parser->expr->count; i++)
+        parser->expr->item[i].sign = 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 수식의 단항 +/-, 괄호, 상수, symbol, 현재 주소('*')를 읽는 함수이다.
+* 매계 : 수식을 읽는 상태, 이 인수가 결과에 더해지는 부호
+* 반환 : 없음
+* 주의 : symbol 이름은 연산자나 괄호가 나올 때까지이며, 숫자로 시작할 수 없다.
+* -----------------------------------------------------------------------------------
+*/
+static void expr_parse_unary(expr_parser* parser, int sign)
+{
+    char first = *parser->cursor;
+    if (first == '+' || first == '-') {
+        parser->cursor++;
+        expr_parse_unary(parser, (first == '-') ? -sign : sign);
+        if (first == '-')
+            expr_emit(parser, EXPR_NEG, 0, 0, NULL);
+    }
+    else if (first == '(') {
+        parser->cursor++;
+        expr_parse_sum(parser, sign);
+        if (*parser->cursor != ')')
+            parser->error = true;
+        else
+            parser->cursor++;
+    }
+    else if (first == '*') {
+        parser->cursor++;
+        expr_emit(parser, EXPR_LOCCTR, sign, 0, NULL);
+    }
+    else if (first >= '0' && first <= '9') {
+        int value = 0;
+        while (*parser->cursor >= '0' && *parser->cursor <= '9')
+            value = value * 10 + (*parser->cursor++ - '0');
+        expr_emit(parser, EXPR_CONST, 0, value, NULL);
+    }
+    else {
+        size_t length = strcspn(parser->cursor, "+-*/()");
+        if (length == 0) {
+            parser->error = true;
+            return;
+        }
+        char* name = (char*)arena_alloc(parser->pool, length + 1);
+        memcpy(name, parser->cursor, length);
+        name[length] = '\0';
+        parser->cursor += length;
+        int id = (parser->names != NULL) ? intern_name(parser->names, name) : intern_find(&ctx->names, name);
+        expr_emit(parser, EXPR_SYMBOL, sign, id, name);
+    }
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 토큰의 첫 번째 피연산자 수식을 알려주는 함수이다. 처음 사용할 때 만들어 토큰에 저장한다.
+* 매계 : 토큰, 수식을 할당할 arena, 이름을 추가할 문자열 테이블(NULL이면 찾기만 한다)
+* 반환 : 수식(문법 오류이면 항목 개수가 0)
+* 주의 : 보통 패스1(account_line())에서 만들어지고, 패스2에서 다시 분리한 토큰이면
+*        섹션의 arena에 만든다.
+* -----------------------------------------------------------------------------------
+*/
+static expression* token_expression(token* tok, arena* pool, intern_table* names)
+{
+    if (tok->expr == NULL)
+        tok->expr = compile_expression(tok->operand[0], pool, names);
+    return tok->expr;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 후위 표기법 수식을 계산하고 결과의 종류를 알려주는 함수이다.
+* 매계 : 수식, symbol을 찾을 루틴의 번호(-1이면 전체), 현재 주소('*'의 값),
+*        찾지 못한 symbol의 값, 결과를 저장할 변수
+* 반환 : 결과의 종류(enum expr_class)
+* 주의 : 주소(상수가 아닌 symbol, '*')는 더하고 뺀 개수가 0이면 상수, 1이면 주소이다.
+*        찾지 못한 symbol이 결과에 더하거나 빼는 항으로만 쓰였으면 EXPR_EXTERNAL이다.
+* -----------------------------------------------------------------------------------
+*/
+static int evaluate_expression(expression* expr, int subRoutine, int locctr, int missing, int* value)
+{
+    int stack[MAX_EXPR_DEPTH];
+    int top = 0;
+    int relative = 0;           //결과에 더해진 주소의 개수(뺀 주소는 -1)
+    bool external = false;
+    bool invalid = (expr->count == 0);
+
+    for (int i = 0; i < expr->count; i++) {
+        expr_item* item = &expr->item[i];
+        switch (item->kind) {
+        case EXPR_CONST:
+            stack[top++] = item->value;
+            break;
+        case EXPR_LOCCTR:
+            stack[top++] = locctr;
+            relative += item->sign;
+            invalid |= (item->sign == 0);
+            break;
+        case EXPR_SYMBOL: {
+            int index = find_symbol(item->value, subRoutine);
+            if (index < 0) {
+                stack[top++] = missing;
+                external = true;
+                invalid |= (item->sign == 0);
+            }
+            else {
+                stack[top++] = ctx->sym_table[index].addr;
+                if (!ctx->sym_table[index].absolute) {
+                    relative += item->sign;
+                    invalid |= (item->sign == 0);
+                }
+            }
+            break;
+        }
+        case EXPR_NEG:
+            stack[top - 1] = -stack[top - 1];
+            break;
+        default:
+            top--;
+            if (!expr_apply(item->kind, stack[top - 1], stack[top], &stack[top - 1])) {
+                stack[top - 1] = 0;
+                invalid = true;
+            }
+            break;
+        }
+    }
+    *value = (top > 0) ? stack[top - 1] : 0;
+
+    if (invalid)
+        return EXPR_INVALID;
+    if (external)
+        return EXPR_EXTERNAL;
+    if (relative == 0)
+        return EXPR_ABSOLUTE;
+    return (relative == 1) ? EXPR_RELATIVE : EXPR_INVALID;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 토큰으로 분리하기 전의 소스 라인에서 operator 필드를 찾는 함수이다.
+*        tokenize_line()과 같은 방식으로 label을 건너뛴다.
+* 매계 : 소스 라인, operator의 길이를 저장할 변수
+* 반환 : operator의 시작 위치(라인을 바꾸지 않는다)
+* -----------------------------------------------------------------------------------
+*/
+static char* line_operator(char* line, size_t* length)
+{
+    //탭으로 시작하지 않으면 첫 필드는 label
+    if (line[0] != '\t')
+        line += strcspn(line, "\t");
+    line += strspn(line, "\t");
+    *length = strcspn(line, "\t");
+    return line;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : input_data의 한 라인을 토큰으로 만드는 함수이다. 매크로를 확장한 라인이면
+*        확장할 때 만든 토큰을 복사하고, 소스 라인이면 tokenize_line()으로 분리한다.
+* 매계 : input_data에서의 index, 정보를 저장할 토큰
+* 반환 : 정상종료 = 0 , 에러 < 0
+* -----------------------------------------------------------------------------------
+*/
+static int tokenize_source(int line, token* tok)
+{
+    if (line < ctx->macro_token_capacity && ctx->macro_token[line] != NULL) {
+        *tok = *ctx->macro_token[line];
+        return 0;
+    }
+    return tokenize_line(ctx->input_data[line], tok);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 소스 파일의 라인 하나를 매크로 처리기에 넘기는 함수이다. 매크로 정의 중이면
+*        본문으로 저장하고, 매크로 호출이면 확장한 라인을, 나머지는 라인 그대로 input_data에 저장한다.
+* 매계 : 매크로 처리기, 소스 라인(매크로 정의, 호출 라인은 필드를 나누면서 바뀐다)
+* 반환 : 정상종료 = 0 , 에러 < 0
+* 주의 : 소스 순서대로 호출해야 하며, 매크로는 호출하기 전에 정의되어 있어야 한다.
+* -----------------------------------------------------------------------------------
+*/
+static int macro_feed(macro_processor* mp, char* line)
+{
+    size_t length;
+    char* op = line_operator(line, &length);
+    //주석 라인은 operator가 없는 것으로 취급
+    if (line[0] == '.')
+        length = 0;
+
+    //정의 중이면 MEND까지 본문으로 저장
+    if (mp->defining != NULL)
+        return macro_add_line(mp, line, op, length);
+    if (length == 5 && strncmp(op, "MACRO", 5) == 0)
+        return macro_define(mp, line);
+    if (length == 4 && strncmp(op, "MEND", 4) == 0)
+        return -1;
+
+    int index = macro_lookup(mp, op, length);
+    //매크로 호출이 아니면 소스 라인 그대로 저장
+    if (index < 0) {
+        RESERVE_TABLE(ctx->input_data, ctx->input_capacity, ctx->line_num + 1);
+        ctx->input_data[ctx->line_num++] = line;
+        return 0;
+    }
+    char* field[4];
+    split_fields(line, field);
+    return macro_expand(mp, index, field[0], field[2], 0);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 이름으로 정의된 매크로를 찾는 함수이다.
+* 매계 : 매크로 처리기, 이름의 시작 위치, 이름의 길이('\0'으로 끝나지 않아도 된다)
+* 반환 : 정상종료 = 매크로의 index, 없으면 -1
+* 주의 : 같은 이름을 다시 정의하면 마지막으로 정의한 매크로를 찾는다.
+* -----------------------------------------------------------------------------------
+*/
+static int macro_lookup(macro_processor* mp, char* name, size_t length)
+{
+    char buffer[MAX_MACRO_NAME];
+    if (mp->names.count == 0 || length == 0 || length >= sizeof(buffer))
+        return -1;
+    memcpy(buffer, name, length);
+    buffer[length] = '\0';
+    int id = intern_find(&mp->names, buffer);
+    return (id >= 0) ? mp->named[id] : -1;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : "이름 MACRO 인자,..." 라인으로 새 매크로 정의를 시작하는 함수이다.
+*        인자는 위치 인자(&A)이거나 기본값이 있는 keyword 인자(&K=값)이다.
+* 매계 : 매크로 처리기, MACRO 라인
+* 반환 : 정상종료 = 0 , 에러 < 0
+* 주의 : 매크로 이름은 MEND를 만난 뒤(macro_finish())부터 찾을 수 있다.
+* -----------------------------------------------------------------------------------
+*/
+static int macro_define(macro_processor* mp, char* line)
+{
+    char* field[4];
+    split_fields(line, field);
+    if (field[0][0] == '\0' || strlen(field[0]) >= MAX_MACRO_NAME)
+        return -1;
+
+    RESERVE_TABLE(mp->def, mp->capacity, mp->count + 1);
+    macro_def* def = &mp->def[mp->count++];
+    def->name = field[0];
+
+    //인자 개수는 ',' 개수 + 1
+    char* params = field[2];
+    int count = (params[0] != '\0') ? 1 : 0;
+    for (char* c = params; *c != '\0'; c++)
+        count += (*c == ',');
+    def->param = (char**)arena_alloc(&ctx->asm_arena, sizeof(char*) * (count + 1));
+    def->value = (char**)arena_alloc(&ctx->asm_arena, sizeof(char*) * (count + 1));
+    for (int i = 0; i < count; i++) {
+        char* next = params + strcspn(params, ",");
+        *next = '\0';
+        //'&'와 이름이 있어야 함
+        if (params[0] != '&' || strspn(params + 1, macro_name_chars) == 0)
+            return -1;
+        def->param[i] = params + 1;
+        def->value[i] = strchr(params, '=');
+        if (def->value[i] != NULL)
+            *def->value[i]++ = '\0';
+        if (strspn(def->param[i], macro_name_chars) != strlen(def->param[i]))
+            return -1;
+        params = next + 1;
+    }
+    def->param_count = count;
+    mp->defining = def;
+    return 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 정의 중인 매크로에 본문 라인 하나를 추가하는 함수이다. 라인은 여기서 한 번만
+*        토큰으로 분리하고, 인자가 들어간 필드는 조각으로 나누어 둔다.
+* 매계 : 매크로 처리기, 본문 라인, line_operator()로 찾은 operator와 그 길이
+* 반환 : 정상종료 = 0 , 에러 < 0
+* 주의 : MEND이면 정의를 마친다. 매크로 안에서 다른 매크로를 정의할 수는 없다.
+*        operator가 명령어, 지시어가 아니면 매크로 호출로 저장하고 확장할 때 찾으므로
+*        뒤에서 정의하는 매크로나 자기 자신도 호출할 수 있다.
+* -----------------------------------------------------------------------------------
+*/
+static int macro_add_line(macro_processor* mp, char* line, char* op, size_t length)
+{
+    macro_def* def = mp->defining;
+    if (length == 4 && strncmp(op, "MEND", 4) == 0) {
+        macro_finish(mp);
+        return 0;
+    }
+    if (length == 5 && strncmp(op, "MACRO", 5) == 0)
+        return -1;
+
+    RESERVE_TABLE(def->line, def->line_capacity, def->line_count + 1);
+    macro_line* body = &def->line[def->line_count++];
+    body->source = arena_strdup(&ctx->asm_arena, line);
+    bool dynamic = (memchr(op, '&', length) != NULL);
+    body->call = dynamic ? -1 : macro_lookup(mp, op, length);
+
+    //매크로 호출이거나 operator가 인자이면 필드만 나누어 두고 확장할 때 처리
+    //(호출 인자는 MAX_OPERAND개보다 많을 수 있으므로 operand 필드 전체를 그대로 둔다)
+    if (body->call >= 0 || dynamic) {
+        char* field[4];
+        split_fields(line, field);
+        body->kind = (body->call >= 0) ? MACRO_LINE_CALL : MACRO_LINE_DYNAMIC;
+        for (int i = 0; i < 3; i++)
+            macro_compile_text(def, &body->field[i], field[i]);
+        return 0;
+    }
+
+    body->base = (token*)arena_alloc(&ctx->asm_arena, sizeof(token));
+    if (tokenize_line(line, body->base) < 0)
+        return -1;
+    body->kind = MACRO_LINE_FIXED;
+    //주석 라인은 그대로 사용
+    if (body->base->label[0] == '.')
+        return 0;
+    //명령어나 지시어가 아니면 뒤에서 정의하는 매크로(자기 자신 포함)일 수 있으므로 확장할 때 찾음
+    if (body->base->kind == OP_NONE && body->base->operator[0] != '\0') {
+        char* field[4];
+        split_fields(arena_strdup(&ctx->asm_arena, body->source), field);
+        body->kind = MACRO_LINE_CALL;
+        for (int i = 0; i < 3; i++)
+            macro_compile_text(def, &body->field[i], field[i]);
+        return 0;
+    }
+    macro_compile_text(def, &body->field[0], body->base->label);
+    for (int i = 0; i < MAX_OPERAND; i++)
+        macro_compile_text(def, &body->field[2 + i], body->base->operand[i]);
+    for (int i = 0; i < 2 + MAX_OPERAND; i++) {
+        if (body->field[i].piece_count > 0)
+            body->kind = MACRO_LINE_TOKEN;
+    }
+    return 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : MEND를 만나 매크로 정의를 마치고 이름으로 찾을 수 있게 등록하는 함수이다.
+* 매계 : 매크로 처리기
+* 반환 : 없음
+* 주의 : $ 라벨이 없고, operator가 인자인 라인이 없고, 호출하는 매크로도 모두 그러면
+*        같은 인자로 호출한 결과가 항상 같으므로 확장 결과를 다시 사용(pure)할 수 있다.
+* -----------------------------------------------------------------------------------
+*/
+static void macro_finish(macro_processor* mp)
+{
+    macro_def* def = mp->defining;
+    def->pure = !def->unique;
+    for (int i = 0; i < def->line_count; i++) {
+        if (def->line[i].kind == MACRO_LINE_DYNAMIC)
+            def->pure = false;
+        //확장할 때 찾는 매크로는 그때마다 다를 수 있음
+        else if (def->line[i].kind == MACRO_LINE_CALL && (def->line[i].call < 0 || !mp->def[def->line[i].call].pure))
+            def->pure = false;
+    }
+
+    int id = intern_name(&mp->names, def->name);
+    RESERVE_TABLE(mp->named, mp->named_capacity, id + 1);
+    mp->named[id] = (int)(def - mp->def);
+    mp->defining = NULL;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 매크로 본문의 필드를 그대로 복사할 부분과 바꿀 부분(&인자, $ 라벨)으로 나누는 함수이다.
+* 매계 : 정의 중인 매크로, 저장할 필드, 필드 문자열
+* 반환 : 없음
+* 주의 : 인자 이름이 아닌 &이름은 그대로 둔다. $는 필드의 처음(또는 #, @ 바로 뒤)에서
+*        이름 앞에 올 때만 라벨 번호로 바꾼다.(C'$' 같은 상수는 바꾸지 않는다)
+* -----------------------------------------------------------------------------------
+*/
+static void macro_compile_text(macro_def* def, macro_text* text, char* str)
+{
+    text->text = str;
+    text->piece = NULL;
+    text->piece_count = 0;
+    if (strpbrk(str, "&$") == NULL)
+        return;
+
+    //바꿀 부분마다 앞의 문자열과 함께 최대 두 조각이 생김
+    macro_piece* piece = (macro_piece*)arena_alloc(&ctx->asm_arena, sizeof(macro_piece) * (2 * strlen(str) + 1));
+    int count = 0;
+    bool replaced = false;
+    char* start = str;
+    char* cursor = str;
+    while (*cursor != '\0') {
+        int param = MACRO_PIECE_TEXT;
+        size_t skip = 1;
+        if (*cursor == '&') {
+            size_t length = strspn(cursor + 1, macro_name_chars);
+            for (int i = 0; i < def->param_count && length > 0; i++) {
+                if (strlen(def->param[i]) == length && strncmp(def->param[i], cursor + 1, length) == 0)
+                    param = i;
+            }
+            skip = 1 + length;
+        }
+        else if (*cursor == '$' && (cursor == str || (cursor == str + 1 && (str[0] == '#' || str[0] == '@')))
+            && strspn(cursor + 1, macro_name_chars) > 0) {
+            param = MACRO_PIECE_UNIQUE;
+            def->unique = true;
+        }
+        if (param == MACRO_PIECE_TEXT) {
+            cursor++;
+            continue;
+        }
+        if (cursor > start)
+            piece[count++] = (macro_piece){ start, (int)(cursor - start), MACRO_PIECE_TEXT };
+        piece[count++] = (macro_piece){ NULL, 0, param };
+        cursor += skip;
+        start = cursor;
+        replaced = true;
+    }
+    if (!replaced)
+        return;
+    if (cursor > start)
+        piece[count++] = (macro_piece){ start, (int)(cursor - start), MACRO_PIECE_TEXT };
+    text->piece = piece;
+    text->piece_count = count;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 매크로 본문의 필드에 인자 값과 라벨 번호를 넣은 문자열을 만드는 함수이다.
+* 매계 : 본문의 필드, 인자 값 배열, $ 대신 넣을 문자열("$AA" 등)
+* 반환 : 만든 문자열(인자가 없는 필드이면 본문의 문자열 그대로)
+* -----------------------------------------------------------------------------------
+*/
+static char* macro_substitute(macro_text* text, char** values, const char* serial)
+{
+    if (text->piece_count == 0)
+        return text->text;
+
+    size_t length = 0;
+    for (int i = 0; i < text->piece_count; i++) {
+        macro_piece* piece = &text->piece[i];
+        if (piece->param == MACRO_PIECE_TEXT)
+            length += (size_t)piece->length;
+        else
+            length += strlen((piece->param == MACRO_PIECE_UNIQUE) ? serial : values[piece->param]);
+    }
+    char* result = (char*)arena_alloc(&ctx->asm_arena, length + 1);
+    char* out = result;
+    for (int i = 0; i < text->piece_count; i++) {
+        macro_piece* piece = &text->piece[i];
+        const char* value = piece->text;
+        size_t size = (size_t)piece->length;
+        if (piece->param != MACRO_PIECE_TEXT) {
+            value = (piece->param == MACRO_PIECE_UNIQUE) ? serial : values[piece->param];
+            size = strlen(value);
+        }
+        memcpy(out, value, size);
+        out += size;
+    }
+    *out = '\0';
+    return result;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 매크로를 확장하여 본문 라인들을 input_data에 추가하는 함수이다. 본문 라인은
+*        정의할 때 만든 토큰에서 인자가 들어간 필드만 바꾸어 토큰을 바로 만든다.
+* 매계 : 매크로 처리기, 매크로의 index, 호출 라인의 label, 호출 인자(','로 구분, 나누면서 바뀐다),
+*        매크로 안에서 호출한 깊이
+* 반환 : 정상종료 = 0 , 에러 < 0(정의되지 않은 operator, 너무 깊은 호출이면 메시지를 출력)
+* 주의 : pure인 매크로를 같은 label, 인자로 다시 호출하면 앞에서 확장한 라인의 문자열과
+*        토큰을 그대로 다시 사용한다. 호출 라인의 label은 "label EQU *" 라인으로 정의한다.
+* -----------------------------------------------------------------------------------
+*/
+static int macro_expand(macro_processor* mp, int index, char* label, char* args, int depth)
+{
+    macro_def* def = &mp->def[index];
+    if (depth >= MAX_MACRO_DEPTH) {
+        printf("macro_expand: %s 매크로를 %d단계보다 깊게 호출했습니다.\n", def->name, MAX_MACRO_DEPTH);
+        return -1;
+    }
+
+    //같은 label, 인자로 확장한 적이 있으면 그 라인들을 다시 사용
+    int memo = -1;
+    if (def->pure) {
+        RESERVE_TABLE(mp->key, mp->key_capacity, (int)(strlen(label) + strlen(args) + 16));
+        sprintf(mp->key, "%d\t%s\t%s", index, label, args);
+        unsigned int hash = hash_string(mp->key, 0);
+        memo = intern_lookup(&mp->memo, mp->key, hash);
+        if (memo >= 0) {
+            int start = mp->memo_line[memo * 2];
+            int count = mp->memo_line[memo * 2 + 1];
+            for (int i = 0; i < count; i++)
+                macro_append(ctx->input_data[start + i], ctx->macro_token[start + i]);
+            return 0;
+        }
+        memo = intern_add(&mp->memo, arena_strdup(&ctx->asm_arena, mp->key), hash);
+    }
+
+    int start = ctx->line_num;
+    char** values = (char**)malloc(sizeof(char*) * (def->param_count + 1));
+    if (values == NULL || macro_bind(def, args, values) < 0) {
+        free(values);
+        return -1;
+    }
+    //$ 라벨에 붙일 확장 번호($AA, $AB, ..., $ZZ, $BAA, ...)
+    char serial[16] = "";
+    if (def->unique) {
+        char digits[12];
+        int number = mp->serial++;
+        int n = 0;
+        do {
+            digits[n++] = (char)('A' + number % 26);
+            number /= 26;
+        } while (number > 0 || n < 2);
+        serial[0] = '$';
+        for (int i = 0; i < n; i++)
+            serial[1 + i] = digits[n - 1 - i];
+        serial[n + 1] = '\0';
+    }
+
+    //호출 라인의 label은 확장한 첫 라인의 주소
+    if (label[0] != '\0') {
+        token* tok = (token*)arena_alloc(&ctx->asm_arena, sizeof(token));
+        memset(tok, 0, sizeof(token));
+        tok->label = label;
+        tok->operator = macro_equ;
+        tok->operand[0] = macro_locctr;
+        for (int i = 1; i < MAX_OPERAND; i++)
+            tok->operand[i] = empty_field;
+        tok->comment = empty_field;
+        classify_token(tok, -1);
+        macro_append(macro_render(tok), tok);
+    }
+
+    int result = 0;
+    for (int i = 0; i < def->line_count && result == 0; i++) {
+        macro_line* body = &def->line[i];
+        switch (body->kind) {
+        //인자가 없는 라인은 정의할 때의 문자열과 토큰을 그대로 사용
+        case MACRO_LINE_FIXED:
+            macro_append(body->source, body->base);
+            break;
+        //label, operand만 바꾸고 operand에 따라 달라지는 크기(RESW &N 등)는 다시 계산
+        case MACRO_LINE_TOKEN: {
+            token* tok = (token*)arena_alloc(&ctx->asm_arena, sizeof(token));
+            *tok = *body->base;
+            tok->label = macro_substitute(&body->field[0], values, serial);
+            for (int j = 0; j < MAX_OPERAND; j++)
+                tok->operand[j] = macro_substitute(&body->field[2 + j], values, serial);
+            if (body->field[2].piece_count > 0)
+                classify_token(tok, tok->opcode);
+            macro_append(macro_render(tok), tok);
+            break;
+        }
+        //다른 매크로 호출(인자 문자열은 나누면서 바뀌므로 본문의 문자열을 복사해서 넘김)
+        case MACRO_LINE_CALL: {
+            int call = body->call;
+            if (call < 0)
+                call = macro_lookup(mp, body->field[1].text, strlen(body->field[1].text));
+            if (call < 0) {
+                printf("macro_expand: %s 매크로의 %s는 정의되지 않은 매크로 또는 명령어입니다.\n", def->name, body->field[1].text);
+                result = -1;
+                break;
+            }
+            char* callArgs = macro_substitute(&body->field[2], values, serial);
+            if (body->field[2].piece_count == 0)
+                callArgs = arena_strdup(&ctx->asm_arena, callArgs);
+            result = macro_expand(mp, call, macro_substitute(&body->field[0], values, serial), callArgs, depth + 1);
+            break;
+        }
+        //operator가 인자이면 바꾼 뒤에 매크로 호출인지 확인하고, 아니면 토큰으로 분리
+        default: {
+            token raw;
+            memset(&raw, 0, sizeof(token));
+            raw.label = macro_substitute(&body->field[0], values, serial);
+            raw.operator = macro_substitute(&body->field[1], values, serial);
+            raw.operand[0] = macro_substitute(&body->field[2], values, serial);
+            raw.operand[1] = raw.operand[2] = raw.comment = empty_field;
+            int call = macro_lookup(mp, raw.operator, strlen(raw.operator));
+            if (call >= 0) {
+                result = macro_expand(mp, call, raw.label, arena_strdup(&ctx->asm_arena, raw.operand[0]), depth + 1);
+                break;
+            }
+            char* text = macro_render(&raw);
+            token* tok = (token*)arena_alloc(&ctx->asm_arena, sizeof(token));
+            result = tokenize_line(arena_strdup(&ctx->asm_arena, text), tok);
+            if (result == 0 && tok->kind == OP_NONE && tok->operator[0] != '\0') {
+                printf("macro_expand: %s 매크로의 %s는 정의되지 않은 매크로 또는 명령어입니다.\n", def->name, tok->operator);
+                result = -1;
+                break;
+            }
+            macro_append(text, tok);
+            break;
+        }
+        }
+    }
+    free(values);
+
+    if (memo >= 0) {
+        RESERVE_TABLE(mp->memo_line, mp->memo_capacity, memo * 2 + 2);
+        mp->memo_line[memo * 2] = start;
+        mp->memo_line[memo * 2 + 1] = ctx->line_num - start;
+    }
+    return result;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 호출 인자를 매크로의 인자에 대응시키는 함수이다. 이름=값(또는 &이름=값)이면
+*        keyword 인자로, 나머지는 순서대로 위치 인자로 넣는다.
+* 매계 : 매크로, 호출 인자(','를 '\0'으로 바꾼다), 인자 값을 저장할 배열
+* 반환 : 정상종료 = 0 , 인자가 너무 많으면 < 0
+* 주의 : 주지 않은 인자는 기본값(없으면 빈 문자열)이고, 빈 위치 인자(A,,C)는 건너뛴다.
+* -----------------------------------------------------------------------------------
+*/
+static int macro_bind(macro_def* def, char* args, char** values)
+{
+    for (int i = 0; i < def->param_count; i++)
+        values[i] = (def->value[i] != NULL) ? def->value[i] : empty_field;
+    if (args[0] == '\0')
+        return 0;
+
+    int position = 0;
+    char* arg = args;
+    while (1) {
+        char* next = arg + strcspn(arg, ",");
+        bool isLast = (*next == '\0');
+        *next = '\0';
+        //keyword 인자인지 확인(=C'EOF' 같은 리터럴은 이름이 없으므로 위치 인자)
+        char* name = (arg[0] == '&') ? arg + 1 : arg;
+        size_t length = strspn(name, macro_name_chars);
+        int param = -1;
+        for (int i = 0; i < def->param_count && length > 0 && name[length] == '='; i++) {
+            if (strlen(def->param[i]) == length && strncmp(def->param[i], name, length) == 0)
+                param = i;
+        }
+        if (param >= 0)
+            values[param] = name + length + 1;
+        else if (position >= def->param_count)
+            return -1;
+        else if (arg[0] != '\0')
+            values[position++] = arg;
+        else
+            position++;
+        if (isLast)
+            break;
+        arg = next + 1;
+    }
+    return 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 매크로를 확장한 라인 하나를 input_data에 추가하는 함수이다.
+* 매계 : 라인 문자열(캐시 key와 섹션 구분에 사용), 라인의 토큰
+* 반환 : 없음
+* 주의 : 문자열과 토큰은 다시 사용할 수 있으므로 읽기만 해야 한다.(tokenize_source()는 토큰을 복사한다)
+* -----------------------------------------------------------------------------------
+*/
+static void macro_append(char* text, token* tok)
+{
+    RESERVE_TABLE(ctx->input_data, ctx->input_capacity, ctx->line_num + 1);
+    RESERVE_TABLE(ctx->macro_token, ctx->macro_token_capacity, ctx->line_num + 1);
+    ctx->input_data[ctx->line_num] = text;
+    ctx->macro_token[ctx->line_num++] = tok;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 토큰의 label, operator, operand를 소스 라인 형식(탭, ',')의 문자열로 만드는 함수이다.
+* 매계 : 토큰
+* 반환 : 만든 문자열(어셈블리의 arena에 할당)
+* 주의 : comment는 넣지 않는다.
+* -----------------------------------------------------------------------------------
+*/
+static char* macro_render(token* tok)
+{
+    size_t length = strlen(tok->label) + strlen(tok->operator) + 3;
+    for (int i = 0; i < MAX_OPERAND; i++)
+        length += strlen(tok->operand[i]) + 1;
+    char* text = (char*)arena_alloc(&ctx->asm_arena, length);
+    char* out = text;
+    out = stpcpy(out, tok->label);
+    *out++ = '\t';
+    out = stpcpy(out, tok->operator);
+    for (int i = 0; i < MAX_OPERAND && tok->operand[i][0] != '\0'; i++) {
+        *out++ = (i == 0) ? '\t' : ',';
+        out = stpcpy(out, tok->operand[i]);
+    }
+    *out = '\0';
+    return text;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 매크로 처리기가 사용한 테이블을 해제하는 함수이다.
+* 매계 : 매크로 처리기
+* 반환 : 없음
+* 주의 : 본문의 문자열과 토큰, 확장한 라인은 어셈블리의 arena에 있으므로 남는다.
+* -----------------------------------------------------------------------------------
+*/
+static void macro_release(macro_processor* mp)
+{
+    for (int i = 0; i < mp->count; i++)
+        free(mp->def[i].line);
+    free(mp->def);
+    free(mp->named);
+    free(mp->memo_line);
+    free(mp->key);
+    intern_release(&mp->names);
+    intern_release(&mp->memo);
+    memset(mp, 0, sizeof(macro_processor));
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 어셈블 요청을 Unix 도메인 소켓으로 받는 서버 모드의 메인루틴이다.
+*        inst_table과 스레드를 한 번만 준비해 두고, 작업 스레드들이 연결을 나누어 받아
+*        여러 클라이언트의 요청을 동시에 처리한다. SIGINT, SIGTERM을 받거나 클라이언트가
+*        SHUTDOWN을 요청하면 처리 중인 요청의 응답을 보낸 뒤 종료한다.
+* 매계 : 소켓 경로
+* 반환 : 정상종료 = 0, 소켓을 열지 못하면 < 0
+* 주의 : 요청 형식은 server_request()를 따른다. inst_table은 미리 읽어두어야 한다.
+*        소켓 파일은 만든 사용자만 연결할 수 있도록 0600으로 만들고, 같은 경로에 남아있는
+*        소켓 파일은 지우고 다시 만든다.(소켓이 아닌 파일이 있으면 실패)
+* -----------------------------------------------------------------------------------
+*/
+static int server_main(char* path)
+{
+    struct sockaddr_un address;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        printf("server_main: 소켓 경로 %s가 너무 깁니다.\n", path);
+        return -1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    struct stat info;
+    if (lstat(path, &info) == 0) {
+        if (!S_ISSOCK(info.st_mode)) {
+            printf("server_main: %s는 소켓 파일이 아닙니다.\n", path);
+            return -1;
+        }
+        unlink(path);
+    }
+    server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    //다른 사용자가 연결하여 서버 권한으로 파일을 읽지 못하도록 소켓 파일을 0600으로 만듦
+    //(bind()하는 동안 umask를 077로 두어 chmod() 전에도 다른 사용자는 연결할 수 없음)
+    mode_t mask = umask(077);
+    int bound = (server_fd >= 0) ? bind(server_fd, (struct sockaddr*)&address, sizeof(address)) : -1;
+    umask(mask);
+    if (bound < 0 || chmod(path, 0600) < 0 || listen(server_fd, SOMAXCONN) < 0) {
+        printf("server_main: %s 소켓을 열 수 없습니다.\n", path);
+        if (server_fd >= 0)
+            close(server_fd);
+        if (bound == 0)
+            unlink(path);
+        server_fd = -1;
+        return -1;
+    }
+    //클라이언트가 응답을 받기 전에 끊어도 서버가 종료되지 않도록 함
+    signal(SIGPIPE, SIG_IGN);
+    //종료 시그널은 작업 스레드가 아닌 이 스레드의 sigwait()로 받음(작업 스레드는 마스크를 물려받음)
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, NULL);
+
+    int workers = get_thread_count() * 2;
+    if (workers < SERVER_MIN_WORKERS)
+        workers = SERVER_MIN_WORKERS;
+    if (workers > MAX_THREADS)
+        workers = MAX_THREADS;
+    server_conns = (server_conn**)calloc((size_t)workers, sizeof(server_conn*));
+    server_workers = (server_conns != NULL) ? workers : 0;
+    pthread_t threads[MAX_THREADS];
+    int started = 0;
+    for (int i = 0; i < workers && server_conns != NULL; i++) {
+        if (pthread_create(&threads[started], NULL, server_worker, (void*)(intptr_t)started) == 0)
+            started++;
+    }
+    if (started == 0) {
+        printf("server_main: 작업 스레드를 만들 수 없습니다.\n");
+        close(server_fd);
+        unlink(path);
+        server_fd = -1;
+        free(server_conns);
+        server_conns = NULL;
+        server_workers = 0;
+        pthread_sigmask(SIG_UNBLOCK, &stopSignals, NULL);
+        return -1;
+    }
+    printf("server_main: %s에서 요청을 기다립니다.(작업 스레드 %d개)\n", path, started);
+    fflush(stdout);
+
+    int signalNumber;
+    while (sigwait(&stopSignals, &signalNumber) != 0)
+        ;
+    server_stop();
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    close(server_fd);
+    unlink(path);
+    server_fd = -1;
+    free(server_conns);
+    server_conns = NULL;
+    server_workers = 0;
+    pthread_sigmask(SIG_UNBLOCK, &stopSignals, NULL);
+    printf("server_main: %s 서버를 종료합니다.\n", path);
+    return 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 서버 모드의 작업 스레드들에게 종료를 알리는 함수이다.
+*        accept()에서 기다리는 스레드와 다음 요청을 기다리는 연결은 바로 깨우고,
+*        요청을 처리 중인 연결은 응답을 보낸 뒤 작업 스레드가 스스로 끊는다.
+* 매계 : 없음
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void server_stop(void)
+{
+    pthread_mutex_lock(&server_lock);
+    server_stopping = true;
+    shutdown(server_fd, SHUT_RDWR);
+    for (int i = 0; i < server_workers; i++) {
+        if (server_conns[i] != NULL && !server_conns[i]->busy)
+            shutdown(server_conns[i]->fd, SHUT_RD);
+    }
+    pthread_mutex_unlock(&server_lock);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 서버 모드의 작업 스레드로, 연결을 하나씩 받아 끊어질 때까지 요청을 처리한다.
+* 매계 : 작업 스레드 번호(server_conns의 index)
+* 반환 : 항상 NULL
+* 주의 : 클라이언트끼리 이미 동시에 처리되므로 요청 안의 병렬 작업(run_parallel())은
+*        스레드 풀을 기다리지 않고 이 스레드에서 차례로 수행한다.
+*        어셈블리 상태(assembly)와 출력 버퍼(writer_buffer)는 스레드마다 하나를 두고
+*        계속 사용하며, 테이블과 arena 블록은 요청이 끝나도 남겨둔다(keep_tables).
+* -----------------------------------------------------------------------------------
+*/
+static void* server_worker(void* arg)
+{
+    int self = (int)(intptr_t)arg;
+    assembly context;
+    server_conn conn;
+
+    memset(&context, 0, sizeof(context));
+    context.keep_tables = true;
+    ctx = &context;
+    in_pool_job = true;
+    while (1) {
+        int fd = accept(server_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            break;
+        }
+        conn.fd = fd;
+        conn.start = conn.end = 0;
+        conn.busy = false;
+        //종료 중이면 요청을 받지 않고, 아니면 server_stop()이 깨울 수 있도록 연결을 등록
+        pthread_mutex_lock(&server_lock);
+        bool stopping = server_stopping;
+        if (!stopping)
+            server_conns[self] = &conn;
+        pthread_mutex_unlock(&server_lock);
+        if (!stopping)
+            server_client(&conn);
+        pthread_mutex_lock(&server_lock);
+        server_conns[self] = NULL;
+        stopping = server_stopping;
+        pthread_mutex_unlock(&server_lock);
+        close(fd);
+        if (stopping)
+            break;
+    }
+
+    //요청마다 남겨둔 테이블, arena와 출력 버퍼 해제
+    context.keep_tables = false;
+    release_my_assembler();
+    ctx = &main_assembly;
+    free(writer_buffer);
+    writer_buffer = NULL;
+    return NULL;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 클라이언트 연결 하나에서 요청을 한 줄씩 읽어 처리하는 함수이다.
+* 매계 : 클라이언트 연결
+* 반환 : 없음(클라이언트가 연결을 끊거나 응답을 보내지 못하거나 서버가 종료 중이면 끝난다)
+* -----------------------------------------------------------------------------------
+*/
+static void server_client(server_conn* conn)
+{
+    char line[MAX_LINE_LENGTH];
+    while (server_read_line(conn, line, sizeof(line)) == 0) {
+        //빈 줄(SOURCE 뒤의 줄바꿈 등)은 무시
+        if (line[0] == '\0')
+            continue;
+        //처리 중인 요청은 server_stop()이 끊지 않도록 표시
+        pthread_mutex_lock(&server_lock);
+        bool stopping = server_stopping;
+        conn->busy = !stopping;
+        pthread_mutex_unlock(&server_lock);
+        if (stopping)
+            break;
+        int result = server_request(conn, line);
+        pthread_mutex_lock(&server_lock);
+        conn->busy = false;
+        stopping = server_stopping;
+        pthread_mutex_unlock(&server_lock);
+        if (result < 0 || stopping)
+            break;
+    }
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 요청 하나를 어셈블하고 결과를 응답하는 함수이다.
+*        요청 : "ASSEMBLE <경로>"  서버가 읽을 수 있는 소스 파일(상대 경로는 서버의 작업 디렉터리 기준)
+*               "SOURCE <크기>"    다음 <크기> byte가 소스 코드(SERVER_MAX_SOURCE byte 이하)
+*               "SHUTDOWN"         응답을 보낸 뒤 서버를 종료(SIGTERM과 같음)
+*        응답 : "OK <오브젝트 크기> <심볼 크기> <리터럴 크기>" 한 줄 뒤에 세 결과를 순서대로 이어 보내고,
+*               실패하면 "ERROR <이유>" 한 줄을 보낸다.(SHUTDOWN은 "OK 0 0 0")
+* 매계 : 클라이언트 연결, 요청 라인
+* 반환 : 정상종료 = 0, 연결을 더 사용할 수 없으면 < 0
+* 주의 : 작업 스레드의 ctx를 사용하고(release_my_assembler()가 테이블을 비워 남겨둠),
+*        결과 파일 대신 ctx->capture에 모은 내용을 보낸다.
+*        SOURCE의 크기가 잘못되었거나 너무 크면 소스를 읽지 않으므로 ERROR를 보내고 연결을 끊는다.
+* -----------------------------------------------------------------------------------
+*/
+static int server_request(server_conn* conn, char* line)
+{
+    writer capture[OUTPUT_COUNT];
+    const char* error = NULL;
+    bool disconnect = false;
+    bool stop = false;
+
+    memset(capture, 0, sizeof(capture));
+    ctx->capture = capture;
+    if (strncmp(line, "ASSEMBLE ", 9) == 0) {
+        if (assemble_file(line + 9, NULL, NULL, NULL, NULL) < 0)
+            error = "ERROR assemble failed\n";
+    }
+    else if (strncmp(line, "SOURCE ", 7) == 0) {
+        char* end;
+        long size = strtol(line + 7, &end, 10);
+        char* text = NULL;
+        if (end == line + 7 || *end != '\0' || size < 0)
+            error = "ERROR bad source size\n";
+        else if (size > SERVER_MAX_SOURCE)
+            error = "ERROR source too large\n";
+        else if ((text = (char*)malloc((size_t)size + 1)) == NULL)
+            error = "ERROR out of memory\n";
+        if (text == NULL)
+            disconnect = true;
+        //소스를 다 받지 못하면 다음 요청의 시작을 알 수 없으므로 연결을 끊음
+        else if (server_read(conn, text, (size_t)size) < 0) {
+            free(text);
+            ctx->capture = NULL;
+            return -1;
+        }
+        //소스는 어셈블리가 끝나면 release_my_assembler()에서 해제
+        else if (init_input_text(text, (size_t)size) < 0) {
+            release_my_assembler();
+            error = "ERROR assemble failed\n";
+        }
+        else if (assemble_input(NULL, NULL, NULL, NULL) < 0)
+            error = "ERROR assemble failed\n";
+    }
+    else if (strcmp(line, "SHUTDOWN") == 0)
+        stop = true;
+    else
+        error = "ERROR unknown request\n";
+    ctx->capture = NULL;
+
+    //응답은 결과를 모두 모은 뒤 같은 출력 버퍼로 보냄(표준출력 대신 소켓으로)
+    writer out;
+    writer_open(&out, NULL);
+    out.fd = conn->fd;
+    if (error != NULL)
+        writer_string(&out, error, 0);
+    else {
+        char header[64];
+        sprintf(header, "OK %zu %zu %zu\n", capture[OUTPUT_OBJECT].memory_size, capture[OUTPUT_SYMTAB].memory_size, capture[OUTPUT_LITERAL].memory_size);
+        writer_string(&out, header, 0);
+        for (int i = 0; i < OUTPUT_COUNT; i++) {
+            if (capture[i].memory_size > 0)
+                writer_bytes(&out, capture[i].memory, capture[i].memory_size);
+        }
+    }
+    writer_flush(&out);
+    for (int i = 0; i < OUTPUT_COUNT; i++)
+        free(capture[i].memory);
+    //server_main()의 sigwait()가 받아 server_stop()을 호출함
+    if (stop)
+        kill(getpid(), SIGTERM);
+    return (out.error || disconnect) ? -1 : 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 클라이언트 연결의 버퍼를 다시 채우는 함수이다.
+* 매계 : 클라이언트 연결
+* 반환 : 읽은 byte 수(연결이 끊어졌으면 0, 에러 < 0)
+* -----------------------------------------------------------------------------------
+*/
+static ssize_t server_fill(server_conn* conn)
+{
+    ssize_t readSize;
+    do {
+        readSize = read(conn->fd, conn->buffer, SERVER_BUFFER_SIZE);
+    } while (readSize < 0 && errno == EINTR);
+    conn->start = 0;
+    conn->end = (readSize > 0) ? (size_t)readSize : 0;
+    return readSize;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 클라이언트 연결에서 요청 라인 하나를 읽는 함수이다.
+* 매계 : 클라이언트 연결, 라인을 저장할 버퍼, 버퍼의 크기
+* 반환 : 정상종료 = 0, 연결이 끊어졌거나 라인이 너무 길면 < 0
+* 주의 : 줄바꿈 문자(\n, \r\n)는 저장하지 않는다.
+* -----------------------------------------------------------------------------------
+*/
+static int server_read_line(server_conn* conn, char* line, size_t size)
+{
+    size_t length = 0;
+    while (1) {
+        if (conn->start == conn->end && server_fill(conn) <= 0)
+            return -1;
+        char c = conn->buffer[conn->start++];
+        if (c == '\n')
+            break;
+        if (length + 1 >= size)
+            return -1;
+        line[length++] = c;
+    }
+    if (length > 0 && line[length - 1] == '\r')
+        length--;
+    line[length] = '\0';
+    return 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 클라이언트 연결에서 정해진 byte 수만큼 읽는 함수이다.
+* 매계 : 클라이언트 연결, 저장할 위치, 읽을 byte 수
+* 반환 : 정상종료 = 0, 다 읽기 전에 연결이 끊어지면 < 0
+* 주의 : 버퍼에 남은 byte를 먼저 옮기고, 나머지는 저장할 위치로 바로 읽는다.
+* -----------------------------------------------------------------------------------
+*/
+static int server_read(server_conn* conn, char* data, size_t size)
+{
+    size_t done = conn->end - conn->start;
+    if (done > size)
+        done = size;
+    memcpy(data, conn->buffer + conn->start, done);
+    conn->start += done;
+    while (done < size) {
+        ssize_t readSize = read(conn->fd, data + done, size - done);
+        if (readSize < 0 && errno == EINTR)
+            continue;
+        if (readSize <= 0)
+            return -1;
+        done += (size_t)readSize;
+    }
+    return 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 소스 파일을 메모리에 올리지 않고 out-of-core 모드로 어셈블하는 함수이다.
+*        패스1은 소스를 라인 단위로 읽으면서 심볼, 리터럴 테이블을 채우고 패스2에 필요한
+*        라인만 중간 파일에 쓰며, 패스2는 중간 파일을 다시 읽으면서 레코드를 바로 출력한다.
+*        메모리에는 심볼, 리터럴, 섹션 테이블과 이름만 남으므로 사용량이 소스 길이가 아닌
+*        심볼 수에 비례한다.
+* 매계 : 소스 파일, 오브젝트 프로그램 파일, 심볼 테이블 파일, 리터럴 테이블 파일
+* 반환 : 정상종료 = 0, 에러 < 0, 소스에 매크로가 있어 기존 방식으로 처리해야 하면 1
+* 주의 : 결과 파일은 assem_pass1() -> assem_pass2() -> make_objectcode_output()과 같다.
+*        매크로 정의는 확장할 때까지 본문을 갖고 있어야 하므로 MACRO/MEND를 만나면 처음부터
+*        기존 방식으로 다시 어셈블한다. 중간 파일과 섹션별 임시 파일은 TMPDIR(없으면 /tmp)에 만든다.
+*        끝나면 release_my_assembler()로 어셈블리의 상태를 해제한다.
+* -----------------------------------------------------------------------------------
+*/
+static int assemble_streamed(char* source, char* object_file, char* symtab_file, char* literal_file)
+{
+    stream_input in;
+    STAT_SOURCE(source);
+    memset(&in, 0, sizeof(in));
+    if ((in.fd = open(source, O_RDONLY)) < 0) {
+        release_my_assembler();
+        return -1;
+    }
+    int fd = stream_temp_file();
+    FILE* temp = (fd >= 0) ? fdopen(fd, "w+b") : NULL;
+    if (temp == NULL) {
+        if (fd >= 0)
+            close(fd);
+        close(in.fd);
+        release_my_assembler();
+        return -1;
+    }
+
+    int result = stream_pass1(&in, temp);
+    close(in.fd);
+    free(in.buffer);
+    if (result == 0) {
+        make_symtab_output(symtab_file);
+        make_literaltab_output(literal_file);
+        if (fflush(temp) != 0 || fseek(temp, 0, SEEK_SET) != 0 || stream_pass2(temp, object_file) < 0)
+            result = -1;
+    }
+    fclose(temp);
+    release_my_assembler();
+    return result;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : out-of-core 모드의 패스1로, 소스를 한 라인씩 읽어 토큰으로 나누고 주소를 계산하여
+*        섹션, 심볼, 리터럴 테이블을 채우는 함수이다. 패스2에 필요한 라인은 중간 파일에 쓴다.
+* 매계 : 소스 파일 입력, 중간 파일
+* 반환 : 정상종료 = 0, 에러 < 0, 매크로가 있으면 1
+* 주의 : token_table의 STREAM_LINE_SLOT 한 칸만 사용하므로 리터럴의 pool_line과 섹션의
+*        시작 라인은 실제 라인 번호가 아니다. 섹션의 시작 라인은 패스2에서 섹션을 나눌 때
+*        사용하므로 실제 라인 번호로 고친다.
+* -----------------------------------------------------------------------------------
+*/
+static int stream_pass1(stream_input* in, FILE* temp)
+{
+    STAT_PHASE(PHASE_PASS1);
+    token tok;
+    arena scratch;      //EQU, WORD 수식(그 라인에서만 사용)
+    int lineNum = 0;
+    int addr = 0;
+    char* line;
+
+    memset(&scratch, 0, sizeof(scratch));
+    RESERVE_TABLE(ctx->token_table, ctx->token_capacity, STREAM_SLOT_COUNT);
+    ctx->token_table[STREAM_LINE_SLOT] = &tok;
+    while ((line = stream_read_line(in)) != NULL) {
+        size_t length;
+        char* op = line_operator(line, &length);
+        if (line[0] != '.' && ((length == 5 && strncmp(op, "MACRO", 5) == 0) || (length == 4 && strncmp(op, "MEND", 4) == 0))) {
+            arena_release(&scratch);
+            return 1;
+        }
+        if (tokenize_line(line, &tok) < 0) {
+            arena_release(&scratch);
+            return -1;
+        }
+        stream_intern(&tok);
+        if (tok.kind == OP_EQU || tok.kind == OP_WORD)
+            tok.expr = compile_expression(tok.operand[0], &scratch, NULL);
+
+        pool_literals(STREAM_LINE_SLOT);
+        if (tok.kind == OP_CSECT)
+            addr = 0;
+        tok.addr = addr;
+        addr += tok.size;
+        if (account_line(STREAM_LINE_SLOT) < 0) {
+            arena_release(&scratch);
+            return -1;
+        }
+        if (tok.kind == OP_START || tok.kind == OP_CSECT)
+            ctx->section_table[ctx->section_index - 1].line_start = lineNum;
+        if (stream_keeps_line(tok.kind))
+            stream_write_record(temp, &tok, lineNum);
+
+        lineNum++;
+        if (scratch.total > ARENA_BLOCK_SIZE)
+            arena_release(&scratch);
+    }
+    arena_release(&scratch);
+    if (in->error || ferror(temp))
+        return -1;
+
+    ctx->line_num = lineNum;
+    ctx->locctr = addr;
+    STAT_ADD(STAT_LINES, lineNum);
+    STAT_ADD(STAT_SECTIONS, ctx->section_index);
+    return 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : out-of-core 모드에서 토큰의 label과 operand를 이름 ID로 바꾸는 함수이다.
+*        intern_token()과 같지만, 처음 본 이름은 다음 라인을 읽으면 사라지는 입력 버퍼를
+*        가리키므로 어셈블리의 arena로 복사한다.
+* 매계 : 토큰
+* 반환 : 없음
+* 주의 : 크기나 값, 수식만 쓰는 지시어(BYTE, WORD, RESW, RESB, EQU)의 operand는 이름으로
+*        찾지 않으므로 리터럴이 아니면 추가하지 않는다.(상수마다 이름이 늘어나지 않도록)
+* -----------------------------------------------------------------------------------
+*/
+static void stream_intern(token* tok)
+{
+    int known = ctx->names.count;
+    bool isData = (tok->kind == OP_BYTE || tok->kind == OP_WORD || tok->kind == OP_RESW || tok->kind == OP_RESB || tok->kind == OP_EQU);
+    if (isData && tok->operand[0][0] != '=') {
+        intern_token(tok, NULL);
+        if (tok->label[0] != '\0' && strcmp(tok->label, ".") != 0)
+            tok->label_id = intern_name(&ctx->names, tok->label);
+    }
+    else
+        intern_token(tok, &ctx->names);
+    for (int id = known; id < ctx->names.count; id++)
+        ctx->names.entry[id].name = arena_strdup(&ctx->asm_arena, ctx->names.entry[id].name);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 라인을 중간 파일에 저장해야 하는지 알려주는 함수이다.
+* 매계 : operator의 종류
+* 반환 : 패스2(encode_line())에서 코드를 만들거나 주소를 바꾸는 라인이면 true
+* -----------------------------------------------------------------------------------
+*/
+static bool stream_keeps_line(int kind)
+{
+    switch (kind) {
+    case OP_NONE:
+    case OP_EQU:
+        return false;
+    default:
+        return true;
+    }
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 토큰 하나를 중간 파일에 레코드로 쓰는 함수이다.
+* 매계 : 중간 파일, 토큰, 소스에서의 라인 번호
+* 반환 : 없음(에러는 패스1이 끝난 뒤 ferror()로 확인)
+* -----------------------------------------------------------------------------------
+*/
+static void stream_write_record(FILE* temp, token* tok, int line)
+{
+    stream_record record;
+    //label은 H 레코드와 섹션 이름으로만 사용
+    char* label = (tok->kind == OP_START || tok->kind == OP_CSECT) ? tok->label : empty_field;
+    char* text[2 + MAX_OPERAND] = { label, tok->operator };
+    size_t length[2 + MAX_OPERAND];
+
+    memset(&record, 0, sizeof(record));
+    record.line = line;
+    record.opcode = tok->opcode;
+    record.kind = tok->kind;
+    record.format = tok->format;
+    for (int i = 0; i < MAX_OPERAND; i++) {
+        record.operand_id[i] = tok->operand_id[i];
+        text[2 + i] = tok->operand[i];
+    }
+    for (int i = 0; i < 2 + MAX_OPERAND; i++) {
+        length[i] = strlen(text[i]) + 1;
+        record.text_size += (int)length[i];
+    }
+    fwrite(&record, sizeof(record), 1, temp);
+    for (int i = 0; i < 2 + MAX_OPERAND; i++)
+        fwrite(text[i], 1, length[i], temp);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : out-of-core 모드의 패스2로, 중간 파일의 라인을 다시 읽으면서 기계어 코드를 만들고
+*        오브젝트 프로그램을 출력하는 함수이다.
+* 매계 : 패스1이 쓴 중간 파일(처음 위치), 오브젝트 프로그램 파일
+* 반환 : 정상종료 = 0, 에러 < 0
+* 주의 : 섹션은 assem_pass2()와 같이 섹션 테이블의 시작 라인으로 나눈다.
+*        H 레코드는 섹션이 끝나야 길이를 알 수 있으므로 섹션의 D, R, T 레코드와 M 레코드는
+*        임시 파일에 모았다가 섹션이 끝나면 H 레코드 뒤에 이어 붙인다.
+* -----------------------------------------------------------------------------------
+*/
+static int stream_pass2(FILE* temp, char* object_file)
+{
+    STAT_PHASE(PHASE_PASS2);
+    writer out, body, modify;
+    if (output_open(&out, object_file) < 0)
+        return -1;
+    if (spool_open(&body) < 0) {
+        output_close(&out, OUTPUT_OBJECT);
+        return -1;
+    }
+    if (spool_open(&modify) < 0) {
+        spool_close(&body);
+        output_close(&out, OUTPUT_OBJECT);
+        return -1;
+    }
+
+    token tokens[STREAM_SLOT_COUNT];
+    char* text[STREAM_SLOT_COUNT] = { NULL, NULL };
+    int textCapacity[STREAM_SLOT_COUNT] = { 0, 0 };
+    for (int i = 0; i < STREAM_SLOT_COUNT; i++)
+        ctx->token_table[i] = &tokens[i];
+
+    //첫 섹션 이전에 라인이 있으면 그 부분도 하나의 섹션으로 처리
+    int prologue = (ctx->section_index == 0 || ctx->section_table[0].line_start > 0) ? 1 : 0;
+    int unitCnt = ctx->section_index + prologue;
+    int current = 0;
+    int subRoutine = -1;
+    bool isError = false;
+    pass2 unit;
+    stream_record record;
+    init_pass2_unit(&unit, -prologue);
+    while (fread(&record, sizeof(record), 1, temp) == 1) {
+        //다음 섹션의 라인이면 지금 섹션을 마치고 다음 섹션 시작(섹션의 START/CSECT 토큰을 덮어쓰기 전에)
+        while (record.line >= unit.line_end && current + 1 < unitCnt) {
+            stream_close_unit(&unit, &out, &body, &modify, &subRoutine);
+            init_pass2_unit(&unit, ++current - prologue);
+        }
+        int slot = (record.kind == OP_START || record.kind == OP_CSECT) ? STREAM_SECTION_SLOT : STREAM_LINE_SLOT;
+        if (stream_load_token(temp, &record, &tokens[slot], &text[slot], &textCapacity[slot]) < 0) {
+            isError = true;
+            break;
+        }
+        encode_line(&unit, slot);
+        if (unit.error) {
+            isError = true;
+            break;
+        }
+        stream_flush_codes(&unit, &body, &modify, subRoutine, false);
+    }
+    if (ferror(temp))
+        isError = true;
+    //남은 섹션(라인이 없는 섹션 포함) 마치기
+    while (1) {
+        stream_close_unit(&unit, &out, &body, &modify, &subRoutine);
+        if (++current >= unitCnt)
+            break;
+        init_pass2_unit(&unit, current - prologue);
+    }
+    //마지막 루틴의 E 레코드 출력
+    if (subRoutine >= 0)
+        writer_string(&out, "E\n", 0);
+
+    if (body.error || modify.error)
+        isError = true;
+    spool_close(&body);
+    spool_close(&modify);
+    for (int i = 0; i < STREAM_SLOT_COUNT; i++)
+        free(text[i]);
+    if (output_close(&out, OUTPUT_OBJECT) < 0)
+        isError = true;
+    //기존 방식과 같이 에러가 있으면 오브젝트 프로그램을 남기지 않음
+    if (isError && object_file != NULL)
+        unlink(object_file);
+    return isError ? -1 : 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 중간 파일에서 레코드 뒤의 문자열을 읽어 토큰을 만드는 함수이다.
+* 매계 : 중간 파일, 읽은 레코드, 정보를 저장할 토큰, 문자열 버퍼와 그 크기(토큰이 가리킨다)
+* 반환 : 정상종료 = 0, 에러 < 0
+* -----------------------------------------------------------------------------------
+*/
+static int stream_load_token(FILE* temp, stream_record* record, token* tok, char** text, int* capacity)
+{
+    if (record->text_size < 2 + MAX_OPERAND)
+        return -1;
+    RESERVE_TABLE(*text, *capacity, record->text_size);
+    if (fread(*text, 1, (size_t)record->text_size, temp) != (size_t)record->text_size)
+        return -1;
+
+    memset(tok, 0, sizeof(token));
+    char* position = *text;
+    tok->label = position;
+    position += strlen(position) + 1;
+    tok->operator = position;
+    position += strlen(position) + 1;
+    for (int i = 0; i < MAX_OPERAND; i++) {
+        tok->operand[i] = position;
+        position += strlen(position) + 1;
+        tok->operand_id[i] = record->operand_id[i];
+    }
+    tok->comment = empty_field;
+    tok->label_id = -1;
+    tok->kind = record->kind;
+    tok->format = record->format;
+    tok->opcode = record->opcode;
+    return 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 섹션의 코드 버퍼에서 레코드가 완성된 코드를 임시 파일에 출력하고 버퍼에서 지우는 함수이다.
+*        M 레코드도 모두 M 레코드 임시 파일로 옮긴다.
+* 매계 : 섹션 정보, D, R, T 레코드 임시 파일, M 레코드 임시 파일,
+*        지금까지 출력한 루틴의 번호, 섹션의 마지막인지(true이면 남은 코드를 모두 출력)
+* 반환 : 없음
+* 주의 : H 레코드는 섹션이 끝날 때 출력하므로 버퍼 맨 앞에 남겨둔다. 마지막 T 레코드는 다음
+*        라인의 코드가 이어질 수 있으므로 남겨두고, D, R 레코드는 그 라인의 토큰이
+*        바뀌기 전에(라인마다) 출력해야 한다.
+* -----------------------------------------------------------------------------------
+*/
+static void stream_flush_codes(pass2* unit, writer* body, writer* modify, int subRoutine, bool final)
+{
+    //H 레코드가 있는 섹션이면 출력할 때 루틴 번호가 하나 늘어난 상태
+    int routine = (unit->start_index >= 0) ? subRoutine + 1 : subRoutine;
+    int base = unit->start_index + 1;
+    int count = unit->code_index - base;
+    if (count > 0) {
+        code* table = unit->code_table + base;
+        int done = final ? count : stream_complete_codes(table, count);
+        write_section_records(body, table, done, NULL, 0, &routine, NULL);
+        if (done < count)
+            memmove(table, table + done, (size_t)(count - done) * sizeof(code));
+        unit->code_index -= done;
+    }
+
+    //첫 H 레코드 이전의 M 레코드는 출력하지 않음(make_objectcode_output()과 같음)
+    if (routine >= 0) {
+        for (int i = 0; i < unit->modify_index; i++)
+            write_modify_record(modify, &unit->modify_table[i]);
+    }
+    unit->modify_index = 0;
+    //M 레코드 문자열, WORD 수식은 출력한 뒤 필요 없으므로 가끔 비움
+    if (unit->pool.total > ARENA_BLOCK_SIZE)
+        arena_release(&unit->pool);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 코드 배열 중 레코드가 완성된 앞부분의 코드 개수를 알려주는 함수이다.
+* 매계 : 코드 배열, 코드 개수
+* 반환 : 마지막 T 레코드 이전까지의 코드 개수(마지막이 T 레코드가 아니면 전체)
+* 주의 : write_section_records()와 같은 방식(text_record_end())으로 T 레코드를 나누므로
+*        나누어 출력해도 한 번에 출력한 결과와 같다.
+* -----------------------------------------------------------------------------------
+*/
+static int stream_complete_codes(code* table, int count)
+{
+    int index = 0;
+    while (index < count) {
+        if (table[index].record != 'T') {
+            index++;
+            continue;
+        }
+        int length;
+        int end = text_record_end(table, index, count, &length);
+        if (end == count)
+            return index;
+        index = end;
+    }
+    return count;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : out-of-core 모드에서 섹션의 마지막 라인까지 처리한 뒤 섹션의 레코드를 출력하는 함수이다.
+*        H 레코드(앞 루틴의 E 레코드 포함), 모아둔 D, R, T 레코드, M 레코드 순서로 출력한다.
+* 매계 : 섹션 정보, 오브젝트 프로그램 writer, D, R, T 레코드 임시 파일, M 레코드 임시 파일,
+*        지금까지 출력한 루틴의 번호(H 레코드를 출력하면 증가)
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void stream_close_unit(pass2* unit, writer* out, writer* body, writer* modify, int* subRoutine)
+{
+    finish_section(unit);
+    stream_flush_codes(unit, body, modify, *subRoutine, true);
+    if (unit->start_index >= 0)
+        write_section_records(out, unit->code_table + unit->start_index, 1, NULL, 0, subRoutine, NULL);
+    spool_copy(body, out);
+    spool_copy(modify, out);
+
+    free(unit->code_table);
+    free(unit->modify_table);
+    unit->code_table = NULL;
+    unit->modify_table = NULL;
+    arena_release(&unit->pool);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 소스 파일에서 다음 라인을 읽는 함수이다.
+* 매계 : 소스 파일 입력
+* 반환 : 라인('\0'으로 끝나며 다음 호출까지만 유효), 파일 끝이거나 에러이면 NULL
+* 주의 : 줄바꿈 문자(\n, \r\n)는 저장하지 않는다.(split_input()과 같음)
+*        tokenize_line()이 라인을 직접 나누므로 라인은 버퍼 안에서 바뀐다.
+* -----------------------------------------------------------------------------------
+*/
+static char* stream_read_line(stream_input* in)
+{
+    while (1) {
+        char* line = in->buffer + in->start;
+        char* newline = (in->start < in->end) ? (char*)memchr(line, '\n', in->end - in->start) : NULL;
+        //마지막 라인에 줄바꿈 문자가 없으면 버퍼 끝에 '\0'을 붙임
+        if (newline == NULL && in->eof && in->start < in->end)
+            newline = in->buffer + in->end;
+        if (newline != NULL) {
+            *newline = '\0';
+            if (newline > line && newline[-1] == '\r')
+                newline[-1] = '\0';
+            in->start = (size_t)(newline - in->buffer) + 1;
+            if (in->start > in->end)
+                in->start = in->end;
+            return line;
+        }
+        if (in->eof || in->error)
+            return NULL;
+
+        //남은 부분을 버퍼 앞으로 옮기고 이어서 읽기(라인이 버퍼보다 길면 버퍼를 늘림)
+        if (in->start > 0) {
+            memmove(in->buffer, in->buffer + in->start, in->end - in->start);
+            in->end -= in->start;
+            in->start = 0;
+        }
+        if (in->end + 1 >= (size_t)in->capacity)
+            RESERVE_TABLE(in->buffer, in->capacity, (in->capacity > 0) ? in->capacity * 2 : STREAM_BUFFER_SIZE);
+        ssize_t readSize = read(in->fd, in->buffer + in->end, (size_t)in->capacity - in->end - 1);
+        if (readSize < 0 && errno == EINTR)
+            continue;
+        if (readSize < 0)
+            in->error = true;
+        else if (readSize == 0)
+            in->eof = true;
+        else
+            in->end += (size_t)readSize;
+    }
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : out-of-core 모드에서 사용할 임시 파일을 만드는 함수이다.
+* 매계 : 없음
+* 반환 : 정상종료 = 파일 디스크립터, 에러 < 0
+* 주의 : TMPDIR(없으면 /tmp)에 만들고 이름은 바로 지우므로 닫으면(비정상 종료 포함) 사라진다.
+* -----------------------------------------------------------------------------------
+*/
+static int stream_temp_file(void)
+{
+    const char* dir = getenv("TMPDIR");
+    if (dir == NULL || dir[0] == '\0')
+        dir = "/tmp";
+    char* path = (char*)malloc(strlen(dir) + sizeof("/sicxe-XXXXXX"));
+    if (path == NULL)
+        return -1;
+    sprintf(path, "%s/sicxe-XXXXXX", dir);
+    int fd = mkstemp(path);
+    if (fd >= 0)
+        unlink(path);
+    free(path);
+    return fd;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 레코드를 모아둘 임시 파일과 그 writer를 여는 함수이다.
+* 매계 : 준비할 writer
+* 반환 : 정상종료 = 0, 에러 < 0
+* 주의 : 오브젝트 프로그램 writer와 동시에 사용하므로 스레드의 출력 버퍼(writer_buffer)
+*        대신 자신만의 버퍼를 사용한다.
+* -----------------------------------------------------------------------------------
+*/
+static int spool_open(writer* out)
+{
+    memset(out, 0, sizeof(writer));
+    out->buffer = (char*)malloc(WRITER_BUFFER_SIZE);
+    out->fd = stream_temp_file();
+    if (out->buffer == NULL || out->fd < 0) {
+        spool_close(out);
+        return -1;
+    }
+    return 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 임시 파일에 모아둔 내용을 다른 writer로 출력하고 임시 파일을 비우는 함수이다.
+* 매계 : 임시 파일 writer, 출력할 writer
+* 반환 : 없음(에러는 각 writer의 error에 표시)
+* -----------------------------------------------------------------------------------
+*/
+static void spool_copy(writer* from, writer* to)
+{
+    writer_flush(from);
+    off_t size = lseek(from->fd, 0, SEEK_CUR);
+    if (size <= 0) {
+        from->error = from->error || size < 0;
+        return;
+    }
+    if (lseek(from->fd, 0, SEEK_SET) < 0) {
+        from->error = true;
+        return;
+    }
+    //다음 섹션은 처음부터 덮어쓰고, 쓴 만큼만 다시 읽음
+    while (size > 0) {
+        ssize_t readSize = read(from->fd, from->buffer, (size > WRITER_BUFFER_SIZE) ? WRITER_BUFFER_SIZE : (size_t)size);
+        if (readSize < 0 && errno == EINTR)
+            continue;
+        if (readSize <= 0) {
+            from->error = true;
+            break;
+        }
+        writer_bytes(to, from->buffer, (size_t)readSize);
+        size -= readSize;
+    }
+    if (lseek(from->fd, 0, SEEK_SET) < 0)
+        from->error = true;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : spool_open()으로 연 임시 파일과 버퍼를 해제하는 함수이다.
+* 매계 : 임시 파일 writer
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void spool_close(writer* out)
+{
+    if (out->fd >= 0)
+        close(out->fd);
+    free(out->buffer);
+    out->fd = -1;
+    out->buffer = NULL;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 소스 파일을 one-pass 모드로 어셈블하는 함수이다.
+*        소스를 한 라인씩 읽어 토큰으로 나누고 주소를 계산하여 심볼, 리터럴 테이블을 채우는
+*        즉시 그 라인의 기계어 코드를 만든다. 뒤에서 정의될 symbol이나 LTORG/END에서 배치될
+*        리터럴을 참조한 코드는 fixup으로 남겨두었다가 값이 정해지면 고친다.
+*        소스는 한 번만 읽고 중간 파일도 만들지 않으며, 라인의 토큰은 코드를 만든 뒤 버린다.
+* 매계 : 소스 파일, 오브젝트 프로그램 파일, 심볼 테이블 파일, 리터럴 테이블 파일
+* 반환 : 정상종료 = 0, 에러 < 0, 기존 방식으로 다시 어셈블해야 하면 1
+* 주의 : 결과 파일은 assem_pass1() -> assem_pass2() -> make_objectcode_output()과 같다.
+*        다음 경우에는 라인을 읽는 시점에 같은 코드를 만들 수 없으므로 1을 반환한다.
+*        1. MACRO/MEND가 있는 소스(assemble_streamed()와 같음)
+*        2. 첫 START/CSECT 이전에 코드나 label이 있는 소스
+*        3. 섹션에서 참조한 리터럴이 다음 섹션의 LTORG/END에서 배치되는 경우
+*        4. EXTREF로 처리한 이름이 그 뒤 같은 섹션에서 정의되는 경우
+*        5. LTORG/END가 다음 리터럴과 비교한 주소에 그 리터럴이 나중에 배치되는 경우
+*        오브젝트 프로그램은 임시 파일에 모았다가 모두 끝난 뒤 옮기므로 다시 어셈블하거나
+*        실패하면 만들지 않는다. 끝나면 release_my_assembler()로 어셈블리의 상태를 해제한다.
+* -----------------------------------------------------------------------------------
+*/
+static int assemble_onepass(char* source, char* object_file, char* symtab_file, char* literal_file)
+{
+    stream_input in;
+    onepass op;
+    STAT_SOURCE(source);
+    memset(&in, 0, sizeof(in));
+    memset(&op, 0, sizeof(op));
+    op.object.fd = op.body.fd = op.modify.fd = -1;
+    if ((in.fd = open(source, O_RDONLY)) < 0) {
+        release_my_assembler();
+        return -1;
+    }
+
+    int result = -1;
+    if (spool_open(&op.object) == 0 && spool_open(&op.body) == 0 && spool_open(&op.modify) == 0)
+        result = onepass_run(&op, &in);
+    close(in.fd);
+    free(in.buffer);
+    if (result == 0) {
+        make_symtab_output(symtab_file);
+        make_literaltab_output(literal_file);
+        //기존 방식과 같이 인코딩 중 에러가 있으면 오브젝트 프로그램을 남기지 않음
+        writer out;
+        if (op.error || op.object.error || op.body.error || op.modify.error || output_open(&out, object_file) < 0)
+            result = -1;
+        else {
+            spool_copy(&op.object, &out);
+            //마지막 루틴의 E 레코드 출력
+            if (op.routine >= 0)
+                writer_string(&out, "E\n", 0);
+            if (output_close(&out, OUTPUT_OBJECT) < 0 || op.object.error) {
+                if (object_file != NULL)
+                    unlink(object_file);
+                result = -1;
+            }
+        }
+    }
+    onepass_release(&op);
+    release_my_assembler();
+    return result;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : one-pass 모드에서 소스를 끝까지 읽으면서 테이블을 채우고 코드를 만드는 함수이다.
+* 매계 : one-pass 모드의 상태, 소스 파일 입력
+* 반환 : 정상종료 = 0, 에러 < 0, 기존 방식으로 다시 어셈블해야 하면 1
+* 주의 : 라인의 주소 계산은 stream_pass1()과 같다. 라인을 테이블에 반영한 뒤 그 라인에서 정의된
+*        symbol과 배치된 리터럴을 기다리던 코드를 먼저 고치고 라인의 코드를 만든다.
+* -----------------------------------------------------------------------------------
+*/
+static int onepass_run(onepass* op, stream_input* in)
+{
+    STAT_PHASE(PHASE_PASS1);
+    token tok;
+    arena scratch;      //EQU 수식(그 라인에서만 사용)
+    int lineNum = 0;
+    int addr = 0;
+    bool started = false;   //START/CSECT를 만났으면 true
+    int result = 0;
+    char* line;
+
+    memset(&scratch, 0, sizeof(scratch));
+    RESERVE_TABLE(ctx->token_table, ctx->token_capacity, ONEPASS_LINE_SLOT + 1);
+    ctx->token_table[ONEPASS_LINE_SLOT] = &tok;
+    op->routine = -1;
+    onepass_open_section(op);
+    while ((line = stream_read_line(in)) != NULL) {
+        size_t length;
+        char* name = line_operator(line, &length);
+        if (line[0] != '.' && ((length == 5 && strncmp(name, "MACRO", 5) == 0) || (length == 4 && strncmp(name, "MEND", 4) == 0))) {
+            result = 1;
+            break;
+        }
+        if (tokenize_line(line, &tok) < 0) {
+            result = -1;
+            break;
+        }
+        stream_intern(&tok);
+        if (tok.kind == OP_EQU)
+            tok.expr = compile_expression(tok.operand[0], &scratch, NULL);
+        //WORD 수식은 fixup으로 남을 수 있으므로 섹션의 arena에 만들고, 뒤에서 정의될 symbol에도 이름 ID를 붙임
+        else if (tok.kind == OP_WORD) {
+            int known = ctx->names.count;
+            tok.expr = compile_expression(tok.operand[0], &op->unit.pool, &ctx->names);
+            for (int id = known; id < ctx->names.count; id++)
+                ctx->names.entry[id].name = arena_strdup(&ctx->asm_arena, ctx->names.entry[id].name);
+        }
+
+        //새 섹션이면 지금 섹션을 마침(첫 섹션 이전의 코드는 기존 방식으로 처리)
+        if (tok.kind == OP_START || tok.kind == OP_CSECT) {
+            if (started)
+                onepass_close_section(op);
+            started = true;
+        }
+        else if (!started && (tok.kind != OP_NONE || tok.label_id >= 0))
+            op->fallback = true;
+        if (op->fallback) {
+            result = 1;
+            break;
+        }
+
+        pool_literals(ONEPASS_LINE_SLOT);
+        if (tok.kind == OP_CSECT)
+            addr = 0;
+        tok.addr = addr;
+        addr += tok.size;
+        int placed = ctx->literal_start;
+        if (account_line(ONEPASS_LINE_SLOT) < 0) {
+            result = -1;
+            break;
+        }
+        if (tok.kind == OP_START || tok.kind == OP_CSECT) {
+            ctx->section_table[ctx->section_index - 1].line_start = lineNum;
+            onepass_open_section(op);
+        }
+
+        //이 라인에서 정의된 symbol과 배치된 리터럴을 기다리던 코드 고치기
+        if (tok.label_id >= 0)
+            onepass_define(op, tok.label_id);
+        for (int i = placed; i < ctx->literal_start; i++)
+            onepass_place(op, i);
+        //레코드를 출력할 때 토큰이 필요한 라인은 섹션이 끝날 때까지 복사해 둠
+        bool keep = (tok.kind == OP_START || tok.kind == OP_CSECT || tok.kind == OP_EXTDEF || tok.kind == OP_EXTREF);
+        onepass_encode(op, keep ? onepass_keep(op, &tok) : ONEPASS_LINE_SLOT);
+        onepass_flush(op, false);
+        if (op->unit.error)
+            op->error = true;
+        if (op->fallback) {
+            result = 1;
+            break;
+        }
+
+        lineNum++;
+        if (scratch.total > ARENA_BLOCK_SIZE)
+            arena_release(&scratch);
+    }
+    arena_release(&scratch);
+    if (result != 0)
+        return result;
+    if (in->error)
+        return -1;
+    if (started)
+        onepass_close_section(op);
+    if (op->fallback)
+        return 1;
+
+    ctx->line_num = lineNum;
+    ctx->locctr = addr;
+    STAT_ADD(STAT_LINES, lineNum);
+    STAT_ADD(STAT_SECTIONS, ctx->section_index);
+    return 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : one-pass 모드에서 새 섹션의 코드 버퍼를 준비하는 함수이다.
+* 매계 : one-pass 모드의 상태
+* 반환 : 없음
+* 주의 : 섹션 테이블에 새 섹션을 추가한 뒤(START/CSECT 라인의 account_line() 뒤) 호출한다.
+* -----------------------------------------------------------------------------------
+*/
+static void onepass_open_section(onepass* op)
+{
+    pass2* unit = &op->unit;
+    free(unit->code_table);
+    free(unit->modify_table);
+    arena_release(&unit->pool);
+    memset(unit, 0, sizeof(pass2));
+    unit->section = ctx->section_index - 1;
+    unit->literal_cursor = (unit->section >= 0) ? ctx->section_table[unit->section].literal_begin : 0;
+    unit->literal_end = -1;
+    unit->boundary_addr = -1;
+    unit->start_index = -1;
+    op->flushed = 0;
+    op->modify_sorted = 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : one-pass 모드에서 섹션의 마지막 라인까지 처리한 뒤 섹션의 레코드를 출력하는 함수이다.
+*        끝까지 정의되지 않은 symbol을 기다리던 코드는 기존 방식과 같이 계산하여 완성한다.
+* 매계 : one-pass 모드의 상태
+* 반환 : 없음(다시 어셈블해야 하면 op->fallback을 true로 바꾼다)
+* -----------------------------------------------------------------------------------
+*/
+static void onepass_close_section(onepass* op)
+{
+    pass2* unit = &op->unit;
+    //다음 섹션에서 배치될 리터럴을 기다리는 코드는 이 섹션에서 고칠 수 없음
+    for (int i = 0; i < op->link_index; i++) {
+        if (op->link_table[i].literal && op->literal_head[op->link_table[i].key] != 0)
+            op->fallback = true;
+    }
+    //섹션에 없는 symbol은 displacement가 0, WORD는 M 레코드로 처리
+    for (int i = op->fixup_start; i < op->fixup_index; i++) {
+        fixup* item = &op->fixup_table[i];
+        if (item->waiting > 0 && item->kind == FIXUP_WORD) {
+            code* object = &unit->code_table[item->code - op->flushed];
+            object->code = encode_word(unit, item->expr, object->addr, item->operand);
+        }
+        item->waiting = 0;
+    }
+    if (unit->error)
+        op->error = true;
+    onepass_flush(op, true);
+    stream_close_unit(unit, &op->object, &op->body, &op->modify, &op->routine);
+
+    for (int i = 0; i < op->link_index; i++) {
+        fixup_link* link = &op->link_table[i];
+        if (link->literal)
+            op->literal_head[link->key] = 0;
+        else
+            op->name_head[link->key] = 0;
+    }
+    op->link_index = op->fixup_index = op->fixup_start = 0;
+    arena_release(&op->keep);
+    op->keep_count = 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 레코드를 출력할 때 필요한 라인의 토큰을 섹션이 끝날 때까지 복사해 두는 함수이다.
+* 매계 : one-pass 모드의 상태, 복사할 토큰(현재 라인)
+* 반환 : 복사한 토큰의 token_table index
+* -----------------------------------------------------------------------------------
+*/
+static int onepass_keep(onepass* op, token* tok)
+{
+    int slot = ONEPASS_LINE_SLOT + 1 + op->keep_count++;
+    RESERVE_TABLE(ctx->token_table, ctx->token_capacity, slot + 1);
+    token* copy = (token*)arena_alloc(&op->keep, sizeof(token));
+    *copy = *tok;
+    copy->label = arena_strdup(&op->keep, tok->label);
+    copy->operator = arena_strdup(&op->keep, tok->operator);
+    for (int i = 0; i < MAX_OPERAND; i++)
+        copy->operand[i] = arena_strdup(&op->keep, tok->operand[i]);
+    copy->comment = empty_field;
+    copy->expr = NULL;
+    ctx->token_table[slot] = copy;
+    return slot;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : one-pass 모드에서 라인 하나의 코드를 만들고, 아직 값을 모르는 이름이나 리터럴을
+*        참조하면 fixup과 chain을 남기는 함수이다.
+* 매계 : one-pass 모드의 상태, 라인 토큰의 token_table index
+* 반환 : 없음
+* 주의 : 코드는 encode_line()이 만들고, 값을 모르는 부분은 기존 방식에서 그 이름이 섹션에
+*        없을 때의 값(displacement 0)으로 남는다. WORD는 수식의 symbol이 모두 정해진 뒤
+*        encode_word()로 계산해야 M 레코드가 같으므로 자리만 만들어 둔다.
+* -----------------------------------------------------------------------------------
+*/
+static void onepass_encode(onepass* op, int slot)
+{
+    pass2* unit = &op->unit;
+    token* tok = ctx->token_table[slot];
+    int section = unit->section;
+
+    if (tok->kind == OP_WORD) {
+        expression* expr = tok->expr;
+        int waiting = 0;
+        for (int i = 0; i < expr->count; i++) {
+            expr_item* item = &expr->item[i];
+            if (item->kind == EXPR_SYMBOL && find_symbol(item->value, section) < 0 && !onepass_extref(unit, item->value))
+                waiting++;
+        }
+        int index = -1;
+        if (waiting == 0)
+            encode_line(unit, slot);
+        else {
+            emit_code(unit, 'T', 3, unit->locctr, slot);
+            unit->locctr += 3;
+            index = onepass_add(op, FIXUP_WORD, waiting);
+            op->fixup_table[index].expr = expr;
+            op->fixup_table[index].operand = arena_strdup(&unit->pool, tok->operand[0]);
+        }
+        //EXTREF로 처리한 symbol은 섹션에서 정의되는지만 감시
+        for (int i = 0; i < expr->count; i++) {
+            expr_item* item = &expr->item[i];
+            if (item->kind == EXPR_SYMBOL && find_symbol(item->value, section) < 0)
+                onepass_wait(op, onepass_extref(unit, item->value) ? -1 : index, item->value, false);
+        }
+        return;
+    }
+
+    int cursor = unit->literal_cursor;
+    encode_line(unit, slot);
+    //3-byte format에서 섹션에 아직 없는 symbol이나 배치되지 않은 리터럴을 참조하면 displacement를 나중에 채움
+    if (tok->kind == OP_INSTRUCTION && tok->format == 3 && inst_table[tok->opcode]->operandCnt != 0 && tok->operand[0][0] != '#') {
+        int name = tok->operand_id[0];
+        if (name >= 0 && search_name(name, section) == -1) {
+            int literal = (tok->operand[0][0] == '=') ? literal_find(name, cursor) : -1;
+            if (literal >= ctx->literal_start)
+                onepass_wait(op, onepass_add(op, FIXUP_DISP, 1), literal, true);
+            else if (literal < 0)
+                onepass_wait(op, onepass_extref(unit, name) ? -1 : onepass_add(op, FIXUP_DISP, 1), name, false);
+        }
+    }
+    //D 레코드는 출력할 때 심볼의 주소를 찾으므로 모두 정의될 때까지 출력을 미룸
+    else if (tok->kind == OP_EXTDEF) {
+        int waiting = 0;
+        for (int i = 0; i < MAX_OPERAND && tok->operand[i][0] != '\0'; i++) {
+            if (tok->operand_id[i] >= 0 && search_name(tok->operand_id[i], section) == -1)
+                waiting++;
+        }
+        if (waiting > 0) {
+            int index = onepass_add(op, FIXUP_DEFINE, waiting);
+            for (int i = 0; i < MAX_OPERAND && tok->operand[i][0] != '\0'; i++) {
+                if (tok->operand_id[i] >= 0 && search_name(tok->operand_id[i], section) == -1)
+                    onepass_wait(op, index, tok->operand_id[i], false);
+            }
+        }
+    }
+    //LTORG/END가 다음 리터럴(아직 없음)과 비교한 주소 기록
+    else if ((tok->kind == OP_LTORG || tok->kind == OP_END) && unit->literal_cursor == ctx->literal_index) {
+        RESERVE_TABLE(op->boundary_table, op->boundary_capacity, op->boundary_index + 1);
+        op->boundary_table[op->boundary_index].literal = unit->literal_cursor;
+        op->boundary_table[op->boundary_index].addr = unit->locctr;
+        op->boundary_index++;
+    }
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 방금 만든 코드(섹션의 마지막 코드)에 fixup을 추가하는 함수이다.
+* 매계 : one-pass 모드의 상태, fixup 종류(enum fixup_kind), 기다리는 이름(리터럴) 수
+* 반환 : 추가한 fixup의 index
+* -----------------------------------------------------------------------------------
+*/
+static int onepass_add(onepass* op, int kind, int waiting)
+{
+    RESERVE_TABLE(op->fixup_table, op->fixup_capacity, op->fixup_index + 1);
+    fixup* item = &op->fixup_table[op->fixup_index];
+    item->code = op->flushed + op->unit.code_index - 1;
+    item->kind = kind;
+    item->waiting = waiting;
+    item->expr = NULL;
+    item->operand = NULL;
+    return op->fixup_index++;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : fixup이 이름(또는 리터럴)을 기다리도록 그 이름의 chain에 연결하는 함수이다.
+* 매계 : one-pass 모드의 상태, fixup의 index(-1이면 정의되는지 감시만 함),
+*        이름 ID 또는 리터럴 index, key가 리터럴 index인지
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void onepass_wait(onepass* op, int index, int key, bool literal)
+{
+    int* head;
+    if (key < 0)
+        return;
+    if (literal) {
+        RESERVE_TABLE(op->literal_head, op->literal_head_capacity, key + 1);
+        head = &op->literal_head[key];
+    }
+    else {
+        RESERVE_TABLE(op->name_head, op->name_head_capacity, key + 1);
+        head = &op->name_head[key];
+    }
+    RESERVE_TABLE(op->link_table, op->link_capacity, op->link_index + 1);
+    fixup_link* link = &op->link_table[op->link_index];
+    link->fixup = index;
+    link->key = key;
+    link->literal = literal;
+    link->next = *head;
+    *head = ++op->link_index;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 값이 정해진 이름(또는 리터럴)의 chain을 따라 기다리던 코드를 고치는 함수이다.
+* 매계 : one-pass 모드의 상태, chain의 첫 link index + 1, 정해진 주소
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void onepass_resolve(onepass* op, int head, int value)
+{
+    for (int index = head - 1; index >= 0; index = op->link_table[index].next - 1) {
+        //EXTREF로 처리한 이름이 정의되면 기존 방식은 그 심볼로 계산하므로 결과가 달라짐
+        if (op->link_table[index].fixup < 0) {
+            op->fallback = true;
+            continue;
+        }
+        fixup* item = &op->fixup_table[op->link_table[index].fixup];
+        if (item->waiting == 0)
+            continue;
+        code* object = &op->unit.code_table[item->code - op->flushed];
+        if (item->kind == FIXUP_DISP) {
+            object->code = (object->code & ~0xFFF) | ((value - (object->addr + object->format)) & 0xFFF);
+            item->waiting = 0;
+        }
+        else if (--item->waiting == 0 && item->kind == FIXUP_WORD)
+            object->code = encode_word(&op->unit, item->expr, object->addr, item->operand);
+    }
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 라인의 label이 정의되었을 때 그 이름을 기다리던 코드를 고치는 함수이다.
+* 매계 : one-pass 모드의 상태, label의 이름 ID
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void onepass_define(onepass* op, int name)
+{
+    if (name >= op->name_head_capacity || op->name_head[name] == 0)
+        return;
+    onepass_resolve(op, op->name_head[name], search_name(name, op->unit.section));
+    op->name_head[name] = 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : LTORG/END에서 리터럴의 주소가 정해졌을 때 그 리터럴을 기다리던 코드를 고치는 함수이다.
+* 매계 : one-pass 모드의 상태, literal_table의 index
+* 반환 : 없음
+* 주의 : 앞의 LTORG/END가 이 리터럴과 비교한 주소에 배치되면 기존 방식은 그 LTORG/END에서
+*        리터럴의 코드를 만들었으므로 다시 어셈블하도록 op->fallback을 true로 바꾼다.
+* -----------------------------------------------------------------------------------
+*/
+static void onepass_place(onepass* op, int literal)
+{
+    while (op->boundary_start < op->boundary_index && op->boundary_table[op->boundary_start].literal <= literal) {
+        fixup_boundary* boundary = &op->boundary_table[op->boundary_start++];
+        if (boundary->literal == literal && boundary->addr == ctx->literal_table[literal].addr)
+            op->fallback = true;
+    }
+    if (op->boundary_start == op->boundary_index)
+        op->boundary_start = op->boundary_index = 0;
+
+    if (literal >= op->literal_head_capacity || op->literal_head[literal] == 0)
+        return;
+    onepass_resolve(op, op->literal_head[literal], ctx->literal_table[literal].addr);
+    op->literal_head[literal] = 0;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 이름이 현재 섹션의 EXTREF 변수인지 알려주는 함수이다.
+* 매계 : 섹션 정보, 이름 ID
+* 반환 : EXTREF 변수이면 true
+* -----------------------------------------------------------------------------------
+*/
+static bool onepass_extref(pass2* unit, int name)
+{
+    for (int i = 0; i < unit->extref_count; i++) {
+        if (unit->extref[i] == name && name >= 0)
+            return true;
+    }
+    return false;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 섹션의 코드 버퍼에서 완성된 코드를 임시 파일에 출력하고 버퍼에서 지우는 함수이다.
+*        값을 기다리는 첫 코드부터는 버퍼에 남기고, M 레코드도 그 코드의 주소 앞까지만 출력한다.
+* 매계 : one-pass 모드의 상태, 섹션의 마지막인지(true이면 남은 코드를 모두 출력)
+* 반환 : 없음
+* 주의 : 나중에 계산한 WORD의 M 레코드는 뒤에 추가되므로, 출력하기 전에 주소 순서(기존 방식의
+*        라인 순서)로 정렬한다. 마지막이면 기다리는 fixup이 없어야 한다.
+* -----------------------------------------------------------------------------------
+*/
+static void onepass_flush(onepass* op, bool final)
+{
+    pass2* unit = &op->unit;
+    //H 레코드가 있는 섹션이면 출력할 때 루틴 번호가 하나 늘어난 상태
+    int routine = (unit->start_index >= 0) ? op->routine + 1 : op->routine;
+    int base = unit->start_index + 1;
+    int limit = unit->code_index;
+    int limitAddr = -1;     //출력을 미룬 첫 코드의 주소(-1이면 모두 출력할 수 있음)
+    while (op->fixup_start < op->fixup_index && op->fixup_table[op->fixup_start].waiting == 0)
+        op->fixup_start++;
+    if (op->fixup_start < op->fixup_index) {
+        limit = op->fixup_table[op->fixup_start].code - op->flushed;
+        limitAddr = unit->code_table[limit].addr;
+    }
+    else
+        op->fixup_start = op->fixup_index = 0;
+
+    int count = limit - base;
+    if (count > 0) {
+        code* table = unit->code_table + base;
+        int done = final ? count : stream_complete_codes(table, count);
+        write_section_records(&op->body, table, done, NULL, 0, &routine, NULL);
+        if (done < unit->code_index - base)
+            memmove(table, table + done, (size_t)(unit->code_index - base - done) * sizeof(code));
+        unit->code_index -= done;
+        op->flushed += done;
+    }
+
+    for (int i = (op->modify_sorted > 0) ? op->modify_sorted : 1; i < unit->modify_index; i++) {
+        modify item = unit->modify_table[i];
+        int j = i;
+        for (; j > 0 && unit->modify_table[j - 1].addr > item.addr; j--)
+            unit->modify_table[j] = unit->modify_table[j - 1];
+        unit->modify_table[j] = item;
+    }
+    int written = 0;
+    while (written < unit->modify_index && (limitAddr < 0 || unit->modify_table[written].addr < limitAddr)) {
+        //첫 H 레코드 이전의 M 레코드는 출력하지 않음(make_objectcode_output()과 같음)
+        if (routine >= 0)
+            write_modify_record(&op->modify, &unit->modify_table[written]);
+        written++;
+    }
+    if (written > 0) {
+        memmove(unit->modify_table, unit->modify_table + written, (size_t)(unit->modify_index - written) * sizeof(modify));
+        unit->modify_index -= written;
+    }
+    op->modify_sorted = unit->modify_index;
+    //M 레코드 문자열과 WORD 수식은 기다리는 코드가 없으면 필요 없으므로 가끔 비움
+    if (limitAddr < 0 && unit->modify_index == 0 && unit->pool.total > ARENA_BLOCK_SIZE)
+        arena_release(&unit->pool);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : one-pass 모드의 상태를 해제하는 함수이다.
+* 매계 : one-pass 모드의 상태
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void onepass_release(onepass* op)
+{
+    free(op->unit.code_table);
+    free(op->unit.modify_table);
+    arena_release(&op->unit.pool);
+    free(op->fixup_table);
+    free(op->link_table);
+    free(op->name_head);
+    free(op->literal_head);
+    free(op->boundary_table);
+    arena_release(&op->keep);
+    spool_close(&op->object);
+    spool_close(&op->body);
+    spool_close(&op->modify);
+    memset(op, 0, sizeof(onepass));
+}
+
+#ifdef SICXE_STATS
+static const char* stat_phase_names[PHASE_COUNT] = {
+    "none", "inst_load", "input_load", "pass1", "symtab_output", "literaltab_output", "pass2", "objectcode_output",
+    "load"
+};
+static const char* stat_counter_names[STAT_COUNT] = {
+    "opcode_searches", "opcode_probes", "symbol_searches", "symbol_probes", "allocations",
+    "allocated_bytes", "lines", "sections", "t_records", "m_records"
+};
+static pthread_mutex_t stat_lock = PTHREAD_MUTEX_INITIALIZER;
+static double stat_epoch;           //처음 단계를 시작한 시각(trace의 기준 시각)
+static int stat_thread_count;       //번호를 받은 스레드 개수
+static _Thread_local int stat_thread;   //현재 스레드의 번호(0이면 아직 받지 않음)
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 현재 어셈블리(ctx)의 진행 중인 단계를 끝내고 새 단계를 시작하는 함수이다.
+*        끝난 단계의 시간, 카운터, 최대 메모리 사용량을 stat_events에 기록하고
+*        카운터를 0으로 되돌린다.
+* 매계 : 시작할 단계(PHASE_NONE이면 단계를 끝내기만 한다)
+* 반환 : 없음
+* 주의 : 단계는 어셈블리를 처리하는 스레드에서만 바꾸며, 풀 스레드는 카운터만 더한다.
+* -----------------------------------------------------------------------------------
+*/
+static void stats_phase(int phase)
+{
+    stats* current = &ctx->stats;
+    double now = now_seconds();
+
+    if (current->phase != PHASE_NONE) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        pthread_mutex_lock(&stat_lock);
+        if (stat_thread == 0)
+            stat_thread = ++stat_thread_count;
+        RESERVE_TABLE(stat_events, stat_event_capacity, stat_event_index + 1);
+        stat_event* event = &stat_events[stat_event_index++];
+        event->phase = current->phase;
+        event->source = current->source;
+        event->thread = stat_thread;
+        event->start = current->start - stat_epoch;
+        event->seconds = now - current->start;
+        memcpy(event->counter, current->counter, sizeof(event->counter));
+        event->peak_kb = usage.ru_maxrss;
+        pthread_mutex_unlock(&stat_lock);
+    }
+    else if (phase != PHASE_NONE) {
+        pthread_mutex_lock(&stat_lock);
+        if (stat_epoch == 0)
+            stat_epoch = now;
+        pthread_mutex_unlock(&stat_lock);
+    }
+
+    memset(current->counter, 0, sizeof(current->counter));
+    current->phase = phase;
+    current->start = now;
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 문자열을 JSON 문자열로 출력하는 함수이다.(따옴표, 역슬래시, 제어 문자 처리)
+* 매계 : 출력할 writer, 문자열(NULL이면 null)
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void stats_json_string(writer* out, const char* str)
+{
+    if (str == NULL) {
+        writer_string(out, "null", 0);
+        return;
+    }
+    writer_char(out, '"');
+    for (; *str != '\0'; str++) {
+        if (*str == '"' || *str == '\\') {
+            writer_char(out, '\\');
+            writer_char(out, *str);
+        }
+        else if ((unsigned char)*str < 0x20) {
+            writer_string(out, "\\u00", 0);
+            writer_hex(out, (unsigned char)*str, 2);
+        }
+        else
+            writer_char(out, *str);
+    }
+    writer_char(out, '"');
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 카운터들을 JSON 객체({"이름": 값, ...})로 출력하는 함수이다.
+* 매계 : 출력할 writer, 카운터 배열(STAT_COUNT개)
+* 반환 : 없음
+* -----------------------------------------------------------------------------------
+*/
+static void stats_json_counters(writer* out, const long long* counter)
+{
+    char number[32];
+    writer_char(out, '{');
+    for (int i = 0; i < STAT_COUNT; i++) {
+        sprintf(number, "%s\"%s\": %lld", (i > 0) ? ", " : "", stat_counter_names[i], counter[i]);
+        writer_string(out, number, 0);
+    }
+    writer_char(out, '}');
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 기록된 단계들을 JSON 파일로 출력하는 함수이다.
+*        phases에는 단계 하나씩(소스, 스레드, 시간, 카운터), totals에는 단계별 합계,
+*        peak_rss_kb에는 프로세스의 최대 메모리 사용량을 출력한다.
+* 매계 : 출력할 파일 이름(NULL이면 표준출력)
+* 반환 : 정상종료 = 0, 에러 < 0
+* -----------------------------------------------------------------------------------
+*/
+static int stats_write_json(char* file_name)
+{
+    writer out;
+    char number[256];
+    double seconds[PHASE_COUNT] = { 0 };
+    long long total[PHASE_COUNT][STAT_COUNT];
+    struct rusage usage;
+
+    if (writer_open(&out, file_name) < 0)
+        return -1;
+    memset(total, 0, sizeof(total));
+    getrusage(RUSAGE_SELF, &usage);
+    sprintf(number, "{\n  \"peak_rss_kb\": %ld,\n  \"phases\": [", usage.ru_maxrss);
+    writer_string(&out, number, 0);
+    for (int i = 0; i < stat_event_index; i++) {
+        stat_event* event = &stat_events[i];
+        writer_string(&out, (i > 0) ? ",\n    {\"source\": " : "\n    {\"source\": ", 0);
+        stats_json_string(&out, event->source);
+        sprintf(number, ", \"phase\": \"%s\", \"thread\": %d, \"seconds\": %.9f, \"peak_rss_kb\": %ld, \"counters\": ",
+            stat_phase_names[event->phase], event->thread, event->seconds, event->peak_kb);
+        writer_string(&out, number, 0);
+        stats_json_counters(&out, event->counter);
+        writer_char(&out, '}');
+
+        seconds[event->phase] += event->seconds;
+        for (int j = 0; j < STAT_COUNT; j++)
+            total[event->phase][j] += event->counter[j];
+    }
+    writer_string(&out, "\n  ],\n  \"totals\": {", 0);
+    bool first = true;
+    for (int i = PHASE_NONE + 1; i < PHASE_COUNT; i++) {
+        sprintf(number, "%s\n    \"%s\": {\"seconds\": %.9f, \"counters\": ", first ? "" : ",", stat_phase_names[i], seconds[i]);
+        writer_string(&out, number, 0);
+        stats_json_counters(&out, total[i]);
+        writer_char(&out, '}');
+        first = false;
+    }
+    writer_string(&out, "\n  }\n}\n", 0);
+    return writer_close(&out);
+}
+
+/* ----------------------------------------------------------------------------------
+* 설명 : 기록된 단계들을 Chrome trace event 형식(chrome://tracing, Perfetto)으로
+*        출력하는 함수이다. 단계 하나가 complete 이벤트("ph": "X") 하나가 되며
+*        카운터는 args에 넣는다.
+* 매계 : 출력할 파일 이름(NULL이면 표준출력)
+* 반환 : 정상종료 = 0, 에러 < 0
+* -----------------------------------------------------------------------------------
+*/
+static int stats_write_trace(char* file_name)
+{
+    writer out;
+    char number[256];
+
+    if (writer_open(&out, file_name) < 0)
+        return -1;
+    writer_string(&out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [", 0);
+    for (int i = 0; i < stat_event_index; i++) {
+        stat_event* event = &stat_events[i];
+        sprintf(number, "%s\n  {\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, \"cat\": ",
+            (i > 0) ? "," : "", stat_phase_names[event->phase], event->thread, event->start * 1e6, event->seconds * 1e6);
+        writer_string(&out, number, 0);
+        stats_json_string(&out, (event->source != NULL) ? event->source : "inst");
+        writer_string(&out, ", \"args\": ", 0);
+        stats_json_counters(&out, event->counter);
+        writer_char(&out, '}');
+    }
+    writer_string(&out, "\n]}\n", 0);
+    return writer_close(&out);
 }
+#endif
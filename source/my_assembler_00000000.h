@@ -1,10 +1,55 @@
 /* 
  * my_assembler 함수를 위한 변수 선언 및 매크로를 담고 있는 헤더 파일이다. 
  */
-#define MAX_INST 256
-#define MAX_LINES 5000
 #define MAX_OPERAND 3
 
+/*
+ * 테이블들은 고정 크기 배열 대신 필요할 때마다 두 배씩 늘어나는 배열로 관리한다.
+ * RESERVE_TABLE(table, capacity, need)은 table[need - 1]까지 쓸 수 있도록 용량을 확보한다.
+ */
+#define RESERVE_TABLE(table, capacity, need) \
+    ((table) = reserve_table((table), &(capacity), (need), sizeof(*(table))))
+void* reserve_table(void* table, int* capacity, int need, size_t unit);
+
+/*
+ * RECYCLE_TABLE(table, capacity, keep)은 어셈블리가 끝난 테이블을 비운다.
+ * keep이 true이고 테이블이 RECYCLE_TABLE_LIMIT byte 이하이면 0으로 채워 다음 어셈블리에서
+ * 다시 사용하고(RESERVE_TABLE로 새로 늘린 부분과 같은 상태), 그렇지 않으면 해제한다.
+ */
+#define RECYCLE_TABLE_LIMIT (1024 * 1024)
+#define RECYCLE_TABLE(table, capacity, keep) \
+    ((table) = recycle_table((table), &(capacity), sizeof(*(table)), (keep)))
+void* recycle_table(void* table, int* capacity, size_t unit, bool keep);
+
+/*
+ * 한 번의 어셈블리 동안 필요한 문자열과 구조체(토큰, 소스 라인, M 레코드 정보)를
+ * 할당하기 위한 bump allocator(arena)이다. 큰 블록을 받아 앞에서부터 잘라 쓰고,
+ * 어셈블리가 끝나면 release_my_assembler()에서 블록 단위로 한 번에 해제한다.
+ */
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+struct arena_block
+{
+    struct arena_block* next;   //이전에 할당받은 블록
+    size_t used;                //사용한 byte 수
+    size_t size;                //data의 크기
+    char data[];
+};
+
+struct arena_unit
+{
+    struct arena_block* head;   //현재 할당 중인 블록
+    size_t total;               //할당받은 블록의 전체 크기
+};
+
+typedef struct arena_unit arena;
+
+void* arena_alloc(arena* pool, size_t size);
+char* arena_strdup(arena* pool, const char* str);
+void arena_release(arena* pool);
+void arena_reset(arena* pool);
+void arena_merge(arena* into, arena* from);
+
 /*
  * instruction 목록 파일로 부터 정보를 받아와서 생성하는 구조체 변수이다.
  * 구조는 각자의 instruction set의 양식에 맞춰 직접 구현하되
@@ -20,14 +65,75 @@ struct inst_unit
 
 // instruction의 정보를 가진 구조체를 관리하는 테이블 생성
 typedef struct inst_unit inst;
-inst *inst_table[MAX_INST];
+inst **inst_table;
 int inst_index;
+static int inst_capacity;   //inst_table의 용량
+
+/*
+ * 기계 명령어 이름으로 inst_table의 index를 찾기 위한 해시 테이블이다.
+ * init_inst_file()에서 충돌이 없는 seed와 크기를 찾아 만들기 때문에(perfect hash)
+ * 탐색 시 한 번의 문자열 비교만으로 결과를 알 수 있다.
+ * 슬롯에는 inst_table의 index + 1을 저장하고, 0은 빈 슬롯을 의미한다.
+ */
+int *inst_hash;
+unsigned int inst_hash_mask;    //해시 테이블 크기 - 1 (크기는 2의 거듭제곱)
+unsigned int inst_hash_seed;    //충돌이 없도록 선택된 seed
+unsigned long long inst_digest; //inst_table 내용의 해시 값(섹션 캐시의 key에 포함)
+
+/*
+ * 라인의 operator 종류이다. 토큰을 분리할 때 한 번만 정하고(tokenize_line())
+ * 패스1, 패스2와 섹션을 나누는 곳에서는 operator 문자열 대신 종류로 분기한다.
+ */
+enum operator_kind
+{
+    OP_NONE,            //operator가 없거나 알 수 없는 operator
+    OP_INSTRUCTION,     //기계 명령어(토큰의 opcode, format 사용)
+    OP_START, OP_CSECT, OP_END, OP_LTORG, OP_EQU, OP_RESW, OP_RESB,
+    OP_BYTE, OP_WORD, OP_EXTDEF, OP_EXTREF, OP_COUNT
+};
 
 /*
- * 어셈블리 할 소스코드를 입력받는 테이블이다. 라인 단위로 관리할 수 있다.
+ * EQU, WORD 피연산자의 수식을 후위 표기법(RPN)으로 바꾼 형태이다.
+ * 패스1에서 한 번 만들어 토큰에 저장하고, 계산할 때는 항목을 순서대로 스택에 적용한다.
+ * 상수끼리의 연산은 만들 때 미리 계산하므로 symbol과 '*'가 없는 수식은 상수 하나가 된다.
  */
-char *input_data[MAX_LINES];
-static int line_num;
+#define MAX_EXPR_DEPTH 32   //계산할 때 스택에 쌓이는 값의 최대 개수
+
+enum expr_kind
+{
+    EXPR_CONST,         //상수(value)
+    EXPR_SYMBOL,        //symbol(value는 이름 ID, ctx->names에 없는 이름이면 -1)
+    EXPR_LOCCTR,        //현재 주소('*')
+    EXPR_ADD, EXPR_SUB, EXPR_MUL, EXPR_DIV, EXPR_NEG
+};
+
+//수식 결과의 종류
+enum expr_class
+{
+    EXPR_ABSOLUTE,      //상수(주소가 아닌 값)
+    EXPR_RELATIVE,      //섹션 안의 주소
+    EXPR_EXTERNAL,      //섹션에 없는 symbol을 사용(M 레코드로 채운다)
+    EXPR_INVALID        //주소끼리 더하거나 곱하는 등 나타낼 수 없는 수식
+};
+
+struct expr_item_unit
+{
+    char kind;          //항목 종류(enum expr_kind)
+    char sign;          //symbol, '*'가 결과에 더해지는 부호(+1, -1), 곱하기/나누기 안에 있으면 0
+    int value;          //상수 값 또는 symbol 이름 ID
+    char *name;         //symbol 이름(M 레코드에 사용)
+};
+
+typedef struct expr_item_unit expr_item;
+
+struct expression_unit
+{
+    expr_item *item;    //후위 표기법 순서의 항목
+    int count;          //항목 개수(문법 오류이면 0)
+    int symbol_count;   //symbol 항목 개수
+};
+
+typedef struct expression_unit expression;
 
 /*
  * 어셈블리 할 소스코드를 토큰단위로 관리하기 위한 구조체 변수이다.
@@ -41,76 +147,1114 @@ struct token_unit
 	char *operand[MAX_OPERAND]; //명령어 라인 중 operand
 	char *comment;				//명령어 라인 중 comment
 	char nixbpe;				//하위 6bit 사용 : _ _ n i x b p e
+    int addr;                   //라인의 시작 주소(패스1에서 계산)
+    int size;                   //라인이 차지하는 byte 수
+    int label_id;               //label의 이름 ID(없거나 "."이면 -1)
+    int operand_id[MAX_OPERAND];    //operand 문자열 그대로의 이름 ID(없거나 '#'으로 시작하면 -1)
+    char kind;                  //operator의 종류(enum operator_kind)
+    char format;                //기계 명령어의 byte 형식(1~4, '+'가 붙은 3-byte format이면 4)
+    int opcode;                 //기계 명령어의 inst_table index(기계 명령어가 아니면 -1)
+    expression *expr;           //EQU, WORD 피연산자의 수식(처음 사용할 때 만든다)
 };
 
 typedef struct token_unit token;
-token *token_table[MAX_LINES];
-static int token_line;
 
 /*
  * 심볼을 관리하는 구조체이다.
  * 심볼 테이블은 심볼 이름, 심볼의 위치로 구성된다.
+ * 이름은 names의 ID로 저장한다.(캐시 파일에서는 문자열 영역의 offset)
  */
 struct symbol_unit
 {
-	char symbol[10];
+	int name;
 	int addr;
     int code_num;
+    bool absolute;      //EQU 수식의 결과가 상수이면 true(섹션 안의 주소가 아닌 값)
 };
 
 typedef struct symbol_unit symbol;
-symbol sym_table[MAX_LINES];
-static int sym_index;       //sym_table에 접근하기 위한 index 변수
+
+/*
+ * 심볼 이름(ID)으로 sym_table의 index를 찾기 위한 open addressing 해시 테이블이다.
+ * 슬롯에는 sym_table의 index + 1을 저장하고, 0은 빈 슬롯을 의미한다.
+ * 같은 이름이 여러 번 정의되면 먼저 정의된 심볼을 가리킨다.
+ */
+struct sym_hash_unit
+{
+    int *slot;          //슬롯 배열
+    unsigned int mask;  //슬롯 개수 - 1 (슬롯 개수는 2의 거듭제곱)
+    int count;          //저장된 심볼 개수
+};
+
+typedef struct sym_hash_unit sym_hash;
+
+/*
+ * 이름(label, 피연산자, EXTREF 변수, 리터럴)마다 0부터 차례로 ID를 붙이는 문자열 테이블이다.
+ * 같은 이름은 항상 같은 ID를 가지므로 심볼, 리터럴, EXTREF 변수는 ID만 저장하고 정수로 비교한다.
+ * 슬롯에는 ID + 1과 해시 값을 함께 저장하여 해시 값이 다르면 이름을 읽지 않고 넘어간다.
+ * ID가 0부터 빈틈없이 붙으므로 ID별 정보는 해시 테이블 대신 배열로 찾는다.(name_symbol 등)
+ */
+struct intern_entry_unit
+{
+    char *name;             //이름(입력 라인이나 arena의 문자열을 가리킨다)
+    unsigned int hash;      //hash_string(name, 0)(다른 테이블로 옮길 때 다시 계산하지 않는다)
+};
+
+struct intern_slot_unit
+{
+    int id;                 //ID + 1(0이면 빈 슬롯)
+    unsigned int hash;      //이름의 해시 값
+};
+
+struct intern_table_unit
+{
+    struct intern_entry_unit *entry;    //ID -> 이름
+    int count;              //저장된 이름 개수(다음에 붙일 ID)
+    int capacity;           //entry의 용량
+    struct intern_slot_unit *slot;      //슬롯 배열
+    unsigned int mask;      //슬롯 개수 - 1 (슬롯 개수는 2의 거듭제곱)
+};
+
+typedef struct intern_table_unit intern_table;
+
+//수식을 읽는 동안의 상태(compile_expression()에서만 사용)
+struct expr_parser_unit
+{
+    char *cursor;           //다음에 읽을 문자
+    expression *expr;       //만들고 있는 수식
+    arena *pool;            //symbol 이름을 복사할 arena
+    intern_table *names;    //이름을 추가할 문자열 테이블(NULL이면 ctx->names에서 찾기만 한다)
+    int depth;              //지금까지의 스택 깊이
+    bool error;             //문법 오류가 있으면 true
+};
+
+typedef struct expr_parser_unit expr_parser;
+
+/*
+ * 컨트롤 섹션(START/CSECT로 시작하는 루틴)을 관리하는 구조체이다.
+ * 한 섹션의 심볼은 sym_table에 연속으로 저장되므로 시작 index와 개수로 범위를 표시한다.
+ */
+struct section_unit
+{
+    int sym_start;      //sym_table에서 섹션의 첫 심볼 index
+    int sym_count;      //섹션의 심볼 개수
+    sym_hash hash;      //섹션 안에서 검색하기 위한 해시 테이블(앞 섹션에서 정의된 이름만 저장)
+    int line_start;     //token_table에서 섹션이 시작하는 라인(START/CSECT)
+    int literal_begin;  //섹션 시작 시점에 아직 주소가 배치되지 않은 첫 리터럴의 index
+};
+
+typedef struct section_unit section;
 
 /*
 * 리터럴을 관리하는 구조체이다.
 * 리터럴 테이블은 리터럴의 이름, 리터럴의 위치로 구성된다.
+* 리터럴의 byte 수와 값은 패스1에서 처음 추가할 때 한 번만 계산한다.(decode_literal())
+* 같은 리터럴도 LTORG/END로 배치되는 범위가 다르면 범위마다 따로 추가한다.
 */
 struct literal_unit
 {
-	char literal[10];
+	int name;       //리터럴 이름("=C'EOF'")의 ID(캐시 파일에서는 문자열 영역의 offset)
 	int addr;
+    int pool_line;  //리터럴이 배치되는 LTORG/END 라인(아직 배치되지 않았으면 -1)
+    int length;     //리터럴의 byte 수
+    int value;      //리터럴의 object code
+    int prev;       //같은 이름을 가진 앞 LTORG 범위 리터럴의 index(없으면 -1)
 };
 
 typedef struct literal_unit literal;
-literal literal_table[MAX_LINES];
-static int literal_start;   //루틴별 시작 index 정보를 저장하기 위한 변수
-static int literal_index;   //literal_table에 접근하기 위한 index 변수
 
 /*
 * 오브젝트 코드를 관리하는 구조체이다.
 * 오브젝트 코드 테이블은 오브젝트 코드의 포맷, 주소, 코드, token_table에서의 index, 레코드 등으로 구성된다.
+* 레코드를 만들 때 순서대로 읽는 값만 두고(16byte), M 레코드는 modify_table에 따로 저장한다.
 */
 struct object_code
 {
-    int format;     //포맷
     int addr;       //주소
-    int code;       //코드
+    int code;       //코드(H 레코드이면 루틴의 첫 M 레코드의 modify_table index)
     int line_index; //token_table에서의 index
+    short format;   //포맷
     char record;    //레코드
-    char* modify;   //M 레코드일 때 정보
 };
 
 typedef struct object_code code;
-code code_table[MAX_LINES];     //오브젝트 코드 테이블
-static int code_index;          //code_table에 접근하기 위한 index 변수
 
-static int prevLoc;         //이전 주소를 저장하는 변수
-static int locctr;
+/*
+* M 레코드를 관리하는 구조체이다.
+* 섹션 순서대로 저장하며, 루틴의 M 레코드는 H 레코드의 code부터 다음 H 레코드의 code 이전까지이다.
+*/
+struct modify_unit
+{
+    int addr;       //고칠 주소
+    int format;     //고칠 half-byte 개수
+    char* name;     //부호('+', '-')와 외부 심볼 이름
+};
+
+typedef struct modify_unit modify;
+
+/*
+ * 컨트롤 섹션 단위의 결과 캐시이다. 섹션의 소스 라인과 inst_table의 해시 값을 key로
+ * cache_dir/<key>.sec 파일에 패스1의 심볼, 리터럴과 패스2의 코드를 저장해 두고,
+ * 다음 어셈블에서 같은 섹션을 만나면 다시 계산하지 않고 그대로 사용한다.
+ * 파일은 cache_header, symbol[symbol_count], literal[literal_count], int[name_count],
+ * cache_code[code_count], 문자열 영역(string_size) 순서로 저장한다.
+ */
+struct cache_header_unit
+{
+    char magic[8];          //CACHE_MAGIC
+    unsigned long long key; //섹션 라인과 inst_table의 해시 값
+    unsigned long long checksum;    //머리부 뒤의 내용 전체의 해시 값(손상된 파일 확인)
+    int line_count;         //섹션의 라인 수
+    int symbol_count;       //섹션의 심볼 개수
+    int literal_count;      //섹션의 리터럴 개수(pool_line은 섹션 안에서의 라인 번호)
+    int name_count;         //EQU 수식에서 전체 심볼을 검색한 이름의 개수
+    int code_count;         //섹션의 오브젝트 코드 개수
+    int locctr;             //섹션의 길이
+    int boundary_addr;      //LTORG/END에서 다음 섹션의 리터럴과 비교한 주소(없으면 -1)
+    int string_size;        //문자열 영역의 크기
+};
+
+typedef struct cache_header_unit cache_header;
+
+struct cache_code_unit
+{
+    int format;
+    int addr;
+    int code;
+    int line_index;         //섹션 안에서의 라인 번호
+    int modify;             //M 레코드이면 문자열의 문자열 영역 offset(없으면 -1)
+    char record;
+};
+
+typedef struct cache_code_unit cache_code;
+
+/*
+ * 소스를 START/CSECT 라인 기준으로 나눈 섹션별 캐시 정보이다.
+ * data가 NULL이 아니면 캐시 파일을 그대로 사용(replay)하는 섹션이다.
+ */
+struct section_cache_unit
+{
+    int line_start;         //섹션의 첫 라인(START/CSECT)
+    int line_end;           //섹션의 마지막 라인 + 1
+    unsigned long long key;
+    bool cacheable;         //결과를 캐시에 저장해도 되는 섹션이면 true
+    char *data;             //읽어들인 캐시 파일(사용하지 않으면 NULL)
+    cache_header *header;
+    symbol *symbols;
+    literal *literals;
+    int *names;
+    cache_code *codes;
+    char *strings;
+};
+
+typedef struct section_cache_unit section_cache;
+
+/*
+ * 캐시를 검증할 때 앞의 섹션들이 정의한 이름(label, 리터럴)을 찾기 위한 해시 테이블이다.
+ * owner에는 이름을 처음 정의한 섹션 번호를 저장한다.
+ */
+struct name_slot_unit
+{
+    char *name;
+    int owner;
+};
+
+struct name_set_unit
+{
+    struct name_slot_unit *slot;
+    unsigned int mask;      //해시 테이블 크기 - 1
+    int count;
+};
+
+typedef struct name_set_unit name_set;
+
+/*
+ * 단계별 시간과 카운터(탐색 횟수, 할당, 레코드 수 등)를 기록하는 통계 기능이다.
+ * -DSICXE_STATS로 빌드한 경우에만 동작하고, 그렇지 않으면 STAT_* 매크로가 빈 문장이 된다.
+ * 단계는 STAT_PHASE(단계)에서 시작하여 다음 STAT_PHASE()에서 끝나며, 카운터는 현재
+ * 어셈블리(ctx)가 진행 중인 단계에 더해진다.
+ */
+enum stat_phase
+{
+    PHASE_NONE, PHASE_INST, PHASE_INPUT, PHASE_PASS1, PHASE_SYMTAB,
+    PHASE_LITERAL, PHASE_PASS2, PHASE_OBJECT, PHASE_LOAD, PHASE_COUNT
+};
+
+enum stat_counter
+{
+    STAT_OPCODE_SEARCH,     //search_opcode() 호출 횟수
+    STAT_OPCODE_PROBE,      //search_opcode()에서 명령어 이름을 비교한 횟수
+    STAT_SYMBOL_SEARCH,     //symbol 해시 테이블 검색 횟수
+    STAT_SYMBOL_PROBE,      //symbol 해시 테이블에서 확인한 슬롯 개수
+    STAT_ALLOC,             //arena 할당과 테이블 확장 횟수
+    STAT_ALLOC_BYTES,       //할당한 byte 수
+    STAT_LINES,             //읽은 소스 라인 수
+    STAT_SECTIONS,          //컨트롤 섹션 개수
+    STAT_T_RECORDS,         //출력한 T 레코드 개수
+    STAT_M_RECORDS,         //출력한 M 레코드 개수
+    STAT_COUNT
+};
+
+#ifdef SICXE_STATS
+struct stats_unit
+{
+    int phase;                      //진행 중인 단계(PHASE_NONE이면 기록하지 않음)
+    double start;                   //단계를 시작한 시각
+    long long counter[STAT_COUNT];  //진행 중인 단계의 카운터
+    const char *source;             //어셈블 중인 소스 파일
+};
+
+typedef struct stats_unit stats;
+
+//끝난 단계 하나의 기록(통계 파일과 trace 파일로 출력)
+struct stat_event_unit
+{
+    int phase;
+    const char *source;
+    int thread;                     //단계를 수행한 스레드 번호
+    double start;                   //프로그램 시작 후 경과한 시간(초)
+    double seconds;
+    long long counter[STAT_COUNT];
+    long peak_kb;                   //단계가 끝났을 때까지의 최대 메모리 사용량(KB)
+};
+
+typedef struct stat_event_unit stat_event;
+static stat_event *stat_events;
+static int stat_event_index;    //stat_events에 저장된 기록 개수
+static int stat_event_capacity; //stat_events의 용량
+
+#define STAT_PHASE(phase) stats_phase(phase)
+#define STAT_ADD(which, n) ((void)__atomic_fetch_add(&ctx->stats.counter[which], (long long)(n), __ATOMIC_RELAXED))
+#define STAT_SOURCE(name) ((void)(ctx->stats.source = (name)))
+#else
+#define STAT_PHASE(phase) ((void)0)
+#define STAT_ADD(which, n) ((void)0)
+#define STAT_SOURCE(name) ((void)0)
+#endif
+
+/*
+ * 매크로 본문 필드의 한 조각이다. 그대로 복사할 문자열이거나, 호출할 때 인자 값으로
+ * 바뀌는 자리(&이름) 또는 확장마다 다른 라벨 번호로 바뀌는 자리($)이다.
+ */
+#define MACRO_PIECE_TEXT -1     //param : 문자열 그대로
+#define MACRO_PIECE_UNIQUE -2   //param : $ 뒤에 확장 번호(AA, AB, ...)를 붙인다
+#define MAX_MACRO_DEPTH 16      //매크로 안에서 다른 매크로를 호출할 수 있는 깊이
+#define MAX_MACRO_NAME 64       //매크로 이름의 최대 길이 + 1
+
+struct macro_piece_unit
+{
+    char *text;         //복사할 문자열(param이 MACRO_PIECE_TEXT일 때)
+    int length;         //text의 길이
+    int param;          //바꿀 인자의 번호 또는 MACRO_PIECE_*
+};
+
+typedef struct macro_piece_unit macro_piece;
+
+//매크로 본문 필드 하나(조각이 없으면 text를 그대로 사용)
+struct macro_text_unit
+{
+    char *text;             //본문의 필드 문자열
+    macro_piece *piece;     //인자가 들어간 필드이면 조각 배열
+    int piece_count;        //조각 개수(0이면 인자가 없는 필드)
+};
+
+typedef struct macro_text_unit macro_text;
+
+/*
+ * 매크로 본문 라인의 종류이다. 정의할 때 본문 라인을 한 번만 토큰으로 분리하고,
+ * 호출할 때는 인자가 들어간 필드만 바꾸어 토큰을 바로 만든다.
+ */
+enum macro_line_kind
+{
+    MACRO_LINE_FIXED,       //인자가 없는 라인(토큰과 원본 라인을 그대로 사용)
+    MACRO_LINE_TOKEN,       //label, operand에 인자가 있는 라인(토큰을 복사한 뒤 필드만 바꿈)
+    MACRO_LINE_CALL,        //매크로를 호출하는 라인(명령어, 지시어가 아닌 operator 포함)
+    MACRO_LINE_DYNAMIC      //operator에 인자가 있는 라인(바꾼 뒤 토큰으로 분리)
+};
+
+struct macro_line_unit
+{
+    char kind;                  //라인 종류(enum macro_line_kind)
+    int call;                   //MACRO_LINE_CALL이면 호출할 매크로의 index(-1이면 확장할 때 이름으로 찾는다)
+    char *source;               //본문 라인 원본(MACRO_LINE_FIXED이면 그대로 input_data에 넣는다)
+    token *base;                //본문 라인의 토큰(MACRO_LINE_FIXED, MACRO_LINE_TOKEN)
+    macro_text field[2 + MAX_OPERAND];  //label, operator, operand(CALL, DYNAMIC이면 field[2]가 operand 필드 전체)
+};
+
+typedef struct macro_line_unit macro_line;
+
+/*
+ * MACRO ~ MEND로 정의한 매크로이다. 인자는 위치 인자(&A)와 기본값이 있는
+ * keyword 인자(&K=값)를 함께 쓸 수 있다.
+ */
+struct macro_def_unit
+{
+    char *name;             //매크로 이름
+    char **param;           //인자 이름('&' 제외)
+    char **value;           //keyword 인자의 기본값(위치 인자이면 NULL)
+    int param_count;        //인자 개수
+    macro_line *line;       //본문 라인
+    int line_count;         //본문 라인 개수
+    int line_capacity;      //line의 용량
+    bool unique;            //$ 라벨이 있어 확장할 때마다 결과가 다르면 true
+    bool pure;              //같은 인자이면 결과가 같아서 앞의 확장을 다시 사용할 수 있으면 true
+};
+
+typedef struct macro_def_unit macro_def;
+
+/*
+ * 소스 파일을 라인으로 나누면서(init_input_file()) 매크로 정의를 모으고 호출을 확장하는
+ * 매크로 처리기의 상태이다. 같은 매크로를 같은 label, 인자로 다시 호출하면 앞에서
+ * 확장한 라인 범위(memo)를 그대로 다시 사용한다.
+ */
+struct macro_processor_unit
+{
+    macro_def *def;         //정의된 매크로(다시 정의하면 새 index에 추가)
+    int count;              //정의된 매크로 개수
+    int capacity;           //def의 용량
+    intern_table names;     //매크로 이름의 ID
+    int *named;             //매크로 이름 ID -> 마지막으로 정의된 매크로의 index
+    int named_capacity;     //named의 용량
+    macro_def *defining;    //MEND를 만날 때까지 본문을 모으고 있는 매크로
+    intern_table memo;      //"매크로 index, label, 인자" 문자열의 ID
+    int *memo_line;         //memo ID -> 확장 결과의 첫 라인과 라인 개수
+    int memo_capacity;      //memo_line의 용량
+    char *key;              //memo 문자열을 만드는 버퍼
+    int key_capacity;       //key의 용량
+    int serial;             //$ 라벨을 쓰는 매크로를 확장한 횟수
+};
+
+typedef struct macro_processor_unit macro_processor;
+
+/*
+ * 어셈블리 한 번(소스 파일 하나)에 필요한 테이블과 상태를 모아놓은 구조체이다.
+ * 여러 소스 파일을 동시에 어셈블할 수 있도록 파일마다 따로 가지며, 현재 스레드가
+ * 처리 중인 어셈블리는 ctx가 가리킨다. inst_table은 모든 어셈블리가 함께 읽기만 한다.
+ */
+struct assembly_unit
+{
+    //어셈블리 할 소스코드를 입력받는 테이블이다. 라인 단위로 관리할 수 있다.
+    char **input_data;
+    int line_num;
+    int input_capacity;         //input_data의 용량
+    char *input_text;           //소스 파일 전체(mmap으로 매핑했거나 읽어들인 버퍼)
+    size_t input_text_size;     //input_text의 크기
+    bool input_mapped;          //input_text가 mmap으로 매핑된 경우 true
+    token **macro_token;        //매크로를 확장한 라인의 토큰(소스 라인이면 NULL, 매크로를 쓰지 않으면 배열도 NULL)
+    int macro_token_capacity;   //macro_token의 용량
+
+    //토큰 테이블
+    token **token_table;
+    int token_line;
+    int token_capacity;         //token_table의 용량
+
+    //심볼 테이블과 컨트롤 섹션 테이블
+    symbol *sym_table;
+    int sym_index;              //sym_table에 접근하기 위한 index 변수
+    int sym_capacity;           //sym_table의 용량
+    intern_table names;         //심볼, 리터럴, EXTREF 변수의 이름 ID
+    int *name_symbol;           //이름 ID -> 그 이름으로 처음 정의된 심볼의 sym_table index + 1
+    int name_symbol_capacity;   //name_symbol의 용량
+    section *section_table;
+    int section_index;          //section_table에 저장된 섹션 개수
+    int section_capacity;       //section_table의 용량
+
+    //리터럴 테이블
+    literal *literal_table;
+    int literal_start;          //루틴별 시작 index 정보를 저장하기 위한 변수
+    int literal_index;          //literal_table에 저장된 리터럴 개수
+    int literal_pooled;         //LTORG/END 라인이 정해진 리터럴 개수
+    int literal_capacity;       //literal_table의 용량
+    int *name_literal;          //리터럴 이름 ID -> 가장 나중에 추가된 literal_table의 index + 1
+    int name_literal_capacity;  //name_literal의 용량
+
+    //오브젝트 코드 테이블
+    code *code_table;
+    int code_index;             //code_table에 접근하기 위한 index 변수
+    int code_capacity;          //code_table의 용량
+    modify *modify_table;       //M 레코드 테이블
+    int modify_index;           //modify_table에 저장된 M 레코드 개수
+    int modify_capacity;        //modify_table의 용량
+
+    //섹션 캐시(cache_dir이 정해진 경우에만 사용)
+    section_cache *cache_table;
+    int cache_count;            //cache_table에 저장된 섹션 개수
+    int cache_capacity;         //cache_table의 용량
+
+    int prevLoc;                //이전 주소를 저장하는 변수
+    int locctr;
+    arena asm_arena;            //어셈블리 한 번에 사용하는 arena
+    struct writer_unit *capture;    //서버 모드에서 출력 파일 대신 결과를 모을 writer(enum output_kind 순서, NULL이면 파일로 출력)
+    bool keep_tables;           //서버 모드에서 어셈블리가 끝나도 테이블과 arena 블록을 남겨 다음 요청에서 다시 사용하면 true
+#ifdef SICXE_STATS
+    stats stats;                //단계별 통계(STAT_* 매크로)
+#endif
+};
+
+typedef struct assembly_unit assembly;
+assembly main_assembly;                         //소스 파일 하나만 어셈블할 때 사용하는 상태
+_Thread_local assembly *ctx = &main_assembly;   //현재 스레드가 처리 중인 어셈블리
+
+/*
+ * 패스2를 섹션 단위로 나누어 처리하기 위한 구조체이다.
+ * 섹션마다 자신만의 코드 버퍼와 arena를 가지므로 서로 다른 스레드에서 동시에 처리할 수 있고,
+ * 모든 섹션이 끝나면 소스 순서대로 code_table에 이어 붙인다.
+ */
+struct pass2_unit
+{
+    int section;        //섹션 번호(search_symbol의 subRoutine, 첫 섹션 이전 라인이면 -1)
+    int line_start;     //처리할 첫 라인
+    int line_end;       //처리할 마지막 라인 + 1
+    int literal_cursor; //LTORG, END에서 배치할 다음 리터럴의 index
+    int literal_end;    //다음 섹션의 첫 리터럴 index(섹션 캐시에서 사용, 파이프라인 모드에서는
+                        //패스2를 수행할 때의 리터럴 개수이며 아직 수행하지 않았으면 -1)
+    int boundary_check; //LTORG/END에서 literal_end의 리터럴과 비교한 횟수
+    int boundary_addr;  //마지막으로 비교한 주소
+    int locctr;         //처리가 끝난 뒤 섹션의 길이
+    code* code_table;   //섹션의 오브젝트 코드 버퍼
+    int code_index;     //code_table에 저장된 코드 개수
+    int code_capacity;  //code_table의 용량
+    modify* modify_table;   //섹션의 M 레코드 버퍼
+    int modify_index;   //modify_table에 저장된 M 레코드 개수
+    int modify_capacity;    //modify_table의 용량
+    arena pool;         //섹션에서 사용하는 arena(M 레코드 문자열 등)
+    int* define_addr;   //파이프라인 모드에서 D 레코드 심볼들의 주소(출력 스레드가 심볼 테이블을 읽지 않도록 미리 찾아둔다)
+    int extref[MAX_OPERAND];    //EXTREF 변수의 이름 ID
+    int extref_count;   //extref에 저장된 변수 개수
+    int start_index;    //섹션의 H 레코드 index(아직 없으면 -1)
+    bool error;         //나타낼 수 없는 WORD 수식 등 인코딩 중 에러가 있으면 true
+    intern_table names; //파이프라인 모드에서 토큰 분리 스레드가 섹션에서 처음 본 이름(intern_merge()로 옮긴다)
+};
+
+typedef struct pass2_unit pass2;
+
+/*
+ * 패스1을 여러 스레드에서 나누어 처리하기 위해 라인들을 나눈 구간이다.
+ * 구간별 크기 합(total)과 구간의 시작 주소(carry)로 라인별 주소를 prefix sum으로 계산한다.
+ */
+struct pass1_chunk_unit
+{
+    int line_start;     //구간의 첫 라인
+    int line_end;       //구간의 마지막 라인 + 1
+    int total;          //구간의 크기 합(CSECT가 있으면 마지막 CSECT부터의 합)
+    bool reset;         //구간 안에 CSECT가 있으면 true
+    int carry;          //구간이 시작할 때의 주소
+    bool error;         //토큰 분리 중 에러가 있으면 true
+    intern_table names; //구간에서 처음 본 이름(토큰 분리가 끝나면 intern_merge()로 옮긴다)
+};
+
+typedef struct pass1_chunk_unit pass1_chunk;
+
+/*
+ * 파이프라인 모드에서 단계 사이에 섹션(pass2)을 넘겨주는 크기가 정해진 큐이다.
+ * 가득 차면 넣는 쪽이, 비어 있으면 꺼내는 쪽이 기다리므로 앞 단계가 너무 앞서가지 않는다.
+ */
+#define PIPE_QUEUE_SIZE 8
+
+struct pipe_queue_unit
+{
+    pthread_mutex_t lock;
+    pthread_cond_t changed;         //넣거나 꺼내거나 닫을 때 알림
+    pass2* item[PIPE_QUEUE_SIZE];
+    int head;                       //다음에 꺼낼 위치
+    int count;                      //큐에 들어있는 섹션 개수
+    bool closed;                    //넣는 쪽이 끝났으면 true
+};
+
+typedef struct pipe_queue_unit pipe_queue;
+
+/*
+ * 패스1, 패스2, 출력을 섹션 단위로 겹쳐서 수행하는 파이프라인 모드의 상태이다.
+ * 토큰 분리 스레드 -> tokenized -> 패스1 계산과 패스2(호출한 스레드) -> assembled -> 출력 스레드
+ * 순서로 섹션이 넘어가므로 섹션 N의 패스2와 섹션 N+1의 토큰 분리, 섹션 N-1의 출력이 동시에 진행된다.
+ */
+struct pipeline_unit
+{
+    assembly* owner;        //세 단계가 함께 사용하는 어셈블리
+    pipe_queue tokenized;   //토큰 분리가 끝난 섹션
+    pipe_queue assembled;   //패스2가 끝난 섹션(소스 순서)
+    char* object_file;      //오브젝트 프로그램 파일(NULL이면 표준출력)
+    bool keep_code;         //출력한 뒤에도 코드를 code_table에 모을지(로더에서 사용)
+    bool defer_prologue;    //첫 섹션 이전 라인에 코드가 있어 패스1이 끝난 뒤 패스2를 수행해야 하면 true
+    bool error;             //토큰 분리 중 에러가 있으면 true
+    bool write_error;       //출력 중 에러가 있으면 true
+    bool assemble_error;    //패스1, 패스2 계산 중 에러가 있으면 true(패스1을 수행하는 스레드만 사용)
+};
+
+typedef struct pipeline_unit pipeline;
+
+static bool pipeline_mode;  //batch 모드에서 파이프라인 모드로 어셈블하는 경우 true
+
+static bool stream_mode;    //batch 모드에서 out-of-core 모드로 어셈블하는 경우 true
+
+static bool onepass_mode;   //batch 모드에서 one-pass 모드로 어셈블하는 경우 true
+
+/*
+ * 결과 파일을 출력하기 위한 버퍼이다. 레코드를 버퍼에 모아두었다가 가득 차거나
+ * 파일을 닫을 때 write()로 한 번에 내보낸다. 버퍼는 스레드마다 하나를 계속 사용한다.
+ */
+struct writer_unit
+{
+    int fd;             //출력 파일(표준출력이면 STDOUT_FILENO, 메모리에 모으면 -1)
+    char *buffer;       //출력 버퍼(WRITER_BUFFER_SIZE byte)
+    size_t used;        //버퍼에 모인 byte 수
+    bool error;         //출력 중 에러가 있으면 true
+    char *memory;       //fd가 -1일 때 내보낸 내용(호출한 쪽에서 해제)
+    size_t memory_size;
+    int memory_capacity;
+};
+
+typedef struct writer_unit writer;
+
+//어셈블리 결과의 종류(서버 모드에서 결과를 모으는 ctx->capture의 순서)
+enum output_kind
+{
+    OUTPUT_OBJECT,      //오브젝트 프로그램
+    OUTPUT_SYMTAB,      //심볼 테이블
+    OUTPUT_LITERAL,     //리터럴 테이블
+    OUTPUT_COUNT
+};
+
+/*
+ * 서버 모드(-S)에서 Unix 도메인 소켓으로 받은 클라이언트 연결 하나이다.
+ * 요청은 한 줄의 명령(ASSEMBLE <경로>, SOURCE <크기>, SHUTDOWN)과 SOURCE이면 그 뒤의 소스 byte이고,
+ * 한 연결로 여러 요청을 차례로 보낼 수 있다.
+ */
+#define SERVER_BUFFER_SIZE 4096                 //요청을 읽는 버퍼의 크기
+#define SERVER_MIN_WORKERS 4                    //연결을 처리하는 작업 스레드의 최소 개수
+#define SERVER_MAX_SOURCE (64 * 1024 * 1024)    //SOURCE 요청으로 받을 수 있는 소스의 최대 크기
+
+struct server_conn_unit
+{
+    int fd;                             //클라이언트 소켓
+    char buffer[SERVER_BUFFER_SIZE];    //읽었지만 아직 처리하지 않은 byte
+    size_t start;                       //buffer에서 다음에 읽을 위치
+    size_t end;                         //buffer에 읽어둔 byte 수
+    bool busy;                          //요청을 처리하는 중이면 true(종료할 때 응답을 보낸 뒤 끊는다)
+};
+
+typedef struct server_conn_unit server_conn;
+static int server_fd = -1;  //서버 모드에서 연결을 기다리는 소켓
+static pthread_mutex_t server_lock = PTHREAD_MUTEX_INITIALIZER;    //server_stopping, server_conns를 보호
+static bool server_stopping;                //SIGINT, SIGTERM 또는 SHUTDOWN 요청을 받아 종료하는 중이면 true
+static server_conn** server_conns;  //작업 스레드별로 처리 중인 연결(없으면 NULL, 작업 스레드 수만큼 할당)
+static int server_workers;          //server_conns의 크기(작업 스레드 수)
+
+/*
+ * out-of-core 모드(-O)에서 소스 파일을 라인 단위로 읽기 위한 버퍼이다.
+ * 소스 전체를 메모리에 두지 않고 버퍼 크기만큼씩 읽으며, 버퍼보다 긴 라인을 만나면 버퍼를 늘린다.
+ */
+#define STREAM_BUFFER_SIZE (64 * 1024)
+
+struct stream_input_unit
+{
+    int fd;             //소스 파일
+    char *buffer;       //읽었지만 아직 처리하지 않은 라인들
+    int capacity;       //buffer의 크기
+    size_t start;       //buffer에서 다음 라인의 시작 위치
+    size_t end;         //buffer에 읽어둔 byte 수
+    bool eof;           //파일 끝까지 읽었으면 true
+    bool error;         //읽는 중 에러가 있으면 true
+};
+
+typedef struct stream_input_unit stream_input;
+
+/*
+ * out-of-core 모드에서 패스1이 임시 파일(중간 파일)에 쓰고 패스2가 다시 읽는 라인 레코드이다.
+ * 패스2에서 코드를 만들거나 주소를 바꾸는 라인만 저장하며, 레코드 뒤에 label(START/CSECT만),
+ * operator, operand 문자열을 '\0'으로 끝나게 이어서 text_size byte만큼 저장한다.
+ * 패스2의 token_table은 두 칸(섹션의 START/CSECT 라인, 현재 라인)만 사용한다.
+ */
+#define STREAM_SECTION_SLOT 0   //섹션의 START/CSECT 라인(H 레코드와 WORD의 M 레코드에서 섹션 이름으로 사용)
+#define STREAM_LINE_SLOT 1      //현재 라인
+#define STREAM_SLOT_COUNT 2
+
+struct stream_record_unit
+{
+    int line;                       //소스에서의 라인 번호(섹션을 나눌 때 사용)
+    int opcode;                     //기계 명령어의 inst_table index
+    int operand_id[MAX_OPERAND];    //operand의 이름 ID
+    int text_size;                  //레코드 뒤에 저장한 문자열의 byte 수
+    char kind;                      //operator의 종류(enum operator_kind)
+    char format;                    //기계 명령어의 byte 형식
+};
+
+typedef struct stream_record_unit stream_record;
+
+/*
+ * one-pass 모드(-1)에서 아직 값을 모르는 symbol이나 리터럴을 참조하여 나중에 고쳐야 하는 코드(fixup)이다.
+ * 라인을 읽는 즉시 코드를 만들고, 뒤에서 정의될 symbol(같은 섹션)이나 LTORG/END에서 주소가
+ * 정해질 리터럴을 참조한 코드는 fixup으로 남겨두었다가 값이 정해지면 그 코드를 고친다(backpatching).
+ * 이름(또는 리터럴)마다 기다리는 fixup들을 fixup_link로 연결(chain)해 둔다.
+ */
+enum fixup_kind
+{
+    FIXUP_DISP,         //3-byte format의 displacement(하위 12 bit)
+    FIXUP_WORD,         //WORD의 값과 M 레코드(수식의 symbol이 모두 정해지면 계산)
+    FIXUP_DEFINE        //EXTDEF의 D 레코드(출력할 때 심볼의 주소를 찾으므로 모두 정의될 때까지 출력하지 않음)
+};
+
+struct fixup_unit
+{
+    int code;           //섹션에서의 코드 순번(출력한 코드 수 flushed를 빼면 code_table의 index)
+    int kind;           //enum fixup_kind
+    int waiting;        //아직 정해지지 않은 이름(리터럴) 수(0이면 완성)
+    expression *expr;   //WORD 수식(섹션의 arena에 있다)
+    char *operand;      //WORD 피연산자(에러 메시지에 사용)
+};
+
+typedef struct fixup_unit fixup;
+
+struct fixup_link_unit
+{
+    int fixup;          //기다리는 fixup의 index(-1이면 EXTREF로 처리한 이름이 섹션에서 정의되는지 감시)
+    int key;            //이름 ID 또는 리터럴 index
+    bool literal;       //key가 리터럴 index이면 true
+    int next;           //chain의 다음 link index + 1(0이면 끝)
+};
+
+typedef struct fixup_link_unit fixup_link;
+
+/*
+ * LTORG/END에서 리터럴을 배치한 뒤 다음 리터럴과 주소를 비교한 기록이다.
+ * 기존 방식은 모든 리터럴의 주소를 알고 비교하므로, 다음 리터럴의 주소가 정해진 뒤 같으면
+ * 결과가 달라져 기존 방식으로 다시 어셈블한다.
+ */
+struct fixup_boundary_unit
+{
+    int literal;        //비교한 리터럴의 index
+    int addr;           //비교한 주소
+};
+
+typedef struct fixup_boundary_unit fixup_boundary;
+
+/*
+ * one-pass 모드의 상태이다. 코드는 out-of-core 모드와 같이 섹션의 코드 버퍼(pass2)에 만들고,
+ * 첫 fixup 앞까지의 코드는 바로 임시 파일로 출력하므로 메모리에는 값을 기다리는 코드부터 남는다.
+ * 소스의 라인은 읽은 뒤 바로 버리고, 레코드를 출력할 때 필요한 토큰(START/CSECT, EXTDEF,
+ * EXTREF)만 섹션이 끝날 때까지 token_table의 ONEPASS_LINE_SLOT 뒤에 복사해 둔다.
+ */
+#define ONEPASS_LINE_SLOT 0     //현재 라인
+
+struct onepass_unit
+{
+    pass2 unit;                 //현재 섹션(첫 섹션 이전이면 section이 -1)
+    int flushed;                //섹션에서 임시 파일로 출력하여 code_table에서 지운 코드 수
+    int routine;                //지금까지 출력한 루틴의 번호(write_section_records()의 subRoutine)
+    fixup *fixup_table;         //섹션의 fixup(코드 순서)
+    int fixup_start;            //완성되지 않았을 수 있는 첫 fixup(이 fixup의 코드부터 출력을 미룬다)
+    int fixup_index;
+    int fixup_capacity;
+    fixup_link *link_table;     //섹션의 chain
+    int link_index;
+    int link_capacity;
+    int *name_head;             //이름 ID -> 기다리는 첫 link index + 1(0이면 없음)
+    int name_head_capacity;
+    int *literal_head;          //리터럴 index -> 기다리는 첫 link index + 1(0이면 없음)
+    int literal_head_capacity;
+    fixup_boundary *boundary_table;     //리터럴 index 순서로 추가된다
+    int boundary_start;         //아직 확인하지 않은 첫 기록
+    int boundary_index;
+    int boundary_capacity;
+    arena keep;                 //섹션이 끝날 때까지 남겨둘 토큰
+    int keep_count;             //token_table에 복사해 둔 토큰 수
+    writer object;              //끝난 섹션들의 레코드(어셈블이 끝나면 오브젝트 프로그램으로 옮긴다)
+    writer body;                //현재 섹션의 D, R, T 레코드
+    writer modify;              //현재 섹션의 M 레코드
+    int modify_sorted;          //섹션의 modify_table에서 주소 순서로 정렬된 앞부분의 개수
+    bool error;                 //인코딩 중 에러(나타낼 수 없는 WORD 수식 등)가 있으면 true
+    bool fallback;              //결과가 기존 방식과 달라질 수 있어 다시 어셈블해야 하면 true
+};
+
+typedef struct onepass_unit onepass;
+
+/*
+ * 여러 소스 파일을 한 프로세스에서 동시에 어셈블(batch 모드)하기 위한 구조체이다.
+ * 파일 하나가 스레드 풀의 작업 하나가 되며, 각자 assembly를 따로 가진다.
+ */
+struct batch_unit
+{
+    char *source;       //소스 파일 경로
+    char *object_file;  //오브젝트 프로그램을 저장할 파일 경로
+    char *symtab_file;  //심볼 테이블을 저장할 파일 경로
+    char *literal_file; //리터럴 테이블을 저장할 파일 경로
+    char *image_file;   //링킹 로더의 메모리 이미지를 저장할 파일 경로(로더를 사용하지 않으면 NULL)
+    int result;         //assemble_file()의 반환값
+};
+
+typedef struct batch_unit batch;
+static batch *batch_table;
+static int batch_index;     //batch_table에 저장된 소스 파일 개수
+static int batch_capacity;  //batch_table의 용량
+static arena batch_arena;   //batch 모드에서 사용하는 경로 문자열
+
+/*
+ * 서로 독립적인 작업(섹션, 소스 파일 등)을 여러 스레드에서 나누어 처리하기 위한 스레드 풀이다.
+ * thread_count가 0이면 처음 사용할 때 CPU 개수로 정한다(최대 MAX_THREADS).
+ */
+#define MAX_THREADS 64
+static int thread_count;
+
+static char *cache_dir;     //섹션 캐시를 저장할 디렉터리(NULL이면 캐시를 사용하지 않음)
+
+/*
+ * 링킹 로더가 만드는 메모리 이미지이다. SIC/XE의 주소 공간(1MB)을 페이지로 나누어
+ * T 레코드가 쓰는 페이지만 할당하므로 RESB, RESW로 비워둔 영역은 메모리를 차지하지 않는다.
+ */
+#define LOADER_MEMORY_SIZE (1 << 20)
+#define LOADER_PAGE_SIZE 4096
+
+struct image_unit
+{
+    unsigned char *page[LOADER_MEMORY_SIZE / LOADER_PAGE_SIZE];  //할당되지 않은 페이지는 NULL
+    int start;      //로드 주소(첫 섹션의 시작 주소)
+    int end;        //마지막 섹션의 끝 주소
+    int entry;      //실행을 시작할 주소(첫 섹션의 E 레코드)
+};
+
+typedef struct image_unit image;
+
+/*
+ * 외부 심볼 테이블(ESTAB)의 항목이다. 컨트롤 섹션 이름과 D 레코드의 심볼을 저장하며,
+ * 이름으로 찾을 때는 sym_hash와 같은 방식의 해시 테이블을 사용한다.
+ */
+struct estab_unit
+{
+    char *name;
+    int addr;       //로드된 주소
+};
+
+typedef struct estab_unit estab;
+
+static int load_address = -1;   //batch 모드에서 로더가 사용할 로드 주소(-1이면 로더를 사용하지 않음)
+
+/*
+ * 텍스트 오브젝트 프로그램(H/D/R/T/M/E 레코드)과 같은 내용을 담는 binary 오브젝트 파일이다.
+ * 파일은 objfile_header, 섹션 테이블, T 레코드 테이블, 재배치(M) 테이블, export(D) 테이블,
+ * export 해시 슬롯, import(R) 테이블, 문자열 영역, T 레코드 byte 영역 순서로 저장하고,
+ * byte 영역은 OBJFILE_ALIGN으로 정렬하여 mmap한 파일에서 그대로 읽을 수 있다.
+ * 이름은 모두 문자열 영역의 offset이며, 정수는 어셈블러를 실행한 머신의 byte 순서를 따른다.
+ */
+#define OBJFILE_MAGIC "SICXEO1"
+#define OBJFILE_ALIGN 16
+
+struct objfile_header_unit
+{
+    char magic[8];          //OBJFILE_MAGIC
+    int section_count;
+    int text_count;
+    int reloc_count;
+    int export_count;
+    int slot_count;
+    int import_count;
+    int string_size;
+    int byte_size;
+};
+
+typedef struct objfile_header_unit objfile_header;
+
+//컨트롤 섹션 하나(H, E 레코드)와 섹션에 속한 레코드들의 범위
+struct objfile_section_unit
+{
+    int name;
+    int length;
+    int entry;              //E 레코드의 주소(주소가 없는 E 레코드이면 -1)
+    int export_start, export_count;
+    int slot_start, slot_count;     //export 해시 슬롯(export index + 1, 0이면 빈 슬롯)
+    int import_start, import_count;
+    int text_start, text_count;
+    int byte_start;                 //섹션의 첫 T 레코드가 byte 영역에서 시작하는 offset
+    int reloc_start, reloc_count;   //주소 순으로 정렬
+};
+
+typedef struct objfile_section_unit objfile_section;
+
+//T 레코드 하나. 섹션의 T 레코드 내용은 byte 영역에 순서대로 이어서 저장한다.
+struct objfile_text_unit
+{
+    int addr;
+    unsigned short size;    //byte 영역에서 차지하는 byte 수
+    unsigned char length;   //T 레코드의 길이 칸
+    unsigned char raw;      //1이면 16진수 문자열을 그대로 저장(코드가 길이 칸보다 넓게 출력된 레코드)
+};
+
+typedef struct objfile_text_unit objfile_text;
+
+//M 레코드 하나
+struct objfile_reloc_unit
+{
+    int addr;
+    int name;
+    int order;              //섹션 안에서 텍스트로 출력되는 순서
+    unsigned char half_bytes;   //고칠 half-byte 개수
+    char sign;              //'+' 또는 '-'
+    short reserved;
+};
+
+typedef struct objfile_reloc_unit objfile_reloc;
+
+//D 레코드의 심볼(export), R 레코드의 심볼(import) 하나
+struct objfile_export_unit
+{
+    int name;
+    int addr;
+    int line_end;           //1이면 D 레코드 한 줄의 마지막 심볼
+};
+
+typedef struct objfile_export_unit objfile_export;
+
+struct objfile_import_unit
+{
+    int name;
+    int line_end;           //1이면 R 레코드 한 줄의 마지막 심볼
+};
+
+typedef struct objfile_import_unit objfile_import;
+
+/*
+ * 메모리에 올린 binary 오브젝트 파일이다. 텍스트에서 변환하는 중이면 테이블을 직접 할당하고,
+ * 파일에서 읽은 경우에는 mmap한 영역을 가리킨다.
+ */
+struct objfile_unit
+{
+    objfile_header header;  //테이블별 개수
+    objfile_section *sections;
+    objfile_text *texts;
+    objfile_reloc *relocs;
+    objfile_export *exports;
+    int *slots;
+    objfile_import *imports;
+    char *strings;
+    unsigned char *bytes;
+    int capacity[8];        //각 테이블의 용량(텍스트에서 변환할 때만 사용)
+    sym_hash string_hash;   //같은 이름을 한 번만 저장하기 위한 해시 테이블(텍스트에서 변환할 때만 사용)
+    void *map;              //mmap한 파일(텍스트에서 변환한 경우 NULL)
+    size_t map_size;
+};
+
+typedef struct objfile_unit objfile;
+
+static bool object_binary;  //batch 모드에서 binary 오브젝트 파일(<이름>.sxo)도 만드는 경우 true
+
 //--------------
 
 static char *input_file;
 static char *output_file;
 int init_my_assembler(void);
+//추가된 함수 : 어셈블리 한 번에 사용한 테이블과 arena를 해제하는 함수 release_my_assembler()
+void release_my_assembler(void);
 int init_inst_file(char *inst_file);
+static int build_inst_hash(void);
+static unsigned int hash_string(const char *str, unsigned int seed);
 int init_input_file(char *input_file);
+static int init_input_text(char *text, size_t size);
+static int split_input(void);
 int token_parsing(char *str);
+//추가된 함수 : 패스1을 단계별로 나누기 위해 token_parsing()의 과정을 나눈 함수들
+static int tokenize_line(char* str, token* tok);
+static int split_fields(char* str, char* tokenList[4]);
+static void classify_token(token* tok, int opcode);
+static char* scan_field(char* str, char stop1, char stop2);
+static void pool_literals(int line);
+//추가된 함수 : 리터럴을 해시 테이블로 찾고, 추가할 때 byte 수와 값을 미리 계산하는 함수들
+static int literal_find(int name, int first);
+static void literal_insert(int index);
+static void decode_literal(literal* lit);
+static int account_line(int line);
 int search_opcode(char *str);
+//추가된 함수 : operator 문자열('+' 포함)과 inst_table index로 실제 byte 형식을 알려주는 함수 search_format()
+int search_format(char *str, int opcode);
+//추가된 함수 : 지시어 이름으로 operator 종류를 알려주는 함수 search_directive()
+static int search_directive(char *str);
 //추가된 함수 : sym_table에서 해당 루틴의 symbol을 찾아 주소값을 리턴해주는 함수 search_symbol()
 int search_symbol(char* str, int subRoutine);
+int search_name(int name, int subRoutine);
+static int find_symbol(int name, int subRoutine);
+//추가된 함수 : 새 컨트롤 섹션을 시작하는 함수 begin_section(), 현재 섹션에 symbol을 추가하는 함수 insert_symbol()
+static int sym_hash_find(sym_hash* hash, int name);
+static void sym_hash_insert(sym_hash* hash, int index);
+static void begin_section(void);
+static void insert_symbol(int name, int addr, bool absolute);
 static int assem_pass1(void);
+static void pass1_tokenize_job(void* arg, int index);
+static void pass1_sum_job(void* arg, int index);
+static void pass1_address_job(void* arg, int index);
 //void make_opcode_output(char *file_name);
 void make_symtab_output(char *file_name);
 void make_literaltab_output(char *file_name);
 static int assem_pass2(void);
+//추가된 함수 : 섹션 하나의 패스2를 수행하는 함수 assem_section(), 작업을 스레드 풀에서 나누어 수행하는 함수 run_parallel()
+static void assem_section(pass2* unit);
+static void assem_section_job(void* arg, int index);
+static code* emit_code(pass2* unit, char record, int format, int addr, int line);
+static void emit_modify(pass2* unit, int format, int addr, char sign, const char* name);
+static void encode_line(pass2* unit, int line);
+static int encode_word(pass2* unit, expression* expr, int addr, const char* operand);
+static void finish_section(pass2* unit);
+void run_parallel(int count, void (*job)(void*, int), void* arg);
+int get_thread_count(void);
 void make_objectcode_output(char *file_name);
+//추가된 함수 : 결과 파일을 버퍼에 모아 출력하는 함수들
+static int writer_open(writer* out, char* file_name);
+static void writer_open_memory(writer* out);
+static void writer_flush(writer* out);
+static int output_open(writer* out, char* file_name);
+static int output_close(writer* out, int kind);
+static int writer_close(writer* out);
+static char* writer_reserve(writer* out, size_t size);
+static void writer_char(writer* out, char c);
+static void writer_bytes(writer* out, const void* data, size_t size);
+static void writer_string(writer* out, const char* str, int width);
+static void writer_hex(writer* out, int value, int digits);
+static void write_modify_record(writer* out, modify* object);
+//추가된 함수 : 섹션 하나의 레코드를 출력하는 함수 write_section_records(), 섹션의 코드를 code_table에 모으는 함수들
+static void write_section_records(writer* out, code* table, int count, modify* modify_table, int modify_count, int* subRoutine, const int* define_addr);
+static int text_record_end(code* table, int index, int count, int* length);
+static void init_pass2_unit(pass2* unit, int sectionNum);
+static void merge_section_codes(pass2* unit);
+static void end_code_table(void);
+//추가된 함수 : 패스1, 패스2, 출력을 섹션 단위로 겹쳐서 수행하는 파이프라인 모드
+static int assemble_pipelined(char *object_file, char *symtab_file, char *literal_file, bool keep_code);
+static int pipeline_advance(pipeline* pipe, pass2** units, int count, int ready, bool final);
+static void* pipeline_tokenizer(void* arg);
+static void* pipeline_writer(void* arg);
+static void pipe_init(pipe_queue* queue);
+static void pipe_push(pipe_queue* queue, pass2* unit);
+static pass2* pipe_pop(pipe_queue* queue);
+static void pipe_close(pipe_queue* queue);
+static void pipe_destroy(pipe_queue* queue);
+//추가된 함수 : 여러 소스 파일을 동시에 어셈블하는 batch 모드
+int assemble_file(char *source, char *object_file, char *symtab_file, char *literal_file, char *image_file);
+static int assemble_input(char *object_file, char *symtab_file, char *literal_file, char *image_file);
+static int batch_main(int args, char *arg[]);
+static int add_batch_source(char *path);
+static int compare_path(const void* a, const void* b);
+static void batch_job(void* arg, int index);
+//추가된 함수 : code_table을 바로 링크하여 메모리 이미지를 만드는 링킹 로더
+int load_program(image* img, int load_addr);
+void release_image(image* img);
+static int write_image(image* img, char* file_name);
+static unsigned char* image_byte(image* img, int addr);
+static int estab_find(estab* table, sym_hash* hash, char* name);
+static int estab_insert(estab* table, int* count, sym_hash* hash, char* name, int addr);
+//추가된 함수 : binary 오브젝트 파일과 텍스트 오브젝트 프로그램 사이의 변환
+static int convert_object(char* file_name, char* out_dir);
+static int parse_object_text(objfile* obj, char* text, size_t size);
+static void finish_object_section(objfile* obj);
+static void write_object_text(objfile* obj, writer* out);
+static int write_object_binary(objfile* obj, char* file_name);
+static int read_object_binary(objfile* obj, char* data, size_t size);
+static size_t object_layout(objfile_header* header, size_t offset[8]);
+static void release_object_file(objfile* obj);
+static int compare_reloc(const void* a, const void* b);
+static int object_add_string(objfile* obj, const char* str);
+static bool parse_hex(const char* str, int digits, int* value);
+//추가된 함수 : 벤치마크(단계별 처리 속도 측정)와 벤치마크용 소스 생성기
+static double now_seconds(void);
+static void bench_report(const char* stage, double seconds, long long lines, long long bytes);
+static int compare_file(char* file_name, char* ref_name);
+static long long file_size(char* file_name);
+static int bench_file(batch* unit, char* ref_dir);
+static unsigned int next_random(unsigned int* state);
+static void generate_name(char* name, char prefix, int section_num, int index);
+static int generate_source(char* spec);
+#ifdef SICXE_STATS
+//추가된 함수 : 단계별 통계를 기록하고 JSON, trace 파일로 출력하는 함수들
+static void stats_phase(int phase);
+static void stats_json_string(writer* out, const char* str);
+static void stats_json_counters(writer* out, const long long* counter);
+static int stats_write_json(char* file_name);
+static int stats_write_trace(char* file_name);
+#endif
+//추가된 함수 : 컨트롤 섹션 단위의 결과 캐시
+static unsigned long long hash_bytes(unsigned long long hash, const void* data, size_t size);
+static int section_line_kind(char* line);
+static void cache_split(void);
+static void cache_load_job(void* arg, int index);
+static int cache_validate(void);
+static int cache_tokenize(section_cache* cache, arena* pool, bool all, intern_table* names);
+static void cache_scan_line(int line, int owner, name_set* labels, bool* pending, bool* cacheable);
+static section_cache* cache_at(int* cursor, int line);
+static void cache_replay_literals(section_cache* cache);
+static void cache_replay_symbols(section_cache* cache);
+static bool cache_replay_codes(pass2* unit, section_cache* cache);
+static void cache_store(pass2* unit, section_cache* cache);
+static void cache_release(void);
+static int name_set_find(name_set* set, char* name);
+static int cache_add_string(char** strings, int* size, int* capacity, const char* str);
+static void name_set_insert(name_set* set, char* name, int owner);
+//추가된 함수 : 이름마다 정수 ID를 붙이는 문자열 테이블 함수들
+static unsigned int hash_id(int id);
+static int intern_lookup(intern_table* table, const char* str, unsigned int hash);
+static int intern_find(intern_table* table, const char* str);
+static int intern_add(intern_table* table, char* str, unsigned int hash);
+static int intern_name(intern_table* table, char* str);
+static int intern_copy(intern_table* table, const char* str);
+static void intern_token(token* tok, intern_table* names);
+static void intern_merge(intern_table* local, int line_start, int line_end);
+static void intern_release(intern_table* table);
+static void intern_reset(intern_table* table);
+//추가된 함수 : EQU, WORD 피연산자 수식을 후위 표기법으로 만들고 계산하는 함수들
+static expression* compile_expression(char* str, arena* pool, intern_table* names);
+static bool expr_apply(int kind, int left, int right, int* result);
+static void expr_emit(expr_parser* parser, int kind, int sign, int value, char* name);
+static void expr_parse_sum(expr_parser* parser, int sign);
+static void expr_parse_product(expr_parser* parser, int sign);
+static void expr_parse_unary(expr_parser* parser, int sign);
+static expression* token_expression(token* tok, arena* pool, intern_table* names);
+static int evaluate_expression(expression* expr, int subRoutine, int locctr, int missing, int* value);
+//추가된 함수 : 소스를 읽으면서 MACRO ~ MEND 정의를 모으고 호출을 토큰으로 확장하는 함수들
+static char* line_operator(char* line, size_t* length);
+static int tokenize_source(int line, token* tok);
+static int macro_feed(macro_processor* mp, char* line);
+static int macro_lookup(macro_processor* mp, char* name, size_t length);
+static int macro_define(macro_processor* mp, char* line);
+static int macro_add_line(macro_processor* mp, char* line, char* op, size_t length);
+static void macro_finish(macro_processor* mp);
+static void macro_compile_text(macro_def* def, macro_text* text, char* str);
+static char* macro_substitute(macro_text* text, char** values, const char* serial);
+static int macro_expand(macro_processor* mp, int index, char* label, char* args, int depth);
+static int macro_bind(macro_def* def, char* args, char** values);
+static void macro_append(char* text, token* tok);
+static char* macro_render(token* tok);
+static void macro_release(macro_processor* mp);
+//추가된 함수 : Unix 도메인 소켓으로 어셈블 요청을 받는 서버 모드
+static int server_main(char* path);
+static void server_stop(void);
+static void* server_worker(void* arg);
+static void server_client(server_conn* conn);
+static int server_request(server_conn* conn, char* line);
+static ssize_t server_fill(server_conn* conn);
+static int server_read_line(server_conn* conn, char* line, size_t size);
+static int server_read(server_conn* conn, char* data, size_t size);
+//추가된 함수 : 소스 길이와 관계없이 심볼 수에 비례하는 메모리로 어셈블하는 out-of-core 모드
+static int assemble_streamed(char* source, char* object_file, char* symtab_file, char* literal_file);
+static int stream_pass1(stream_input* in, FILE* temp);
+static void stream_intern(token* tok);
+static bool stream_keeps_line(int kind);
+static void stream_write_record(FILE* temp, token* tok, int line);
+static int stream_pass2(FILE* temp, char* object_file);
+static int stream_load_token(FILE* temp, stream_record* record, token* tok, char** text, int* capacity);
+static void stream_flush_codes(pass2* unit, writer* body, writer* modify, int subRoutine, bool final);
+static int stream_complete_codes(code* table, int count);
+static void stream_close_unit(pass2* unit, writer* out, writer* body, writer* modify, int* subRoutine);
+static char* stream_read_line(stream_input* in);
+static int stream_temp_file(void);
+static int spool_open(writer* out);
+static void spool_copy(writer* from, writer* to);
+static void spool_close(writer* out);
+//추가된 함수 : 라인을 읽으면서 바로 코드를 만들고 앞으로의 참조는 나중에 고치는 one-pass 모드
+static int assemble_onepass(char* source, char* object_file, char* symtab_file, char* literal_file);
+static int onepass_run(onepass* op, stream_input* in);
+static void onepass_open_section(onepass* op);
+static void onepass_close_section(onepass* op);
+static int onepass_keep(onepass* op, token* tok);
+static void onepass_encode(onepass* op, int slot);
+static int onepass_add(onepass* op, int kind, int waiting);
+static void onepass_wait(onepass* op, int index, int key, bool literal);
+static void onepass_resolve(onepass* op, int head, int value);
+static void onepass_define(onepass* op, int name);
+static void onepass_place(onepass* op, int literal);
+static bool onepass_extref(pass2* unit, int name);
+static void onepass_flush(onepass* op, bool final);
+static void onepass_release(onepass* op);
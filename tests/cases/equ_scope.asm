@@ -0,0 +1,11 @@
+EQA	START	0
+	EXTDEF	FOO
+LOOP	RESW	3
+FOO	RESW	1
+	J	LOOP
+EQB	CSECT
+	LDA	#0
+LOOP	RESW	1
+LEN	EQU	*-LOOP
+	WORD	LEN
+	END	LOOP
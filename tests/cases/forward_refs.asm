@@ -0,0 +1,27 @@
+FR	START	0
+	EXTDEF	BUF,LEN
+	EXTREF	RD
+FIRST	LDA	LEN
+	STA	BUF,X
+	J	@RETADR
+	LDA	=C'EOF'
+	COMP	=X'05'
+	+JSUB	RD
+	WORD	LEN-FIRST
+	WORD	BUF+3
+	WORD	RD-BUF
+	LTORG
+	STA	TAIL
+RETADR	RESW	1
+LEN	WORD	3
+BUF	RESB	10
+TAIL	EQU	*
+	COMP	TAIL
+SUB	CSECT
+	EXTREF	BUF
+	LDA	LATER
+	WORD	LATER
+	WORD	BUF-LATER
+	TD	=X'F1'
+LATER	RESW	1
+	END	FIRST
@@ -0,0 +1,7 @@
+LA	START	0
+	LDA	=C'EOF'
+	J	NEXT
+NEXT	RSUB
+LB	CSECT
+	TD	=X'05'
+	END
@@ -0,0 +1,10 @@
+LA	START	0
+	TD	=X'05'
+	LDA	=C'AB'
+	LTORG
+	STA	=C'AB'
+	LTORG
+LB	CSECT
+	WD	=X'05'
+	TD	=X'05'
+	END
@@ -0,0 +1,7 @@
+LONGN	START	0
+	EXTREF	OTHER
+A_VERY_LONG_LOCAL_LABEL_NAME	LDA	ANOTHER_LONG_LOCAL_LABEL_NAME
+	J	A_VERY_LONG_LOCAL_LABEL_NAME
+	+JSUB	OTHER
+ANOTHER_LONG_LOCAL_LABEL_NAME	WORD	A_VERY_LONG_LOCAL_LABEL_NAME
+	END
@@ -0,0 +1,11 @@
+WR	START	0
+	EXTDEF	B
+A	RESW	1
+B	RESW	1
+C	WORD	B
+G	WORD	C
+WX	CSECT
+	EXTREF	B
+D	WORD	B+3
+E	WORD	B-D
+	END	A
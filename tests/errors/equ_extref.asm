@@ -0,0 +1,8 @@
+EXA	START	0
+	EXTDEF	FOO
+FOO	RESW	1
+EXB	CSECT
+	EXTREF	FOO
+X	EQU	FOO
+	WORD	X
+	END
@@ -0,0 +1,5 @@
+FIRST	START	0
+	RESW	1
+SECONDSECTION	CSECT
+	RESW	1
+	END
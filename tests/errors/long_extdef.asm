@@ -0,0 +1,5 @@
+LONG	START	0
+	EXTDEF	SHORT,DVERYLONGSYMBOLNAME
+SHORT	RESW	1
+DVERYLONGSYMBOLNAME	RESW	1
+	END
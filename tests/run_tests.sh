@@ -0,0 +1,224 @@
+#!/bin/bash
+#
+# 화일명 : run_tests.sh
+# 설  명 : 어셈블러를 빌드하여 모드별 결과를 기준 파일과 비교하는 검사 스크립트이다.
+#          1. 인자 없이 실행한 결과를 source/의 기준 파일(output/symtab/literaltab)과 비교한다.
+#          2. batch 모드의 각 모드(-p, -O, -1, -c, -B)로 같은 소스를 어셈블하여 기준과 비교한다.
+#             -L 0으로 로드한 메모리 이미지는 tests/input.img.txt(od -Ax -tx1 형식)와 비교한다.
+#          3. -g로 만든 소스를 각 모드로 어셈블하여 결과가 기본 모드와 같은지 비교한다.
+#          4. tests/cases/의 소스(*.asm)를 각 모드로 어셈블하여 같은 이름의 기준 파일
+#             (*.obj, *.sym, *.lit 중 있는 것)과 비교한다. *.img.txt가 있으면 -L 1000으로
+#             로드한 이미지도 비교한다.
+#          5. tests/errors/의 소스는 어셈블에 실패하고 같은 이름의 *.msg에 적힌 메시지를
+#             출력해야 한다.
+#          6. 서버 모드(-S)에서 위의 소스들을 한 연결로 차례로 어셈블하여 batch 결과와 비교하고,
+#             소켓 권한(0600), 너무 큰 SOURCE 거절, SHUTDOWN 요청으로 종료되는지 확인한다.
+#             (python3이 없으면 건너뛴다)
+# 사용법 : tests/run_tests.sh   (CC로 컴파일러를, ASM으로 이미 빌드한 실행 파일을 지정할 수 있다)
+#
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+SOURCE_DIR=$ROOT/source
+TEST_DIR=$ROOT/tests
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+PASSED=0
+FAILED=0
+
+# 검사 결과 출력(이름, 성공이면 0)
+report() {
+    if [ "$2" -eq 0 ]; then
+        PASSED=$((PASSED + 1))
+    else
+        FAILED=$((FAILED + 1))
+        echo "FAIL: $1"
+    fi
+}
+
+# 두 파일을 줄 끝(CRLF/LF)을 무시하고 비교(이름, 기준 파일, 결과 파일)
+same_file() {
+    if [ ! -f "$3" ]; then
+        echo "  $3 파일이 없습니다."
+        report "$1" 1
+    elif diff --strip-trailing-cr "$2" "$3" > "$WORK/diff.txt"; then
+        report "$1" 0
+    else
+        head -20 "$WORK/diff.txt"
+        report "$1" 1
+    fi
+}
+
+# 빌드
+ASM=${ASM:-}
+if [ -z "$ASM" ]; then
+    ASM=$WORK/my_assembler
+    if ! ${CC:-cc} -O2 -Wall -o "$ASM" "$SOURCE_DIR/my_assembler_00000000.c" -lpthread; then
+        echo "FAIL: 빌드에 실패하였습니다."
+        exit 1
+    fi
+fi
+cp "$SOURCE_DIR/inst.data" "$WORK/inst.data"
+cd "$WORK" || exit 1
+
+# 1. 인자 없이 실행(input.txt -> *_00000000.txt)
+mkdir sample
+cp "$SOURCE_DIR/input.txt" "$SOURCE_DIR/inst.data" sample/
+(cd sample && "$ASM" > stdout.txt)
+report "sample: 종료 코드" $?
+for name in output symtab literaltab; do
+    same_file "sample: ${name}_00000000.txt" "$SOURCE_DIR/${name}_00000000.txt" "sample/${name}_00000000.txt"
+done
+
+# 2. batch 모드별로 input.txt를 어셈블하여 기준과 비교
+MODES=("" "-p" "-O" "-1" "-c cache" "-c cache" "-B")
+for mode in "${MODES[@]}"; do
+    rm -rf out
+    "$ASM" -o out $mode "$SOURCE_DIR/input.txt" > stdout.txt
+    report "batch [$mode]: 종료 코드" $?
+    same_file "batch [$mode]: input.obj" "$SOURCE_DIR/output_00000000.txt" out/input.obj
+    same_file "batch [$mode]: input.sym" "$SOURCE_DIR/symtab_00000000.txt" out/input.sym
+    same_file "batch [$mode]: input.lit" "$SOURCE_DIR/literaltab_00000000.txt" out/input.lit
+done
+
+# -B로 만든 binary 오브젝트 파일을 텍스트로 되돌리고, 텍스트를 다시 binary로 변환
+rm -rf conv
+"$ASM" -o conv -x out/input.sxo > stdout.txt
+report "convert: sxo -> obj 종료 코드" $?
+same_file "convert: sxo -> obj" "$SOURCE_DIR/output_00000000.txt" conv/input.obj
+"$ASM" -o conv -x conv/input.obj > stdout.txt
+report "convert: obj -> sxo 종료 코드" $?
+cmp -s out/input.sxo conv/input.sxo
+report "convert: obj -> sxo" $?
+
+# 링킹 로더로 0번지에 로드한 이미지 비교
+rm -rf image
+"$ASM" -o image -L 0 "$SOURCE_DIR/input.txt" > stdout.txt
+report "loader: 종료 코드" $?
+od -Ax -tx1 image/input.img > image/input.img.txt
+same_file "loader: input.img" "$TEST_DIR/input.img.txt" image/input.img.txt
+
+# 3. 생성한 소스로 모드 사이의 결과 비교(기본 모드가 기준)
+mkdir gen
+"$ASM" -g csects=6,lines=400,ext=8,literals=12,equ=4,f2=20,f4=10,seed=7 > gen/g1.asm
+"$ASM" -g csects=3,lines=2000,ext=30,literals=40,equ=10,f2=10,f4=5,seed=11 > gen/g2.asm
+"$ASM" -o gen_ref gen/*.asm > stdout.txt
+report "generated: 종료 코드" $?
+for mode in "-p" "-O" "-1" "-c cache_gen" "-c cache_gen" "-B"; do
+    rm -rf gen_out
+    "$ASM" -o gen_out $mode gen/*.asm > stdout.txt
+    report "generated [$mode]: 종료 코드" $?
+    for file in gen_ref/*; do
+        same_file "generated [$mode]: ${file#gen_ref/}" "$file" "gen_out/${file#gen_ref/}"
+    done
+done
+
+# 4. 회귀 검사 소스(기준 파일이 있는 출력만 비교)
+for source in "$TEST_DIR"/cases/*.asm; do
+    [ -f "$source" ] || continue
+    stem=$(basename "$source" .asm)
+    for mode in "" "-p" "-O" "-1" "-c cache_cases" "-c cache_cases" "-B"; do
+        rm -rf case_out
+        "$ASM" -o case_out $mode "$source" > stdout.txt
+        report "cases/$stem [$mode]: 종료 코드" $?
+        for ext in obj sym lit; do
+            if [ -f "$TEST_DIR/cases/$stem.$ext" ]; then
+                same_file "cases/$stem [$mode]: $stem.$ext" "$TEST_DIR/cases/$stem.$ext" "case_out/$stem.$ext"
+            fi
+        done
+    done
+    if [ -f "$TEST_DIR/cases/$stem.img.txt" ]; then
+        rm -rf case_out
+        "$ASM" -o case_out -L 1000 "$source" > stdout.txt
+        report "cases/$stem [-L 1000]: 종료 코드" $?
+        od -Ax -tx1 "case_out/$stem.img" > "case_out/$stem.img.txt"
+        same_file "cases/$stem [-L 1000]: $stem.img" "$TEST_DIR/cases/$stem.img.txt" "case_out/$stem.img.txt"
+    fi
+done
+
+# 5. 실패해야 하는 소스(종료 코드와 메시지 확인)
+for source in "$TEST_DIR"/errors/*.asm; do
+    [ -f "$source" ] || continue
+    stem=$(basename "$source" .asm)
+    for mode in "" "-p" "-O" "-1"; do
+        rm -rf error_out
+        "$ASM" -o error_out $mode "$source" > stdout.txt
+        [ $? -ne 0 ]
+        report "errors/$stem [$mode]: 실패해야 함" $?
+        grep -qF -f "$TEST_DIR/errors/$stem.msg" stdout.txt
+        report "errors/$stem [$mode]: 메시지" $?
+    done
+done
+
+# 6. 서버 모드(응답을 <stem>.obj/.sym/.lit로 저장하여 batch 결과와 비교)
+if command -v python3 > /dev/null; then
+    rm -rf server_out server_ref
+    mkdir server_out
+    SERVER_SOURCES=("$SOURCE_DIR/input.txt" gen/*.asm "$TEST_DIR"/cases/*.asm)
+    "$ASM" -o server_ref "${SERVER_SOURCES[@]}" > stdout.txt
+    "$ASM" -S server.sock > server.log &
+    SERVER_PID=$!
+    for _ in $(seq 50); do
+        [ -S server.sock ] && break
+        sleep 0.1
+    done
+    [ "$(stat -c %a server.sock 2> /dev/null)" = "600" ]
+    report "server: 소켓 권한 0600" $?
+    python3 - server.sock server_out "${SERVER_SOURCES[@]}" > server_client.txt << 'EOF'
+import os, socket, sys
+
+sock = socket.socket(socket.AF_UNIX)
+sock.connect(sys.argv[1])
+stream = sock.makefile("rb")
+
+def response():
+    header = stream.readline().decode()
+    sizes = [int(size) for size in header.split()[1:]] if header.startswith("OK") else []
+    return header.strip(), [stream.read(size) for size in sizes]
+
+def save(stem, outputs):
+    for ext, data in zip(("obj", "sym", "lit"), outputs):
+        with open(os.path.join(sys.argv[2], stem + "." + ext), "wb") as out:
+            out.write(data)
+
+# 한 연결로 여러 소스를 보내 작업 스레드가 남겨둔 테이블을 다시 사용하게 함
+for path in sys.argv[3:]:
+    stem = os.path.splitext(os.path.basename(path))[0]
+    sock.sendall(b"ASSEMBLE " + os.path.abspath(path).encode() + b"\n")
+    save(stem, response()[1])
+    with open(path, "rb") as source:
+        text = source.read()
+    sock.sendall(b"SOURCE %d\n" % len(text) + text)
+    save(stem + ".source", response()[1])
+sock.sendall(b"SOURCE 99999999999\n")
+print("LARGE", response()[0])
+sock.close()
+
+sock = socket.socket(socket.AF_UNIX)
+sock.connect(sys.argv[1])
+stream = sock.makefile("rb")
+sock.sendall(b"SHUTDOWN\n")
+print("SHUTDOWN", response()[0])
+EOF
+    report "server: 클라이언트 종료 코드" $?
+    for file in server_ref/*.obj server_ref/*.sym server_ref/*.lit; do
+        name=${file#server_ref/}
+        same_file "server [ASSEMBLE]: $name" "$file" "server_out/$name"
+        same_file "server [SOURCE]: $name" "$file" "server_out/${name%.*}.source.${name##*.}"
+    done
+    grep -qx "LARGE ERROR source too large" server_client.txt
+    report "server: 너무 큰 SOURCE 거절" $?
+    if grep -qx "SHUTDOWN OK 0 0 0" server_client.txt; then
+        report "server: SHUTDOWN 응답" 0
+    else
+        report "server: SHUTDOWN 응답" 1
+        kill "$SERVER_PID"
+    fi
+    wait "$SERVER_PID"
+    report "server: SHUTDOWN 후 종료 코드" $?
+    [ ! -e server.sock ]
+    report "server: 종료 후 소켓 파일 삭제" $?
+fi
+
+echo "passed: $PASSED, failed: $FAILED"
+[ "$FAILED" -eq 0 ]